@@ -66,21 +66,42 @@ namespace Controller {
   };
 }}
 
+/// Log levels for TUVOK_LOG_MIN_LEVEL. Calls to the logging macros below the
+/// minimum level are compiled out entirely; e.g. define TUVOK_LOG_MIN_LEVEL
+/// as TUVOK_LOG_LEVEL_MESSAGE to drop all OTHER(...) calls from a build.
+#define TUVOK_LOG_LEVEL_OTHER   0
+#define TUVOK_LOG_LEVEL_MESSAGE 1
+#define TUVOK_LOG_LEVEL_WARNING 2
+#define TUVOK_LOG_LEVEL_ERROR   3
+#ifndef TUVOK_LOG_MIN_LEVEL
+# define TUVOK_LOG_MIN_LEVEL TUVOK_LOG_LEVEL_OTHER
+#endif
+
+// The channel check comes first, so that the arguments of a message on a
+// disabled channel are never evaluated.
+#define TUVOK_LOG_ENABLED(level, channel)                         \
+  (TUVOK_LOG_MIN_LEVEL <= (level) &&                              \
+   ::MultiplexOut::ChannelEnabled(::AbstrDebugOut::channel))
+
 #define T_ERROR(...)                                              \
   do {                                                            \
-    tuvok::Controller::Debug::Out().Error(_func_, __VA_ARGS__);   \
+    if(TUVOK_LOG_ENABLED(TUVOK_LOG_LEVEL_ERROR, CHANNEL_ERROR))   \
+      tuvok::Controller::Debug::Out().Error(_func_, __VA_ARGS__); \
   } while(0)
 #define WARNING(...)                                              \
   do {                                                            \
-    tuvok::Controller::Debug::Out().Warning(_func_, __VA_ARGS__); \
+    if(TUVOK_LOG_ENABLED(TUVOK_LOG_LEVEL_WARNING, CHANNEL_WARNING)) \
+      tuvok::Controller::Debug::Out().Warning(_func_, __VA_ARGS__); \
   } while(0)
 #define MESSAGE(...)                                              \
   do {                                                            \
-    tuvok::Controller::Debug::Out().Message(_func_, __VA_ARGS__); \
+    if(TUVOK_LOG_ENABLED(TUVOK_LOG_LEVEL_MESSAGE, CHANNEL_MESSAGE)) \
+      tuvok::Controller::Debug::Out().Message(_func_, __VA_ARGS__); \
   } while(0)
 #define OTHER(...)                                                \
   do {                                                            \
-    tuvok::Controller::Debug::Out().Other(_func_, __VA_ARGS__);   \
+    if(TUVOK_LOG_ENABLED(TUVOK_LOG_LEVEL_OTHER, CHANNEL_OTHER))   \
+      tuvok::Controller::Debug::Out().Other(_func_, __VA_ARGS__); \
   } while(0)
 
 #endif // TUVOK_CONTROLLER_H
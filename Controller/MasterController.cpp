@@ -37,7 +37,9 @@
 #include <algorithm>
 #include <sstream>
 #include <functional>
+#include "Controller.h"
 #include "MasterController.h"
+#include "PerfTrace.h"
 #include "../Basics/SystemInfo.h"
 #include "../Basics/SysTools.h"
 #include "../IO/IOManager.h"
@@ -56,11 +58,47 @@
 
 using namespace tuvok;
 
+static const struct {
+  const char*      name;
+  enum PerfCounter value;
+} perfCounterNames[] = {
+  { "PERF_SUBFRAMES", PERF_SUBFRAMES },
+  { "PERF_RENDER", PERF_RENDER },
+  { "PERF_RAYCAST", PERF_RAYCAST },
+  { "PERF_READ_HTABLE", PERF_READ_HTABLE },
+  { "PERF_CONDENSE_HTABLE", PERF_CONDENSE_HTABLE },
+  { "PERF_SORT_HTABLE", PERF_SORT_HTABLE },
+  { "PERF_UPLOAD_BRICKS", PERF_UPLOAD_BRICKS },
+  { "PERF_POOL_SORT", PERF_POOL_SORT },
+  { "PERF_POOL_UPLOADED_MEM", PERF_POOL_UPLOADED_MEM },
+  { "PERF_POOL_GET_BRICK", PERF_POOL_GET_BRICK },
+  { "PERF_DY_GET_BRICK", PERF_DY_GET_BRICK },
+  { "PERF_DY_CACHE_LOOKUPS", PERF_DY_CACHE_LOOKUPS },
+  { "PERF_DY_CACHE_LOOKUP", PERF_DY_CACHE_LOOKUP },
+  { "PERF_DY_RESERVE_BRICK", PERF_DY_RESERVE_BRICK },
+  { "PERF_DY_LOAD_BRICK", PERF_DY_LOAD_BRICK },
+  { "PERF_DY_CACHE_ADDS", PERF_DY_CACHE_ADDS },
+  { "PERF_DY_CACHE_ADD", PERF_DY_CACHE_ADD },
+  { "PERF_DY_BRICK_COPIED", PERF_DY_BRICK_COPIED },
+  { "PERF_DY_BRICK_COPY", PERF_DY_BRICK_COPY },
+  { "PERF_POOL_UPLOAD_BRICK", PERF_POOL_UPLOAD_BRICK },
+  { "PERF_POOL_UPLOAD_TEXEL", PERF_POOL_UPLOAD_TEXEL },
+  { "PERF_POOL_UPLOAD_METADATA", PERF_POOL_UPLOAD_METADATA },
+  { "PERF_EO_BRICKS", PERF_EO_BRICKS },
+  { "PERF_EO_DISK_READ", PERF_EO_DISK_READ },
+  { "PERF_EO_DECOMPRESSION", PERF_EO_DECOMPRESSION },
+
+  { "PERF_MM_PRECOMPUTE", PERF_MM_PRECOMPUTE },
+  { "PERF_SOMETHING", PERF_SOMETHING },
+};
+
 MasterController::MasterController() :
+  m_DebugOut(true),
   m_bDeleteDebugOutOnExit(false),
   m_bExperimentalFeatures(false),
   m_pLuaScript(new LuaScripting()),
-  m_pMemReg(new LuaMemberReg(m_pLuaScript))
+  m_pMemReg(new LuaMemberReg(m_pLuaScript)),
+  m_Perf(PERF_END)
 {
   m_pSystemInfo   = new SystemInfo();
   m_pIOManager    = new IOManager();
@@ -77,11 +115,19 @@ MasterController::MasterController() :
   LuaScript()->cexec("provenance.enable", false);
 
   RState.BStrategy = RendererState::BS_SkipTwoLevels;
-  std::fill(m_Perf, m_Perf+PERF_END, 0.0);
+  std::fill(m_PerfQueryBase, m_PerfQueryBase+PERF_END, 0.0);
+  for(size_t i=0; i < sizeof(perfCounterNames)/sizeof(perfCounterNames[0]);
+      ++i) {
+    m_Perf.SetName(perfCounterNames[i].value, perfCounterNames[i].name);
+  }
+  RegisterGCCounters();
 }
 
 
 MasterController::~MasterController() {
+  // The script engine may outlive our counters.
+  m_pLuaScript->setGCObserver(
+    std::function<void (const LuaScripting::GCEvent&)>());
   Cleanup();
   m_DebugOut.clear();
 }
@@ -164,14 +210,128 @@ void MasterController::SetMaxCPUMem(uint64_t megs) {
 
 double MasterController::PerfQuery(enum PerfCounter pc) {
   assert(pc < PERF_END);
-  double tmp = m_Perf[pc];
-  m_Perf[pc] = 0.0;
+  // The counters themselves are never reset; other readers use snapshots.
+  std::lock_guard<std::mutex> lock(m_PerfQueryMutex);
+  double sum = m_Perf.Stats(pc).sum;
+  double tmp = sum - m_PerfQueryBase[pc];
+  m_PerfQueryBase[pc] = sum;
   return tmp;
 }
 void MasterController::IncrementPerfCounter(enum PerfCounter pc,
                                             double amount) {
   assert(pc < PERF_END);
-  m_Perf[pc] += amount;
+  m_Perf.Add(pc, amount);
+}
+
+void MasterController::RecordPerfLatency(enum PerfCounter pc,
+                                         double milliseconds) {
+  assert(pc < PERF_END);
+  m_Perf.AddLatency(pc, milliseconds);
+}
+
+PerfCounterHandle MasterController::RegisterCounter(const std::string& name) {
+  PerfCounterHandle h = m_Perf.Register(name);
+  if(!h.Valid()) {
+    WARNING("Cannot register performance counter '%s': all %u counters are "
+            "in use.", name.c_str(), unsigned(PerfRegistry::MAX_COUNTERS));
+  }
+  return h;
+}
+void MasterController::IncrementPerfCounter(PerfCounterHandle h,
+                                            double amount) {
+  if(h.Valid()) m_Perf.Add(h.id, amount);
+}
+void MasterController::RecordPerfLatency(PerfCounterHandle h,
+                                         double milliseconds) {
+  if(h.Valid()) m_Perf.AddLatency(h.id, milliseconds);
+}
+
+void MasterController::RegisterGCCounters() {
+  // "lua.gc.step" holds the pauses the renderer takes in LuaScripting::gcStep,
+  // "lua.gc.cycle" the gcStep time each complete collection cycle needed.
+  const PerfCounterHandle step = RegisterCounter("lua.gc.step");
+  const PerfCounterHandle cycle = RegisterCounter("lua.gc.cycle");
+  const PerfCounterHandle reclaimed = RegisterCounter("lua.gc.reclaimed");
+  m_pLuaScript->setGCObserver(
+    [this, step, cycle, reclaimed](const LuaScripting::GCEvent& e) {
+      if(e.kind == LuaScripting::GCEvent::STEP) {
+        RecordPerfLatency(step, e.milliseconds);
+      } else {
+        RecordPerfLatency(cycle, e.milliseconds);
+        IncrementPerfCounter(reclaimed, double(e.bytes));
+      }
+    }
+  );
+}
+
+void MasterController::LuaSetGCMode(std::string mode) {
+  if(mode == "incremental") {
+    m_pLuaScript->setGCMode(LuaScripting::GC_INCREMENTAL);
+  } else if(mode == "generational") {
+    m_pLuaScript->setGCMode(LuaScripting::GC_GENERATIONAL);
+  } else if(mode == "manual") {
+    m_pLuaScript->setGCMode(LuaScripting::GC_MANUAL);
+  } else {
+    throw LuaError("tuvok.state.gcMode: unknown mode '" + mode + "'.");
+  }
+}
+
+size_t MasterController::LuaRegisterCounter(std::string name) {
+  PerfCounterHandle h = RegisterCounter(name);
+  if(!h.Valid()) {
+    throw LuaError("tuvok.counter.register: too many performance counters.");
+  }
+  return h.id;
+}
+void MasterController::LuaIncrementCounter(size_t id, double amount) {
+  if(id >= m_Perf.size()) {
+    throw LuaError("tuvok.counter.add: unknown performance counter.");
+  }
+  m_Perf.Add(id, amount);
+}
+void MasterController::LuaRecordCounterLatency(size_t id,
+                                               double milliseconds) {
+  if(id >= m_Perf.size()) {
+    throw LuaError("tuvok.counter.addLatency: unknown performance counter.");
+  }
+  m_Perf.AddLatency(id, milliseconds);
+}
+PerfHistogram MasterController::LuaCounterLatency(size_t id) const {
+  if(id >= m_Perf.size()) {
+    throw LuaError("tuvok.counter.latency: unknown performance counter.");
+  }
+  return m_Perf.Latency(id);
+}
+
+PerfHistogram MasterController::PerfLatency(enum PerfCounter pc) const {
+  assert(pc < PERF_END);
+  return m_Perf.Latency(pc);
+}
+
+void MasterController::TraceStart() {
+  PerfTrace::Start();
+}
+
+bool MasterController::TraceStop(std::string filename) {
+  std::vector<std::string> names(m_Perf.size());
+  for(size_t i=0; i < names.size(); ++i) {
+    names[i] = m_Perf.GetName(i);
+  }
+  bool bOK = PerfTrace::Stop(filename, names);
+  uint64_t dropped = PerfTrace::Dropped();
+  if(dropped > 0) {
+    WARNING("Trace buffers were full; %llu events were dropped.",
+            static_cast<unsigned long long>(dropped));
+  }
+  return bOK;
+}
+
+PerfSnapshot MasterController::GetPerfSnapshot() const {
+  return m_Perf.Snapshot();
+}
+
+PerfSnapshot MasterController::GetPerfDelta(PerfSnapshot earlier) const {
+  return m_Perf.Snapshot().Delta(earlier);
 }
 
 void register_unsigned(lua_State* lua, const char* name, unsigned value) {
@@ -181,34 +341,10 @@ void register_unsigned(lua_State* lua, const char* name, unsigned value) {
 
 void register_perf_enum(std::shared_ptr<LuaScripting>& ss) {
   lua_State* lua = ss->getLuaState();
-  register_unsigned(lua, "PERF_SUBFRAMES", PERF_SUBFRAMES);
-  register_unsigned(lua, "PERF_RENDER", PERF_RENDER);
-  register_unsigned(lua, "PERF_RAYCAST", PERF_RAYCAST);
-  register_unsigned(lua, "PERF_READ_HTABLE", PERF_READ_HTABLE);
-  register_unsigned(lua, "PERF_CONDENSE_HTABLE", PERF_CONDENSE_HTABLE);
-  register_unsigned(lua, "PERF_SORT_HTABLE", PERF_SORT_HTABLE);
-  register_unsigned(lua, "PERF_UPLOAD_BRICKS", PERF_UPLOAD_BRICKS);
-  register_unsigned(lua, "PERF_POOL_SORT", PERF_POOL_SORT);
-  register_unsigned(lua, "PERF_POOL_UPLOADED_MEM", PERF_POOL_UPLOADED_MEM);
-  register_unsigned(lua, "PERF_POOL_GET_BRICK", PERF_POOL_GET_BRICK);
-  register_unsigned(lua, "PERF_DY_GET_BRICK", PERF_DY_GET_BRICK);
-  register_unsigned(lua, "PERF_DY_CACHE_LOOKUPS", PERF_DY_CACHE_LOOKUPS);
-  register_unsigned(lua, "PERF_DY_CACHE_LOOKUP", PERF_DY_CACHE_LOOKUP);
-  register_unsigned(lua, "PERF_DY_RESERVE_BRICK", PERF_DY_RESERVE_BRICK);
-  register_unsigned(lua, "PERF_DY_LOAD_BRICK", PERF_DY_LOAD_BRICK);
-  register_unsigned(lua, "PERF_DY_CACHE_ADDS", PERF_DY_CACHE_ADDS);
-  register_unsigned(lua, "PERF_DY_CACHE_ADD", PERF_DY_CACHE_ADD);
-  register_unsigned(lua, "PERF_DY_BRICK_COPIED", PERF_DY_BRICK_COPIED);
-  register_unsigned(lua, "PERF_DY_BRICK_COPY", PERF_DY_BRICK_COPY);
-  register_unsigned(lua, "PERF_POOL_UPLOAD_BRICK", PERF_POOL_UPLOAD_BRICK);
-  register_unsigned(lua, "PERF_POOL_UPLOAD_TEXEL", PERF_POOL_UPLOAD_TEXEL);
-  register_unsigned(lua, "PERF_POOL_UPLOAD_METADATA", PERF_POOL_UPLOAD_METADATA);
-  register_unsigned(lua, "PERF_EO_BRICKS", PERF_EO_BRICKS);
-  register_unsigned(lua, "PERF_EO_DISK_READ", PERF_EO_DISK_READ);
-  register_unsigned(lua, "PERF_EO_DECOMPRESSION", PERF_EO_DECOMPRESSION);
-
-  register_unsigned(lua, "PERF_MM_PRECOMPUTE", PERF_MM_PRECOMPUTE);
-  register_unsigned(lua, "PERF_SOMETHING", PERF_SOMETHING);
+  for(size_t i=0; i < sizeof(perfCounterNames)/sizeof(perfCounterNames[0]);
+      ++i) {
+    register_unsigned(lua, perfCounterNames[i].name, perfCounterNames[i].value);
+  }
 }
 
 void MasterController::RegisterLuaCommands() {
@@ -275,6 +411,77 @@ void MasterController::RegisterLuaCommands() {
     &MasterController::PerfQuery, "tuvok.perf",
     "queries performance information.  meaning is query-specific.", false
   );
+  m_pMemReg->registerFunction(this,
+    &MasterController::GetPerfSnapshot, "tuvok.perfSnapshot",
+    "returns a table with the count, sum, min and max of every performance "
+    "counter, keyed by counter name.  does not reset anything; subtract two "
+    "snapshots for per-interval values.", false
+  );
+  m_pMemReg->registerFunction(this,
+    &MasterController::GetPerfDelta, "tuvok.perfDelta",
+    "given a table returned by tuvok.perfSnapshot, returns the counts and "
+    "sums accumulated since it was taken.  min and max still cover the "
+    "whole lifetime of the counters.", false
+  );
+  m_pMemReg->registerFunction(this,
+    &MasterController::PerfLatency, "tuvok.perfLatency",
+    "returns count, p50, p95, p99 and max (in milliseconds) of the times "
+    "recorded for a timed performance counter.", false
+  );
+  m_pMemReg->registerFunction(this,
+    &MasterController::LuaRegisterCounter, "tuvok.counter.register",
+    "returns the id of the performance counter with the given name, "
+    "creating the counter if needed.", false
+  );
+  m_pMemReg->registerFunction(this,
+    &MasterController::LuaIncrementCounter, "tuvok.counter.add",
+    "adds a value to the performance counter with the given id.", false
+  );
+  m_pMemReg->registerFunction(this,
+    &MasterController::LuaRecordCounterLatency, "tuvok.counter.addLatency",
+    "adds a duration in milliseconds to the performance counter with the "
+    "given id and to its latency histogram.", false
+  );
+  m_pMemReg->registerFunction(this,
+    &MasterController::LuaCounterLatency, "tuvok.counter.latency",
+    "same as tuvok.perfLatency, for the counter with the given id.", false
+  );
+  m_pMemReg->registerFunction(this,
+    &MasterController::TraceStart, "tuvok.trace.start",
+    "starts recording when and on which thread every timed performance "
+    "counter scope runs.", false
+  );
+  m_pMemReg->registerFunction(this,
+    &MasterController::TraceStop, "tuvok.trace.stop",
+    "stops recording and writes the timeline to the given file in the "
+    "Chrome trace event format (chrome://tracing, Perfetto).", false
+  );
+  // tuvok.perf is itself a function, so exec cache statistics live next to
+  // it rather than underneath it.
+  m_pMemReg->registerFunction(ss.get(), &LuaScripting::getExecCacheHits,
+    "tuvok.perfExecCacheHits", "number of commands whose compiled form was "
+    "found in the exec cache (cumulative).", false);
+  m_pMemReg->registerFunction(ss.get(), &LuaScripting::getExecCacheMisses,
+    "tuvok.perfExecCacheMisses", "number of commands that had to be compiled "
+    "by exec (cumulative).", false);
+  m_pMemReg->registerFunction(ss.get(), &LuaScripting::setExecCacheCapacity,
+    "tuvok.state.execCacheSize", "sets the number of compiled commands kept "
+    "by exec.  0 disables the cache.  default: 1024", false);
+  m_pMemReg->registerFunction(ss.get(), &LuaScripting::getExecCacheCapacity,
+    "tuvok.state.getExecCacheSize", "", false);
+  m_pMemReg->registerFunction(this, &MasterController::LuaSetGCMode,
+    "tuvok.state.gcMode", "selects how the Lua garbage collector runs: "
+    "'incremental', 'generational' or 'manual' (only in tuvok.gcStep).  "
+    "default: incremental", false);
+  m_pMemReg->registerFunction(ss.get(), &LuaScripting::setGCPause,
+    "tuvok.state.gcPause", "sets the Lua collector's pause, in percent of "
+    "the memory in use after a cycle.  default: 200", false);
+  m_pMemReg->registerFunction(ss.get(), &LuaScripting::setGCStepMul,
+    "tuvok.state.gcStepMul", "sets the Lua collector's step multiplier.  "
+    "default: 200", false);
+  m_pMemReg->registerFunction(ss.get(), &LuaScripting::gcStep,
+    "tuvok.gcStep", "runs the Lua garbage collector for about the given "
+    "number of microseconds.  Returns true if a cycle completed.", false);
   ss->registerFunction(&SysTools::basename, "basename",
                        "basename for the given filename", false);
   ss->registerFunction(&SysTools::dirname, "dirname",
@@ -34,6 +34,7 @@
 #include <functional>
 #include <list>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -41,6 +42,7 @@
 #include "Basics/Vectors.h"
 #include "../DebugOut/MultiplexOut.h"
 #include "../DebugOut/ConsoleOut.h"
+#include "PerfRegistry.h"
 
 #include "LuaScripting/LuaClassInstance.h"
 
@@ -150,14 +152,54 @@ public:
   ///@}
 
   /// Performance query interface.  Each id is a separate performance metric.
-  /// @warning Querying a metric resets it!
+  /// Returns the sum accumulated since the previous PerfQuery of the metric.
+  /// Consumers that need independent readings should use PerfSnapshot.
   double PerfQuery(enum PerfCounter);
   void IncrementPerfCounter(enum PerfCounter, double amount);
+  /// Like IncrementPerfCounter, but also records the duration, given in
+  /// milliseconds, in the counter's latency histogram.
+  void RecordPerfLatency(enum PerfCounter, double milliseconds);
+
+  /// Returns a counter for measurements the PerfCounter enum does not
+  /// cover, creating it on first use; registering the same name again
+  /// returns the same counter.  Names conventionally are dotted, e.g.
+  /// "io.lz4.decompress".  The handle can be used with StackTimer.
+  PerfCounterHandle RegisterCounter(const std::string& name);
+  void IncrementPerfCounter(PerfCounterHandle, double amount);
+  void RecordPerfLatency(PerfCounterHandle, double milliseconds);
+
+  /// Count/sum/min/max of every counter. Non-destructive; use
+  /// PerfSnapshot::Delta for per-interval values.
+  PerfSnapshot GetPerfSnapshot() const;
+  /// Statistics accumulated since 'earlier' was taken (PerfSnapshot::Delta).
+  PerfSnapshot GetPerfDelta(PerfSnapshot earlier) const;
+  /// Latency distribution of a counter fed by StackTimer.
+  PerfHistogram PerfLatency(enum PerfCounter) const;
+  PerfRegistry& PerfCounters() { return m_Perf; }
+
+  /// Starts recording a timeline of all StackTimer scopes.
+  void TraceStart();
+  /// Stops recording and writes the timeline as Chrome trace events.
+  bool TraceStop(std::string filename);
 
 private:
   /// Initializer; add all our builtin commands.
   void RegisterLuaCommands();
 
+  /// Lua interface to dynamic counters, which are passed around as ids.
+  ///@{
+  size_t LuaRegisterCounter(std::string name);
+  void LuaIncrementCounter(size_t id, double amount);
+  void LuaRecordCounterLatency(size_t id, double milliseconds);
+  PerfHistogram LuaCounterLatency(size_t id) const;
+  ///@}
+
+  /// Feeds the Lua garbage collector statistics into the "lua.gc.*"
+  /// performance counters.
+  void RegisterGCCounters();
+  /// tuvok.state.gcMode: "incremental", "generational" or "manual".
+  void LuaSetGCMode(std::string mode);
+
 
 private:
   SystemInfo*      m_pSystemInfo;
@@ -172,7 +214,10 @@ private:
   std::unique_ptr<LuaIOManagerProxy>  m_pIOProxy; 
 
   /// for PerfCounter tracking.
-  double m_Perf[PERF_END];
+  PerfRegistry m_Perf;
+  /// Sums at the previous PerfQuery, for its reset-on-read semantics.
+  double       m_PerfQueryBase[PERF_END];
+  std::mutex   m_PerfQueryMutex;
 };
 
 }
@@ -0,0 +1,360 @@
+/*
+   For more information, please see: http://software.sci.utah.edu
+
+   The MIT License
+
+   Copyright (c) 2016 Scientific Computing and Imaging Institute,
+   University of Utah.
+
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  \file    PerfRegistry.cpp
+  \brief   Thread-safe registry of performance counters.
+*/
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include "PerfRegistry.h"
+
+namespace tuvok {
+
+PerfStats::PerfStats() :
+  count(0),
+  sum(0.0),
+  min(std::numeric_limits<double>::max()),
+  max(-std::numeric_limits<double>::max())
+{
+}
+
+void PerfStats::Merge(const PerfStats& other) {
+  count += other.count;
+  sum   += other.sum;
+  min    = std::min(min, other.min);
+  max    = std::max(max, other.max);
+}
+
+PerfSnapshot PerfSnapshot::Delta(const PerfSnapshot& earlier) const {
+  PerfSnapshot delta(*this);
+  for(size_t i=0; i < std::min(m_Stats.size(), earlier.m_Stats.size()); ++i) {
+    delta.m_Stats[i].count -= earlier.m_Stats[i].count;
+    delta.m_Stats[i].sum   -= earlier.m_Stats[i].sum;
+  }
+  return delta;
+}
+
+void PerfSnapshot::Set(size_t id, const std::string& name,
+                       const PerfStats& stats) {
+  if(id >= m_Stats.size()) {
+    m_Stats.resize(id+1);
+    m_Names.resize(id+1);
+  }
+  m_Stats[id] = stats;
+  m_Names[id] = name;
+}
+
+PerfHistogram::PerfHistogram() :
+  m_iCount(0),
+  m_fMax(0.0)
+{
+}
+
+size_t PerfHistogram::Bucket(double fMilliseconds) {
+  const uint64_t limit = (uint64_t(1) << MAX_EXPONENT) - 1;
+  double us = fMilliseconds * 1000.0;
+  uint64_t v = us <= 0.0 ? 0 :
+               us >= double(limit) ? limit : static_cast<uint64_t>(us);
+  if(v < SUB_BUCKETS) return static_cast<size_t>(v);
+
+  size_t e = 0;
+  while((v >> e) >= 2*SUB_BUCKETS) ++e;
+  // v >> e is in [SUB_BUCKETS, 2*SUB_BUCKETS): its low bits are the
+  // sub-bucket within the power of two.
+  return SUB_BUCKETS * (e+1) + static_cast<size_t>((v >> e) - SUB_BUCKETS);
+}
+
+double PerfHistogram::BucketLimit(size_t iBucket) {
+  assert(iBucket < BUCKETS);
+  if(iBucket < SUB_BUCKETS) return (iBucket+1) / 1000.0;
+
+  size_t e = iBucket / SUB_BUCKETS - 1;
+  uint64_t lower = uint64_t(SUB_BUCKETS + iBucket % SUB_BUCKETS) << e;
+  return double(lower + (uint64_t(1) << e)) / 1000.0;
+}
+
+double PerfHistogram::Percentile(double p) const {
+  if(m_iCount == 0) return 0.0;
+  p = std::max(0.0, std::min(100.0, p));
+  uint64_t rank = std::max<uint64_t>(1,
+    static_cast<uint64_t>(std::ceil(p / 100.0 * double(m_iCount))));
+
+  uint64_t seen = 0;
+  for(size_t i=0; i < m_Buckets.size(); ++i) {
+    seen += m_Buckets[i];
+    if(seen >= rank) return std::min(BucketLimit(i), m_fMax);
+  }
+  return m_fMax;
+}
+
+void PerfHistogram::Merge(const PerfHistogram& other) {
+  if(other.m_iCount == 0) return;
+  if(m_Buckets.empty()) m_Buckets.assign(BUCKETS, 0);
+  for(size_t i=0; i < other.m_Buckets.size(); ++i) {
+    m_Buckets[i] += other.m_Buckets[i];
+  }
+  m_fMax = m_iCount == 0 ? other.m_fMax : std::max(m_fMax, other.m_fMax);
+  m_iCount += other.m_iCount;
+}
+
+struct PerfRegistry::State {
+  State(size_t iCounters) : counters(iCounters), retired(MAX_COUNTERS),
+                            retiredLatency(MAX_COUNTERS),
+                            names(MAX_COUNTERS) {}
+
+  std::atomic<size_t>      counters;
+  mutable std::mutex       mutex;     ///< Guards everything below.
+  std::vector<Shard*>      shards;
+  std::vector<PerfStats>   retired;   ///< Totals of exited threads.
+  std::vector<PerfHistogram> retiredLatency;
+  std::vector<std::string> names;
+};
+
+/// Every shard the thread created, one per registry it has used. Folds the
+/// shards into their registry when the thread exits.
+struct PerfRegistry::ThreadShards {
+  struct Entry {
+    std::shared_ptr<State> state;
+    Shard*                 shard;
+  };
+  std::vector<Entry> entries;
+  const State*       lastState;   ///< Cache for the common single-registry
+  Shard*             lastShard;   ///< case.
+
+  ThreadShards() : lastState(NULL), lastShard(NULL) {}
+  ~ThreadShards() {
+    for(size_t i=0; i < entries.size(); ++i) {
+      State& state = *entries[i].state;
+      std::lock_guard<std::mutex> lock(state.mutex);
+      const Shard& shard = *entries[i].shard;
+      MergeShard(shard, state.counters.load(), state.retired);
+      for(size_t c=0; c < MAX_COUNTERS; ++c) {
+        MergeHistogram(shard.histograms[c].load(std::memory_order_acquire),
+                       state.retiredLatency[c]);
+      }
+      state.shards.erase(std::find(state.shards.begin(), state.shards.end(),
+                                   entries[i].shard));
+      delete entries[i].shard;
+    }
+  }
+};
+
+PerfRegistry::Shard::Shard() {
+  for(size_t i=0; i < slots.size(); ++i) {
+    slots[i].count.store(0, std::memory_order_relaxed);
+    slots[i].sum.store(0.0, std::memory_order_relaxed);
+    slots[i].min.store(0.0, std::memory_order_relaxed);
+    slots[i].max.store(0.0, std::memory_order_relaxed);
+    histograms[i].store(NULL, std::memory_order_relaxed);
+  }
+}
+
+PerfRegistry::Shard::~Shard() {
+  for(size_t i=0; i < histograms.size(); ++i) {
+    delete histograms[i].load(std::memory_order_relaxed);
+  }
+}
+
+PerfRegistry::Histogram::Histogram() {
+  for(size_t i=0; i < buckets.size(); ++i) {
+    buckets[i].store(0, std::memory_order_relaxed);
+  }
+  max.store(0.0, std::memory_order_relaxed);
+}
+
+PerfRegistry::PerfRegistry(size_t iCounters) :
+  m_pState(new State(iCounters))
+{
+  assert(iCounters <= MAX_COUNTERS);
+}
+
+PerfRegistry::~PerfRegistry() {
+}
+
+PerfRegistry::Shard* PerfRegistry::GetShard() {
+  static thread_local ThreadShards tls;
+  if(tls.lastState == m_pState.get()) {
+    return tls.lastShard;
+  }
+
+  Shard* shard = NULL;
+  for(size_t i=0; i < tls.entries.size() && shard == NULL; ++i) {
+    if(tls.entries[i].state == m_pState) {
+      shard = tls.entries[i].shard;
+    }
+  }
+  if(shard == NULL) {
+    shard = new Shard();
+    {
+      std::lock_guard<std::mutex> lock(m_pState->mutex);
+      m_pState->shards.push_back(shard);
+    }
+    ThreadShards::Entry entry = { m_pState, shard };
+    tls.entries.push_back(entry);
+  }
+
+  tls.lastState = m_pState.get();
+  tls.lastShard = shard;
+  return shard;
+}
+
+void PerfRegistry::Add(size_t id, double value) {
+  assert(id < size());
+  Slot& slot = GetShard()->slots[id];
+
+  // Only this thread writes the slot, so plain loads and stores suffice.
+  uint64_t count = slot.count.load(std::memory_order_relaxed);
+  slot.sum.store(slot.sum.load(std::memory_order_relaxed) + value,
+                 std::memory_order_relaxed);
+  if(count == 0 || value < slot.min.load(std::memory_order_relaxed)) {
+    slot.min.store(value, std::memory_order_relaxed);
+  }
+  if(count == 0 || value > slot.max.load(std::memory_order_relaxed)) {
+    slot.max.store(value, std::memory_order_relaxed);
+  }
+  slot.count.store(count+1, std::memory_order_release);
+}
+
+void PerfRegistry::AddLatency(size_t id, double fMilliseconds) {
+  Add(id, fMilliseconds);
+
+  Shard* shard = GetShard();
+  Histogram* hist = shard->histograms[id].load(std::memory_order_relaxed);
+  if(hist == NULL) {
+    hist = new Histogram();
+    shard->histograms[id].store(hist, std::memory_order_release);
+  }
+  // Single writer, as in Add.
+  std::atomic<uint64_t>& bucket = hist->buckets[
+    PerfHistogram::Bucket(fMilliseconds)];
+  bucket.store(bucket.load(std::memory_order_relaxed) + 1,
+               std::memory_order_relaxed);
+  if(fMilliseconds > hist->max.load(std::memory_order_relaxed)) {
+    hist->max.store(fMilliseconds, std::memory_order_relaxed);
+  }
+}
+
+size_t PerfRegistry::size() const {
+  return m_pState->counters.load();
+}
+
+PerfCounterHandle PerfRegistry::Register(const std::string& name) {
+  std::lock_guard<std::mutex> lock(m_pState->mutex);
+  size_t iCounters = m_pState->counters.load();
+  for(size_t i=0; i < iCounters; ++i) {
+    if(m_pState->names[i] == name) return PerfCounterHandle(i);
+  }
+  if(iCounters == MAX_COUNTERS) return PerfCounterHandle();
+
+  // Every shard already has a zeroed slot for the new counter.
+  m_pState->names[iCounters] = name;
+  m_pState->counters.store(iCounters+1);
+  return PerfCounterHandle(iCounters);
+}
+
+void PerfRegistry::SetName(size_t id, const std::string& name) {
+  assert(id < MAX_COUNTERS);
+  std::lock_guard<std::mutex> lock(m_pState->mutex);
+  m_pState->names[id] = name;
+}
+
+std::string PerfRegistry::GetName(size_t id) const {
+  std::lock_guard<std::mutex> lock(m_pState->mutex);
+  return m_pState->names[id];
+}
+
+void PerfRegistry::MergeSlot(const Slot& slot, PerfStats& stats) {
+  PerfStats s;
+  s.count = slot.count.load(std::memory_order_acquire);
+  if(s.count == 0) return;
+  s.sum = slot.sum.load(std::memory_order_relaxed);
+  s.min = slot.min.load(std::memory_order_relaxed);
+  s.max = slot.max.load(std::memory_order_relaxed);
+  stats.Merge(s);
+}
+
+void PerfRegistry::MergeShard(const Shard& shard, size_t iCounters,
+                              std::vector<PerfStats>& stats) {
+  for(size_t i=0; i < iCounters; ++i) {
+    MergeSlot(shard.slots[i], stats[i]);
+  }
+}
+
+void PerfRegistry::MergeHistogram(const Histogram* hist, PerfHistogram& out) {
+  if(hist == NULL) return;
+  PerfHistogram h;
+  h.m_Buckets.resize(PerfHistogram::BUCKETS);
+  for(size_t i=0; i < PerfHistogram::BUCKETS; ++i) {
+    h.m_Buckets[i] = hist->buckets[i].load(std::memory_order_relaxed);
+    h.m_iCount += h.m_Buckets[i];
+  }
+  h.m_fMax = hist->max.load(std::memory_order_relaxed);
+  out.Merge(h);
+}
+
+PerfSnapshot PerfRegistry::Snapshot() const {
+  PerfSnapshot snap;
+  std::lock_guard<std::mutex> lock(m_pState->mutex);
+  size_t iCounters = m_pState->counters.load();
+  snap.m_Stats.assign(m_pState->retired.begin(),
+                      m_pState->retired.begin() + iCounters);
+  snap.m_Names.assign(m_pState->names.begin(),
+                      m_pState->names.begin() + iCounters);
+  for(size_t i=0; i < m_pState->shards.size(); ++i) {
+    MergeShard(*m_pState->shards[i], iCounters, snap.m_Stats);
+  }
+  return snap;
+}
+
+PerfStats PerfRegistry::Stats(size_t id) const {
+  assert(id < size());
+  std::lock_guard<std::mutex> lock(m_pState->mutex);
+  PerfStats stats = m_pState->retired[id];
+  for(size_t i=0; i < m_pState->shards.size(); ++i) {
+    MergeSlot(m_pState->shards[i]->slots[id], stats);
+  }
+  return stats;
+}
+
+PerfHistogram PerfRegistry::Latency(size_t id) const {
+  assert(id < size());
+  std::lock_guard<std::mutex> lock(m_pState->mutex);
+  PerfHistogram hist = m_pState->retiredLatency[id];
+  for(size_t i=0; i < m_pState->shards.size(); ++i) {
+    MergeHistogram(m_pState->shards[i]->histograms[id].load(
+                     std::memory_order_acquire), hist);
+  }
+  return hist;
+}
+
+}
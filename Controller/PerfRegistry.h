@@ -0,0 +1,205 @@
+/*
+   For more information, please see: http://software.sci.utah.edu
+
+   The MIT License
+
+   Copyright (c) 2016 Scientific Computing and Imaging Institute,
+   University of Utah.
+
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  \file    PerfRegistry.h
+  \brief   Thread-safe registry of performance counters.
+*/
+
+#pragma once
+
+#ifndef TUVOK_PERFREGISTRY_H
+#define TUVOK_PERFREGISTRY_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace tuvok {
+
+/// Dense index of a counter in a PerfRegistry. Cheap to copy; obtain one
+/// from PerfRegistry::Register once and keep it.
+struct PerfCounterHandle {
+  static const size_t INVALID = ~size_t(0);
+
+  PerfCounterHandle() : id(INVALID) {}
+  explicit PerfCounterHandle(size_t iID) : id(iID) {}
+  bool Valid() const { return id != INVALID; }
+
+  size_t id;
+};
+
+/// Accumulated statistics of one performance counter.
+struct PerfStats {
+  PerfStats();
+
+  uint64_t count;
+  double   sum;
+  double   min;   ///< Only meaningful if count > 0.
+  double   max;   ///< Only meaningful if count > 0.
+
+  void Merge(const PerfStats& other);
+};
+
+/// Log-bucketed latency histogram, in the spirit of HdrHistogram: values
+/// are kept in microseconds with 8 linear sub-buckets per power of two,
+/// i.e. with a relative error below 12.5% from 1us up to about 12 days.
+class PerfHistogram {
+public:
+  static const size_t SUB_BUCKETS = 8;
+  static const size_t MAX_EXPONENT = 40;
+  static const size_t BUCKETS = SUB_BUCKETS * (MAX_EXPONENT - 2);
+
+  PerfHistogram();
+
+  /// Number of recorded values.
+  uint64_t Count() const { return m_iCount; }
+  /// Largest recorded value, in milliseconds; exact.
+  double Max() const { return m_fMax; }
+  /// Smallest value such that p percent of all recorded values are below
+  /// or equal to it, in milliseconds. p is given in [0, 100].
+  double Percentile(double p) const;
+
+  void Merge(const PerfHistogram& other);
+
+  /// Bucket a value given in milliseconds falls into.
+  static size_t Bucket(double fMilliseconds);
+  /// Largest value, in milliseconds, that falls into the bucket.
+  static double BucketLimit(size_t iBucket);
+
+private:
+  friend class PerfRegistry;
+  std::vector<uint64_t> m_Buckets;
+  uint64_t              m_iCount;
+  double                m_fMax;
+};
+
+/// Statistics of all counters at one point in time.
+class PerfSnapshot {
+public:
+  size_t size() const { return m_Stats.size(); }
+  const PerfStats& operator[](size_t id) const { return m_Stats[id]; }
+  /// Name of the counter; empty if it has none.
+  const std::string& Name(size_t id) const { return m_Names[id]; }
+
+  /// Statistics accumulated between 'earlier' and this snapshot. Counts and
+  /// sums are exact; min and max cannot be windowed and still cover the
+  /// whole lifetime of the counter.
+  PerfSnapshot Delta(const PerfSnapshot& earlier) const;
+
+  /// Sets the statistics of a counter, growing the snapshot as needed. Used
+  /// to rebuild snapshots that were handed out to Lua.
+  void Set(size_t id, const std::string& name, const PerfStats& stats);
+
+private:
+  friend class PerfRegistry;
+  std::vector<PerfStats>   m_Stats;
+  std::vector<std::string> m_Names;
+};
+
+/// Performance counters that can be bumped from any thread.
+///
+/// Each thread accumulates into its own shard, so adding a sample never
+/// takes a lock or bounces a cache line between threads; shards are merged
+/// when a snapshot is taken. Reading is non-destructive: every consumer takes
+/// its own snapshots and computes deltas between them, so consumers do not
+/// steal each other's samples. Shards of exited threads are folded into the
+/// registry's totals.
+class PerfRegistry {
+public:
+  /// Upper bound on the number of counters.
+  static const size_t MAX_COUNTERS = 256;
+
+  /// Counters [0, iCounters) exist from the start.
+  explicit PerfRegistry(size_t iCounters);
+  ~PerfRegistry();
+
+  /// Records one sample. Lock-free.
+  void Add(size_t id, double value);
+  /// Records one sample, given in milliseconds, and also adds it to the
+  /// counter's latency histogram. Lock-free.
+  void AddLatency(size_t id, double fMilliseconds);
+
+  /// Number of counters.
+  size_t size() const;
+
+  /// Returns the counter with the given name, creating it if there is
+  /// none. Returns an invalid handle if all MAX_COUNTERS are in use.
+  PerfCounterHandle Register(const std::string& name);
+
+  void SetName(size_t id, const std::string& name);
+  std::string GetName(size_t id) const;
+
+  /// Merges all shards.
+  PerfSnapshot Snapshot() const;
+  PerfStats Stats(size_t id) const;
+  /// Latency histogram of the counter; empty if AddLatency was never used.
+  PerfHistogram Latency(size_t id) const;
+
+private:
+  PerfRegistry(const PerfRegistry&); ///< unimplemented.
+
+  struct Slot {
+    std::atomic<uint64_t> count;
+    std::atomic<double>   sum;
+    std::atomic<double>   min;
+    std::atomic<double>   max;
+  };
+  struct Histogram {
+    Histogram();
+    std::array<std::atomic<uint64_t>, PerfHistogram::BUCKETS> buckets;
+    std::atomic<double> max;
+  };
+  /// Written by its thread only; read by snapshots.
+  struct Shard {
+    Shard();
+    ~Shard();
+    std::array<Slot, MAX_COUNTERS> slots;
+    /// Allocated on the first AddLatency of the counter.
+    std::array<std::atomic<Histogram*>, MAX_COUNTERS> histograms;
+  };
+  struct State;
+  struct ThreadShards;
+
+  /// The calling thread's shard; created on first use.
+  Shard* GetShard();
+  static void MergeSlot(const Slot& slot, PerfStats& stats);
+  static void MergeShard(const Shard& shard, size_t iCounters,
+                         std::vector<PerfStats>& stats);
+  static void MergeHistogram(const Histogram* hist, PerfHistogram& out);
+
+  /// Outlives the registry while threads that used it are still running.
+  std::shared_ptr<State> m_pState;
+};
+
+}
+
+#endif // TUVOK_PERFREGISTRY_H
@@ -0,0 +1,217 @@
+/*
+   For more information, please see: http://software.sci.utah.edu
+
+   The MIT License
+
+   Copyright (c) 2016 Scientific Computing and Imaging Institute,
+   University of Utah.
+
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+*/
+
+
+/**
+  \file    PerfTrace.cpp
+  \brief   Timeline of StackTimer scopes, exported as Chrome trace events.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include "Controller.h"
+#include "PerfTrace.h"
+
+namespace tuvok {
+
+std::atomic<bool> PerfTrace::s_bEnabled(false);
+
+namespace {
+
+struct TraceEvent {
+  uint64_t begin;
+  uint64_t end;
+  unsigned counter;
+};
+
+/// Events of one thread. Only the owning thread appends; Stop reads the
+/// first 'count' events.
+struct TraceBuffer {
+  explicit TraceBuffer(unsigned iThread) :
+    iThread(iThread), generation(0), count(0), dropped(0),
+    events(PerfTrace::EVENTS_PER_THREAD) {}
+
+  const unsigned          iThread;
+  std::atomic<unsigned>   generation; ///< Trace the events belong to.
+  std::atomic<size_t>     count;
+  std::atomic<uint64_t>   dropped;
+  std::vector<TraceEvent> events;
+};
+
+struct Tracer {
+  Tracer() : generation(0), nextThread(1), origin(0) {}
+
+  std::mutex                                mutex; ///< Guards all but generation.
+  std::vector<std::shared_ptr<TraceBuffer>> buffers;
+  std::atomic<unsigned>                     generation;
+  unsigned                                  nextThread;
+  uint64_t                                  origin;
+};
+
+Tracer& GetTracer() {
+  static Tracer tracer;
+  return tracer;
+}
+
+/// The calling thread's buffer. The tracer shares ownership so that events
+/// survive the thread; Start frees buffers of exited threads.
+TraceBuffer& GetBuffer() {
+  static thread_local std::shared_ptr<TraceBuffer> buffer;
+  if(!buffer) {
+    Tracer& tracer = GetTracer();
+    std::lock_guard<std::mutex> lock(tracer.mutex);
+    buffer = std::make_shared<TraceBuffer>(tracer.nextThread++);
+    tracer.buffers.push_back(buffer);
+  }
+  return *buffer;
+}
+
+void WriteJSONString(FILE* f, const std::string& s) {
+  fputc('"', f);
+  for(size_t i=0; i < s.size(); ++i) {
+    if(s[i] == '"' || s[i] == '\\') fputc('\\', f);
+    if(static_cast<unsigned char>(s[i]) >= 0x20) fputc(s[i], f);
+  }
+  fputc('"', f);
+}
+
+}
+
+uint64_t PerfTrace::Now() {
+  return static_cast<uint64_t>(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void PerfTrace::Record(unsigned counter, uint64_t begin) {
+  uint64_t end = Now();
+  TraceBuffer& buf = GetBuffer();
+
+  unsigned gen = GetTracer().generation.load(std::memory_order_acquire);
+  if(buf.generation.load(std::memory_order_relaxed) != gen) {
+    buf.count.store(0, std::memory_order_relaxed);
+    buf.dropped.store(0, std::memory_order_relaxed);
+    buf.generation.store(gen, std::memory_order_release);
+  }
+
+  size_t n = buf.count.load(std::memory_order_relaxed);
+  if(n >= buf.events.size()) {
+    buf.dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  TraceEvent& ev = buf.events[n];
+  ev.begin   = begin;
+  ev.end     = end;
+  ev.counter = counter;
+  buf.count.store(n+1, std::memory_order_release);
+}
+
+void PerfTrace::Start() {
+  Tracer& tracer = GetTracer();
+  std::lock_guard<std::mutex> lock(tracer.mutex);
+  for(size_t i=0; i < tracer.buffers.size(); ) {
+    if(tracer.buffers[i].use_count() == 1) {
+      tracer.buffers.erase(tracer.buffers.begin() + i);
+    } else {
+      ++i;
+    }
+  }
+  tracer.origin = Now();
+  tracer.generation.fetch_add(1, std::memory_order_release);
+  s_bEnabled.store(true);
+}
+
+bool PerfTrace::Stop(const std::string& strFilename,
+                     const std::vector<std::string>& vNames) {
+  s_bEnabled.store(false);
+
+  Tracer& tracer = GetTracer();
+  std::lock_guard<std::mutex> lock(tracer.mutex);
+  unsigned gen = tracer.generation.load();
+
+  FILE* f = fopen(strFilename.c_str(), "w");
+  if(f == NULL) {
+    T_ERROR("Could not open '%s' to write the trace.", strFilename.c_str());
+    return false;
+  }
+
+  fprintf(f, "{\"traceEvents\":[\n");
+  bool bFirst = true;
+  for(size_t b=0; b < tracer.buffers.size(); ++b) {
+    const TraceBuffer& buf = *tracer.buffers[b];
+    if(buf.generation.load(std::memory_order_acquire) != gen) continue;
+    size_t n = buf.count.load(std::memory_order_acquire);
+    if(n == 0) continue;
+
+    fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+               "\"tid\":%u,\"args\":{\"name\":\"thread %u\"}}",
+            bFirst ? "" : ",\n", buf.iThread, buf.iThread);
+    bFirst = false;
+
+    for(size_t i=0; i < n; ++i) {
+      const TraceEvent& ev = buf.events[i];
+      // Chrome expects microseconds.
+      double ts  = double(int64_t(ev.begin - tracer.origin)) / 1000.0;
+      double dur = double(ev.end - ev.begin) / 1000.0;
+      fprintf(f, ",\n{\"name\":");
+      if(ev.counter < vNames.size() && !vNames[ev.counter].empty()) {
+        WriteJSONString(f, vNames[ev.counter]);
+      } else {
+        fprintf(f, "\"counter %u\"", ev.counter);
+      }
+      fprintf(f, ",\"cat\":\"tuvok\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                 "\"ts\":%.3f,\"dur\":%.3f}", buf.iThread, ts, dur);
+    }
+  }
+  fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+  bool bOK = !ferror(f);
+  if(fclose(f) != 0) bOK = false;
+  if(!bOK) {
+    T_ERROR("Error writing the trace to '%s'.", strFilename.c_str());
+  }
+  return bOK;
+}
+
+uint64_t PerfTrace::Dropped() {
+  Tracer& tracer = GetTracer();
+  std::lock_guard<std::mutex> lock(tracer.mutex);
+  unsigned gen = tracer.generation.load();
+  uint64_t dropped = 0;
+  for(size_t b=0; b < tracer.buffers.size(); ++b) {
+    const TraceBuffer& buf = *tracer.buffers[b];
+    if(buf.generation.load(std::memory_order_acquire) == gen) {
+      dropped += buf.dropped.load(std::memory_order_relaxed);
+    }
+  }
+  return dropped;
+}
+
+}
@@ -0,0 +1,85 @@
+/*
+   For more information, please see: http://software.sci.utah.edu
+
+   The MIT License
+
+   Copyright (c) 2016 Scientific Computing and Imaging Institute,
+   University of Utah.
+
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+*/
+
+
+/**
+  \file    PerfTrace.h
+  \brief   Timeline of StackTimer scopes, exported as Chrome trace events.
+*/
+
+#pragma once
+
+#ifndef TUVOK_PERFTRACE_H
+#define TUVOK_PERFTRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace tuvok {
+
+/// Records when each StackTimer scope began and ended, and on which thread.
+///
+/// While tracing, every thread appends to its own fixed-size buffer, so
+/// recording takes no lock; a full buffer drops further events. When not
+/// tracing, StackTimer only pays for one relaxed atomic load.
+/// Stop writes the Chrome Trace Event format, which chrome://tracing and
+/// Perfetto load directly.
+class PerfTrace {
+public:
+  /// Events each thread can hold per trace.
+  static const size_t EVENTS_PER_THREAD = 1 << 15;
+
+  static bool Enabled() {
+    return s_bEnabled.load(std::memory_order_relaxed);
+  }
+  /// Current time in nanoseconds on the clock events are recorded with.
+  static uint64_t Now();
+  /// Records a scope of 'counter' that began at 'begin' (see Now) and ends
+  /// now.
+  static void Record(unsigned counter, uint64_t begin);
+
+  /// Discards previously recorded events and starts recording.
+  static void Start();
+  /// Stops recording and writes the events to strFilename as JSON; counters
+  /// are labelled with vNames, or their number if they have no name.
+  /// Returns false if the file could not be written.
+  static bool Stop(const std::string& strFilename,
+                   const std::vector<std::string>& vNames);
+
+  /// Events dropped during the last trace because a buffer was full.
+  static uint64_t Dropped();
+
+private:
+  static std::atomic<bool> s_bEnabled;
+};
+
+}
+
+#endif // TUVOK_PERFTRACE_H
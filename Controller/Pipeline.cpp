@@ -0,0 +1,295 @@
+/*
+   For more information, please see: http://software.sci.utah.edu
+
+   The MIT License
+
+   Copyright (c) 2016 Scientific Computing and Imaging Institute,
+   University of Utah.
+
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+*/
+
+
+/**
+  \file    Pipeline.cpp
+  \brief   Bounded, multi-threaded stage pipeline for out-of-core passes.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <thread>
+#include "PerfTrace.h"
+#include "Pipeline.h"
+
+namespace tuvok {
+
+namespace {
+
+/// Bounded FIFO between two stages. It is closed once all of its producers
+/// are done; Pop then drains what is left.
+class Queue {
+public:
+  Queue(size_t iCapacity, size_t iProducers) :
+    m_iCapacity(iCapacity), m_iProducers(iProducers), m_bAborted(false) {}
+
+  /// Blocks while the queue is full. Returns false if the pipeline aborted.
+  bool Push(PipelineItem&& item) {
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_NotFull.wait(lock, [this] {
+      return m_Items.size() < m_iCapacity || m_bAborted;
+    });
+    if(m_bAborted) return false;
+    m_Items.push_back(std::move(item));
+    m_NotEmpty.notify_one();
+    return true;
+  }
+
+  /// Blocks while the queue is empty. Returns false once it is closed and
+  /// drained, or if the pipeline aborted.
+  bool Pop(PipelineItem& item) {
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_NotEmpty.wait(lock, [this] {
+      return !m_Items.empty() || m_iProducers == 0 || m_bAborted;
+    });
+    if(m_bAborted || m_Items.empty()) return false;
+    item = std::move(m_Items.front());
+    m_Items.pop_front();
+    m_NotFull.notify_one();
+    return true;
+  }
+
+  void ProducerDone() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if(--m_iProducers == 0) m_NotEmpty.notify_all();
+  }
+
+  void Abort() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_bAborted = true;
+    m_NotFull.notify_all();
+    m_NotEmpty.notify_all();
+  }
+
+private:
+  std::mutex               m_Mutex;
+  std::condition_variable  m_NotFull;
+  std::condition_variable  m_NotEmpty;
+  std::deque<PipelineItem> m_Items;
+  size_t                   m_iCapacity;
+  size_t                   m_iProducers;
+  bool                     m_bAborted;
+};
+
+}
+
+struct Pipeline::State {
+  State(uint64_t iBudget) : budget(iBudget), inFlight(0), peak(0),
+                            aborted(false) {}
+
+  /// Blocks until the item fits into the budget. Returns false if the
+  /// pipeline aborted.
+  bool Acquire(uint64_t bytes) {
+    std::unique_lock<std::mutex> lock(mutex);
+    fits.wait(lock, [&] {
+      return budget == 0 || inFlight == 0 || inFlight + bytes <= budget ||
+             aborted;
+    });
+    if(aborted) return false;
+    Charge(bytes);
+    return true;
+  }
+
+  /// Accounts for an item that changed its size in a stage; never blocks.
+  void Adjust(uint64_t before, uint64_t after) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(after > before) {
+      Charge(after - before);
+    } else {
+      inFlight -= before - after;
+      fits.notify_all();
+    }
+  }
+
+  void Release(uint64_t bytes) { Adjust(bytes, 0); }
+
+  /// Stops all threads; the first error is kept.
+  void Abort(std::exception_ptr e) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if(!error) error = e;
+      aborted = true;
+      fits.notify_all();
+    }
+    for(size_t i=0; i < queues.size(); ++i) queues[i]->Abort();
+  }
+
+  void Charge(uint64_t bytes) {
+    inFlight += bytes;
+    peak = std::max(peak, inFlight);
+  }
+
+  std::mutex                          mutex;
+  std::condition_variable             fits;
+  const uint64_t                      budget;
+  uint64_t                            inFlight;
+  uint64_t                            peak;
+  bool                                aborted;
+  std::exception_ptr                  error;
+  std::vector<std::unique_ptr<Queue>> queues;
+};
+
+Pipeline::Pipeline(const std::string& name, PerfRegistry& perf,
+                   uint64_t iMemBudget, size_t iQueueLength) :
+  m_strName(name),
+  m_Perf(perf),
+  m_iMemBudget(iMemBudget),
+  m_iQueueLength(std::max<size_t>(iQueueLength, 1)),
+  m_iPeakBytes(0)
+{
+}
+
+Pipeline::~Pipeline() {}
+
+void Pipeline::AddStage(const std::string& name, Stage stage,
+                        size_t iThreads) {
+  StageInfo info;
+  info.name = name;
+  info.stage = stage;
+  info.threads = std::max<size_t>(iThreads, 1);
+  RegisterCounters(info);
+  m_Stages.push_back(info);
+}
+
+void Pipeline::RegisterCounters(StageInfo& info) {
+  info.time = m_Perf.Register(m_strName + "." + info.name);
+  info.megabytes = m_Perf.Register(m_strName + "." + info.name + ".MB");
+}
+
+void Pipeline::Timed(const StageInfo& info, const std::function<void ()>& fn,
+                     const PipelineItem& item) {
+  const uint64_t traceBegin = PerfTrace::Enabled() && info.time.Valid() ?
+                              PerfTrace::Now() : 0;
+  const auto start = std::chrono::steady_clock::now();
+  fn();
+  if(info.time.Valid()) {
+    m_Perf.AddLatency(info.time.id,
+      std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count());
+  }
+  if(info.megabytes.Valid()) {
+    m_Perf.Add(info.megabytes.id, item.data.size() / (1024.0 * 1024.0));
+  }
+  if(traceBegin != 0) {
+    PerfTrace::Record(static_cast<unsigned>(info.time.id), traceBegin);
+  }
+}
+
+void Pipeline::Run(const std::string& sourceName, Source source,
+                   const std::string& sinkName, Stage sink, bool bOrdered) {
+  State state(m_iMemBudget);
+  StageInfo src, snk;
+  src.name = sourceName;
+  snk.name = sinkName;
+  RegisterCounters(src);
+  RegisterCounters(snk);
+
+  // queues[i] feeds stage i; the last one feeds the sink.
+  state.queues.push_back(std::unique_ptr<Queue>(new Queue(m_iQueueLength, 1)));
+  for(size_t s=0; s < m_Stages.size(); ++s) {
+    state.queues.push_back(std::unique_ptr<Queue>(
+      new Queue(m_iQueueLength, m_Stages[s].threads)));
+  }
+
+  std::vector<std::thread> threads;
+  threads.push_back(std::thread([&] {
+    try {
+      for(uint64_t i=0; ; ++i) {
+        PipelineItem item;
+        item.index = i;
+        bool bMore = true;
+        Timed(src, [&] { bMore = source(item); }, item);
+        if(!bMore || !state.Acquire(item.data.size())) break;
+        if(!state.queues[0]->Push(std::move(item))) break;
+      }
+    } catch(...) {
+      state.Abort(std::current_exception());
+    }
+    state.queues[0]->ProducerDone();
+  }));
+
+  for(size_t s=0; s < m_Stages.size(); ++s) {
+    for(size_t t=0; t < m_Stages[s].threads; ++t) {
+      threads.push_back(std::thread([&, s] {
+        const StageInfo& info = m_Stages[s];
+        Queue& in = *state.queues[s];
+        Queue& out = *state.queues[s+1];
+        try {
+          PipelineItem item;
+          while(in.Pop(item)) {
+            const uint64_t before = item.data.size();
+            Timed(info, [&] { info.stage(item); }, item);
+            state.Adjust(before, item.data.size());
+            if(!out.Push(std::move(item))) break;
+          }
+        } catch(...) {
+          state.Abort(std::current_exception());
+        }
+        out.ProducerDone();
+      }));
+    }
+  }
+
+  // Out of order items wait here for their predecessors; they are still
+  // charged to the budget, but their predecessors were admitted before them.
+  try {
+    std::map<uint64_t, PipelineItem> pending;
+    uint64_t next = 0;
+    PipelineItem item;
+    while(state.queues.back()->Pop(item)) {
+      const uint64_t index = item.index;
+      pending[index] = std::move(item);
+      while(!pending.empty() &&
+            (!bOrdered || pending.begin()->first == next)) {
+        PipelineItem& ready = pending.begin()->second;
+        state.Release(ready.data.size());
+        Timed(snk, [&] { sink(ready); }, ready);
+        pending.erase(pending.begin());
+        ++next;
+      }
+    }
+  } catch(...) {
+    state.Abort(std::current_exception());
+  }
+
+  for(size_t i=0; i < threads.size(); ++i) threads[i].join();
+  m_iPeakBytes = state.peak;
+  if(state.error) std::rethrow_exception(state.error);
+}
+
+uint64_t Pipeline::PeakBytes() const {
+  return m_iPeakBytes;
+}
+
+}
@@ -0,0 +1,129 @@
+/*
+   For more information, please see: http://software.sci.utah.edu
+
+   The MIT License
+
+   Copyright (c) 2016 Scientific Computing and Imaging Institute,
+   University of Utah.
+
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+*/
+
+
+/**
+  \file    Pipeline.h
+  \brief   Bounded, multi-threaded stage pipeline for out-of-core passes.
+*/
+
+#pragma once
+
+#ifndef TUVOK_PIPELINE_H
+#define TUVOK_PIPELINE_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "PerfRegistry.h"
+
+namespace tuvok {
+
+/// Unit of work travelling through a Pipeline, e.g. one brick.
+struct PipelineItem {
+  PipelineItem() : index(0) {}
+
+  uint64_t             index; ///< Position in which the source produced it.
+  std::vector<uint8_t> data;
+};
+
+/// Runs a source, any number of stages and a sink concurrently, connected by
+/// bounded queues, so that e.g. reading bricks, resampling, compression and
+/// writing overlap instead of running one after another.
+///
+/// The source and the sink run on one thread each, so they may keep file
+/// state; a stage runs on as many threads as it was added with, so it must
+/// be reentrant. Items leave a multi-threaded stage out of order; the sink
+/// receives them in source order unless told otherwise.
+///
+/// Memory is bounded by the budget: the source blocks while the bytes held
+/// by the items in flight exceed it. Items are charged once produced, and
+/// stages growing items can not be held back, so the budget may be overrun
+/// by one item plus the growth of the items in the stages. An item larger
+/// than the budget is admitted once nothing else is in flight.
+///
+/// Every stage, source and sink included, reports through two counters of
+/// the registry: '<name>.<stage>' gets the milliseconds spent per item
+/// (with a latency histogram, and a span in PerfTrace timelines) and
+/// '<name>.<stage>.MB' the megabytes the stage put out.
+///
+/// An exception thrown by any stage stops the pipeline; Run rethrows it once
+/// all threads have finished.
+class Pipeline {
+public:
+  /// Fills in the next item; returns false once there are no more items.
+  typedef std::function<bool (PipelineItem&)> Source;
+  typedef std::function<void (PipelineItem&)> Stage;
+
+  /// iMemBudget in bytes, 0 = unlimited. Every queue holds at most
+  /// iQueueLength items.
+  Pipeline(const std::string& name, PerfRegistry& perf,
+           uint64_t iMemBudget, size_t iQueueLength=4);
+  ~Pipeline();
+
+  /// Appends a stage, run by iThreads threads.
+  void AddStage(const std::string& name, Stage stage, size_t iThreads=1);
+
+  /// Runs all items through the stages; the sink runs on the calling thread.
+  void Run(const std::string& sourceName, Source source,
+           const std::string& sinkName, Stage sink, bool bOrdered=true);
+
+  /// Largest number of bytes that were in flight at once during Run.
+  uint64_t PeakBytes() const;
+
+private:
+  Pipeline(const Pipeline&); ///< unimplemented.
+
+  struct StageInfo {
+    std::string       name;
+    Stage             stage;
+    size_t            threads;
+    PerfCounterHandle time;
+    PerfCounterHandle megabytes;
+  };
+  struct State;
+
+  /// Registers the counters of a stage.
+  void RegisterCounters(StageInfo& info);
+  /// Runs fn on the item, accounting for it in the stage's counters.
+  void Timed(const StageInfo& info, const std::function<void ()>& fn,
+             const PipelineItem& item);
+
+  std::string            m_strName;
+  PerfRegistry&          m_Perf;
+  uint64_t               m_iMemBudget;
+  size_t                 m_iQueueLength;
+  std::vector<StageInfo> m_Stages;
+  uint64_t               m_iPeakBytes;
+};
+
+}
+
+#endif // TUVOK_PIPELINE_H
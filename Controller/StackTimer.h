@@ -4,25 +4,46 @@
 #include "Basics/PerfCounter.h"
 #include "Basics/Timer.h"
 #include "Controller.h"
+#include "PerfTrace.h"
 
 namespace tuvok {
 
 /// Simple mechanism for timing blocks of code.  Create a StackTimer on
 /// the stack and it will record timing information when it goes out of
-/// scope.  For example:
+/// scope, both into the counter's sum and into its latency histogram.
+/// While a trace is running (see PerfTrace), the scope is also added to the
+/// timeline.  For example:
 ///
 ///   if(doLongComplicatedTask) {
 ///     StackTimer task_identifier(PERF_DISK_READ);
 ///     this->Function();
 ///   }
+///
+/// Counters registered with MasterController::RegisterCounter work the
+/// same way:
+///
+///   static const PerfCounterHandle lz4 =
+///     Controller::Instance().RegisterCounter("io.lz4.decompress");
+///   StackTimer decompress(lz4);
 struct StackTimer {
-  StackTimer(enum PerfCounter pc) : counter(pc) {
+  StackTimer(enum PerfCounter pc) :
+    counter(pc),
+    traceBegin(PerfTrace::Enabled() ? PerfTrace::Now() : 0) {
+    timer.Start();
+  }
+  StackTimer(PerfCounterHandle pc) :
+    counter(pc),
+    traceBegin(PerfTrace::Enabled() && pc.Valid() ? PerfTrace::Now() : 0) {
     timer.Start();
   }
   ~StackTimer() {
-    Controller::Instance().IncrementPerfCounter(counter, timer.Elapsed());
+    Controller::Instance().RecordPerfLatency(counter, timer.Elapsed());
+    if(traceBegin != 0) {
+      PerfTrace::Record(static_cast<unsigned>(counter.id), traceBegin);
+    }
   }
-  enum PerfCounter counter;
+  PerfCounterHandle counter;
+  uint64_t traceBegin; ///< 0 if no trace was running at construction.
   Timer timer;
 };
 
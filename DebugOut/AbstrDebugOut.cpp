@@ -36,9 +36,138 @@
 
 #include <cstdarg>
 #include <cstdio>
+#include <algorithm>
 #include <cstring>
+#include <vector>
 #include "AbstrDebugOut.h"
 
+namespace {
+  const size_t iFormatBufferSize = 16384;
+
+  /// Formatting buffers, one per nesting level (a debug out may log while it
+  /// prints). Each thread allocates its own on first use, so concurrent
+  /// loggers neither share buffers nor need 16k of stack per message.
+  thread_local std::vector<std::vector<char>> tlsFormatBuffers;
+  thread_local size_t tlsFormatDepth = 0;
+
+  class FormatBuffer {
+    public:
+      FormatBuffer() {
+        if(tlsFormatBuffers.size() <= tlsFormatDepth) {
+          tlsFormatBuffers.resize(tlsFormatDepth+1);
+        }
+        std::vector<char>& buff = tlsFormatBuffers[tlsFormatDepth++];
+        buff.resize(iFormatBufferSize);
+        m_pBuff = &buff[0];
+      }
+      ~FormatBuffer() { --tlsFormatDepth; }
+
+      /// Formats into the buffer and returns it.
+      const char* vformat(const char* format, va_list args) {
+#ifdef DETECTED_OS_WINDOWS
+        _vsnprintf_s(m_pBuff, iFormatBufferSize, _TRUNCATE, format, args);
+#else
+        vsnprintf(m_pBuff, iFormatBufferSize, format, args);
+#endif
+        return m_pBuff;
+      }
+
+    private:
+      char* m_pBuff;
+  };
+}
+
+RecordedMessageList::RecordedMessageList() :
+  m_Ring(1000),
+  m_iHead(0),
+  m_iCount(0),
+  m_iDropped(0)
+{
+}
+
+void RecordedMessageList::push_back(const std::string& strMsg) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  if (m_Ring.empty()) {
+    ++m_iDropped;
+    return;
+  }
+
+  if (m_iCount > 0) {
+    Entry& last = m_Ring[(m_iHead + m_iCount - 1) % m_Ring.size()];
+    if (last.strMsg == strMsg) {
+      ++last.iRepeats;
+      return;
+    }
+  }
+
+  if (m_iCount == m_Ring.size()) {
+    // Overwrite the oldest entry.
+    m_iDropped += 1 + m_Ring[m_iHead].iRepeats;
+    m_iHead = (m_iHead + 1) % m_Ring.size();
+    --m_iCount;
+  }
+  Entry& e = m_Ring[(m_iHead + m_iCount) % m_Ring.size()];
+  e.strMsg = strMsg;
+  e.iRepeats = 0;
+  ++m_iCount;
+}
+
+void RecordedMessageList::clear() {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_iHead = 0;
+  m_iCount = 0;
+  m_iDropped = 0;
+}
+
+void RecordedMessageList::SetCapacity(size_t iCapacity) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  std::vector<Entry> ring(iCapacity);
+
+  // Keep the most recent entries.
+  size_t iKeep = std::min(m_iCount, iCapacity);
+  for (size_t i = 0; i < m_iCount - iKeep; ++i) {
+    m_iDropped += 1 + m_Ring[(m_iHead + i) % m_Ring.size()].iRepeats;
+  }
+  for (size_t i = 0; i < iKeep; ++i) {
+    ring[i] = m_Ring[(m_iHead + m_iCount - iKeep + i) % m_Ring.size()];
+  }
+  m_Ring.swap(ring);
+  m_iHead = 0;
+  m_iCount = iKeep;
+}
+
+size_t RecordedMessageList::GetCapacity() const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Ring.size();
+}
+
+size_t RecordedMessageList::size() const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_iCount;
+}
+
+uint64_t RecordedMessageList::GetDroppedCount() const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_iDropped;
+}
+
+std::vector<std::string> RecordedMessageList::GetMessages() const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  std::vector<std::string> msgs;
+  msgs.reserve(m_iCount);
+  for (size_t i = 0; i < m_iCount; ++i) {
+    const Entry& e = m_Ring[(m_iHead + i) % m_Ring.size()];
+    msgs.push_back(e.strMsg);
+    if (e.iRepeats > 0) {
+      char buff[64];
+      snprintf(buff, sizeof(buff), "last message repeated %llu times",
+               static_cast<unsigned long long>(e.iRepeats));
+      msgs.push_back(buff);
+    }
+  }
+  return msgs;
+}
+
 const char *AbstrDebugOut::ChannelToString(enum DebugChannel c) const
 {
   switch(c) {
@@ -68,97 +197,94 @@ bool AbstrDebugOut::Enabled(enum DebugChannel channel) const
 void AbstrDebugOut::Other(const char *source, const char* format, ...)
 {
   if (!m_bShowOther) return;
-  char buff[16384];
+  FormatBuffer buff;
 
   va_list args;
   va_start(args, format);
-#ifdef DETECTED_OS_WINDOWS
-  _vsnprintf_s(buff, 16384, sizeof(buff), format, args);
-#else
-  vsnprintf(buff, sizeof(buff), format, args);
-#endif
+  const char* msg = buff.vformat(format, args);
   va_end(args);
 
-  this->printf(CHANNEL_OTHER, source, buff);
+  this->printf(CHANNEL_OTHER, source, msg);
 }
 
 void AbstrDebugOut::Message(const char* source, const char* format, ...)
 {
-  if (!m_bShowMessages) return;
-  char buff[16384];
+  if (!Wanted(CHANNEL_MESSAGE, m_bShowMessages)) return;
+  FormatBuffer buff;
 
   va_list args;
   va_start(args, format);
-#ifdef DETECTED_OS_WINDOWS
-  _vsnprintf_s(buff, 16384, sizeof(buff), format, args);
-#else
-  vsnprintf(buff, sizeof(buff), format, args);
-#endif
+  const char* msg = buff.vformat(format, args);
   va_end(args);
 
-  this->printf(CHANNEL_MESSAGE, source, buff);
+  if (m_bRecordLists[CHANNEL_MESSAGE]) {
+    m_strLists[CHANNEL_MESSAGE].push_back(std::string(source) + ": " + msg);
+  }
+  if (m_bShowMessages) this->printf(CHANNEL_MESSAGE, source, msg);
 }
 void AbstrDebugOut::Warning(const char* source, const char* format, ...)
 {
-  if (!m_bShowWarnings) return;
-  char buff[16384];
+  if (!Wanted(CHANNEL_WARNING, m_bShowWarnings)) return;
+  FormatBuffer buff;
 
   va_list args;
   va_start(args, format);
-#ifdef DETECTED_OS_WINDOWS
-  _vsnprintf_s(buff, 16384, sizeof(buff), format, args);
-#else
-  vsnprintf(buff, sizeof(buff), format, args);
-#endif
+  const char* msg = buff.vformat(format, args);
   va_end(args);
 
-  this->printf(CHANNEL_WARNING, source, buff);
+  if (m_bRecordLists[CHANNEL_WARNING]) {
+    m_strLists[CHANNEL_WARNING].push_back(std::string(source) + ": " + msg);
+  }
+  if (m_bShowWarnings) this->printf(CHANNEL_WARNING, source, msg);
 }
 void AbstrDebugOut::Error(const char* source, const char* format, ...)
 {
-  if (!m_bShowErrors) return;
-  char buff[16384];
+  if (!Wanted(CHANNEL_ERROR, m_bShowErrors)) return;
+  FormatBuffer buff;
 
   va_list args;
   va_start(args, format);
-#ifdef DETECTED_OS_WINDOWS
-  _vsnprintf_s(buff, 16384, sizeof(buff), format, args);
-#else
-  vsnprintf(buff, sizeof(buff), format, args);
-#endif
+  const char* msg = buff.vformat(format, args);
   va_end(args);
 
-  this->printf(CHANNEL_ERROR, source, buff);
+  if (m_bRecordLists[CHANNEL_ERROR]) {
+    m_strLists[CHANNEL_ERROR].push_back(std::string(source) + ": " + msg);
+  }
+  if (m_bShowErrors) this->printf(CHANNEL_ERROR, source, msg);
 }
 
-void AbstrDebugOut::PrintErrorList() {
-  printf( "Printing recorded errors:" );
-  for (std::deque<std::string>::const_iterator i =
-         m_strLists[CHANNEL_ERROR].begin();
-       i != m_strLists[CHANNEL_ERROR].end(); ++i) {
+void AbstrDebugOut::PrintList(enum DebugChannel channel, const char* name) {
+  const RecordedMessageList& list = m_strLists[channel];
+  std::string line = std::string("Printing recorded ") + name + ":";
+  printf( line.c_str() );
+
+  uint64_t iDropped = list.GetDroppedCount();
+  if (iDropped > 0) {
+    char buff[128];
+    snprintf(buff, sizeof(buff), "(%llu older %s dropped)",
+             static_cast<unsigned long long>(iDropped), name);
+    printf( buff );
+  }
+
+  std::vector<std::string> msgs = list.GetMessages();
+  for (std::vector<std::string>::const_iterator i = msgs.begin();
+       i != msgs.end(); ++i) {
     printf( i->c_str() );
   }
-  printf( "end of recorded errors" );
+  line = std::string("end of recorded ") + name;
+  printf( line.c_str() );
+}
+
+void AbstrDebugOut::PrintErrorList() {
+  PrintList(CHANNEL_ERROR, "errors");
 }
 
 void AbstrDebugOut::PrintWarningList() {
-  printf( "Printing recorded errors:" );
-  for (std::deque<std::string>::const_iterator i =
-         m_strLists[CHANNEL_WARNING].begin();
-       i != m_strLists[CHANNEL_WARNING].end(); ++i) {
-    printf( i->c_str() );
-  }
-  printf( "end of recorded errors" );
+  PrintList(CHANNEL_WARNING, "warnings");
 }
 
 void AbstrDebugOut::PrintMessageList() {
-  printf( "Printing recorded errors:" );
-  for (std::deque<std::string>::const_iterator i =
-         m_strLists[CHANNEL_MESSAGE].begin();
-       i != m_strLists[CHANNEL_MESSAGE].end(); ++i) {
-    printf( i->c_str() );
-  }
-  printf( "end of recorded errors" );
+  PrintList(CHANNEL_MESSAGE, "messages");
 }
 
 void AbstrDebugOut::SetOutput(bool bShowErrors,
@@ -43,9 +43,51 @@
 
 #include "../StdTuvokDefines.h"
 #include <array>
+#include <atomic>
 #include <cstdarg>
-#include <deque>
+#include <cstdint>
+#include <mutex>
 #include <string>
+#include <vector>
+
+/// Bounded list of recorded messages with ring buffer semantics: once full,
+/// each new message replaces the oldest one. Consecutive repeats of a
+/// message are stored once, with a repeat count.
+class RecordedMessageList {
+  public:
+    RecordedMessageList();
+
+    void push_back(const std::string& strMsg);
+    void clear();
+
+    /// Shrinking drops the oldest messages. A capacity of 0 disables the
+    /// list.
+    void SetCapacity(size_t iCapacity);
+    size_t GetCapacity() const;
+
+    /// Number of distinct (coalesced) messages in the list.
+    size_t size() const;
+    /// Messages overwritten or rejected because the list was full.
+    uint64_t GetDroppedCount() const;
+
+    /// The recorded messages, oldest first. A repeated message is followed
+    /// by "last message repeated N times".
+    std::vector<std::string> GetMessages() const;
+
+  private:
+    RecordedMessageList(const RecordedMessageList&); ///< unimplemented.
+
+    struct Entry {
+      std::string strMsg;
+      uint64_t    iRepeats;
+    };
+
+    mutable std::mutex m_Mutex;
+    std::vector<Entry> m_Ring;
+    size_t             m_iHead;   ///< Oldest entry.
+    size_t             m_iCount;
+    uint64_t           m_iDropped;
+};
 
 class AbstrDebugOut {
   public:
@@ -96,12 +138,22 @@ class AbstrDebugOut {
     virtual void ClearWarningList() { m_strLists[CHANNEL_WARNING].clear(); }
     virtual void ClearMessageList() { m_strLists[CHANNEL_MESSAGE].clear(); }
 
-    virtual void SetListRecordingErrors(bool bRecord)   {m_bRecordLists[0] = bRecord;}
-    virtual void SetListRecordingWarnings(bool bRecord) {m_bRecordLists[1] = bRecord;}
-    virtual void SetListRecordingMessages(bool bRecord) {m_bRecordLists[2] = bRecord;}
-    virtual bool GetListRecordingErrors()   {return m_bRecordLists[0];}
-    virtual bool GetListRecordingWarnings() {return m_bRecordLists[1];}
-    virtual bool GetListRecordingMessages() {return m_bRecordLists[2];}
+    virtual void SetListRecordingErrors(bool bRecord)   {m_bRecordLists[CHANNEL_ERROR] = bRecord;}
+    virtual void SetListRecordingWarnings(bool bRecord) {m_bRecordLists[CHANNEL_WARNING] = bRecord;}
+    virtual void SetListRecordingMessages(bool bRecord) {m_bRecordLists[CHANNEL_MESSAGE] = bRecord;}
+    virtual bool GetListRecordingErrors()   {return m_bRecordLists[CHANNEL_ERROR];}
+    virtual bool GetListRecordingWarnings() {return m_bRecordLists[CHANNEL_WARNING];}
+    virtual bool GetListRecordingMessages() {return m_bRecordLists[CHANNEL_MESSAGE];}
+
+    /// Maximum number of distinct messages recorded for the channel
+    /// (default 1000). Older messages are dropped once the list is full.
+    void SetListCapacity(enum DebugChannel channel, size_t iCapacity) {
+      m_strLists[channel].SetCapacity(iCapacity);
+    }
+    /// Number of recorded messages dropped from the channel's list.
+    uint64_t GetListDroppedCount(enum DebugChannel channel) const {
+      return m_strLists[channel].GetDroppedCount();
+    }
 
     void SetOutput(bool bShowErrors, bool bShowWarnings, bool bShowMessages,
                    bool bShowOther);
@@ -119,13 +171,20 @@ class AbstrDebugOut {
     virtual void SetShowOther(bool bShowOther);
 
 protected:
-    bool                      m_bShowMessages;
-    bool                      m_bShowWarnings;
-    bool                      m_bShowErrors;
-    bool                      m_bShowOther;
-
-    std::array<bool, CHANNEL_FINAL> m_bRecordLists;
-    std::array<std::deque<std::string>, CHANNEL_FINAL> m_strLists;
+    /// Atomic, since channels may be toggled while other threads log.
+    std::atomic<bool>         m_bShowMessages;
+    std::atomic<bool>         m_bShowWarnings;
+    std::atomic<bool>         m_bShowErrors;
+    std::atomic<bool>         m_bShowOther;
+
+    std::array<std::atomic<bool>, CHANNEL_FINAL> m_bRecordLists;
+    std::array<RecordedMessageList, CHANNEL_FINAL> m_strLists;
+
+    /// True if the channel is either shown or recorded.
+    bool Wanted(enum DebugChannel channel, bool bShow) const {
+      return bShow || m_bRecordLists[channel];
+    }
+    void PrintList(enum DebugChannel channel, const char* name);
 
     void ReplaceSpecialChars(char* buff, size_t iSize) const;
 };
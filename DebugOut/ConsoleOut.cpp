@@ -62,14 +62,8 @@ ConsoleOut::~ConsoleOut() {
 void ConsoleOut::printf(enum DebugChannel channel, const char* source,
                         const char* msg)
 {
-  char buff[16384] = {0};
 #ifdef DETECTED_OS_WINDOWS
-  strncpy_s(buff, 16384, msg, 16384);
-#else
-  strncpy(buff, msg, 16384);
-#endif
-#ifdef DETECTED_OS_WINDOWS
-  Console::printf("%s (%s): %s\n", ChannelToString(channel), source, buff);
+  Console::printf("%s (%s): %s\n", ChannelToString(channel), source, msg);
 #else
   const char *color = C_NORM;
   switch(channel) {
@@ -81,7 +75,7 @@ void ConsoleOut::printf(enum DebugChannel channel, const char* source,
     case CHANNEL_OTHER:   color = C_LBLUE; break;
   }
   Console::printf("%s%s%s (%s): %s\n", color, ChannelToString(channel), C_NORM,
-                  source, buff);
+                  source, msg);
 #endif
 }
 void ConsoleOut::printf(const char *s) const
@@ -37,6 +37,8 @@
 #include <algorithm>
 #include <cstdio>
 #include <functional>
+#include <iterator>
+#include <thread>
 #include <stdarg.h>
 #include "MultiplexOut.h"
 
@@ -54,71 +56,191 @@
 
 using namespace std;
 
+// Everything is enabled until a multiplexer publishes its channels.
+std::atomic<unsigned int> MultiplexOut::s_iChannelMask(~0u);
+
+class MultiplexOut::ReadGuard {
+  public:
+    explicit ReadGuard(const MultiplexOut& mux) {
+      // Register in the current epoch, then make sure it is still current.
+      // Otherwise a writer may already have checked that epoch for readers
+      // and moved on.
+      for(;;) {
+        unsigned int iEpoch = mux.m_iEpoch.load();
+        m_pReaders = &mux.m_iReaders[iEpoch & 1];
+        m_pReaders->fetch_add(1);
+        if(mux.m_iEpoch.load() == iEpoch) break;
+        m_pReaders->fetch_sub(1);
+      }
+      m_pList = mux.m_pSinks.load();
+    }
+    ~ReadGuard() { m_pReaders->fetch_sub(1); }
+
+    const std::vector<AbstrDebugOut*>& Sinks() const {
+      return m_pList->m_vpDebugger;
+    }
+
+  private:
+    std::atomic<int>* m_pReaders;
+    const SinkList*   m_pList;
+};
+
+MultiplexOut::MultiplexOut(bool bPublishChannelMask) :
+  m_pSinks(new SinkList()),
+  m_iEpoch(0),
+  m_bPublishChannelMask(bPublishChannelMask)
+{
+  m_iReaders[0].store(0);
+  m_iReaders[1].store(0);
+}
+
 MultiplexOut::~MultiplexOut() {
-  for (size_t i = 0;i<m_vpDebugger.size();i++) {
-    m_vpDebugger[i]->Other(_func_, "Shutting down");
-    delete m_vpDebugger[i];
+  const SinkList* pList = m_pSinks.load();
+  for (size_t i = 0;i<pList->m_vpDebugger.size();i++) {
+    pList->m_vpDebugger[i]->Other(_func_, "Shutting down");
+    delete pList->m_vpDebugger[i];
+  }
+  delete pList;
+
+  if (m_bPublishChannelMask) {
+    s_iChannelMask.store(~0u, memory_order_relaxed);
+  }
+}
+
+std::unique_ptr<const MultiplexOut::SinkList>
+MultiplexOut::Publish(SinkList* pList) {
+  std::unique_ptr<const SinkList> pOld(m_pSinks.exchange(pList));
+
+  // Readers that register from now on only see pList. Those that registered
+  // before might still hold pOld; they are all counted in the old epoch.
+  unsigned int iOldEpoch = m_iEpoch.fetch_add(1);
+  const std::atomic<int>& readers = m_iReaders[iOldEpoch & 1];
+  while(readers.load() != 0) {
+    std::this_thread::yield();
+  }
+  return pOld;
+}
+
+void MultiplexOut::UpdateChannelMask() {
+  if (!m_bPublishChannelMask) return;
+
+  // Without debug outs, the MasterController logs to its default output;
+  // that output filters the channels itself.
+  unsigned int mask = ~0u;
+  if (!empty()) {
+    mask = (1u << CHANNEL_NONE) | (1u << CHANNEL_FINAL);
+    // Recorded channels are needed even when they are not shown.
+    if (Wanted(CHANNEL_ERROR, m_bShowErrors))     mask |= 1u << CHANNEL_ERROR;
+    if (Wanted(CHANNEL_WARNING, m_bShowWarnings)) mask |= 1u << CHANNEL_WARNING;
+    if (Wanted(CHANNEL_MESSAGE, m_bShowMessages)) mask |= 1u << CHANNEL_MESSAGE;
+    if (Wanted(CHANNEL_OTHER, m_bShowOther))      mask |= 1u << CHANNEL_OTHER;
   }
+  s_iChannelMask.store(mask, memory_order_relaxed);
 }
 
 void MultiplexOut::AddDebugOut(AbstrDebugOut* pDebugger) {
-  m_vpDebugger.push_back(pDebugger);
+  std::lock_guard<std::mutex> lock(m_WriteMutex);
+
+  SinkList* pList = new SinkList();
+  pList->m_vpDebugger = m_pSinks.load()->m_vpDebugger;
+  pList->m_vpDebugger.push_back(pDebugger);
+  Publish(pList);
   pDebugger->Other(_func_,"Operating as part of a multiplexed debug out now.");
 
   // Find the maximal set of channels to enable.
-  m_bShowMessages |= pDebugger->ShowMessages();
-  m_bShowWarnings |= pDebugger->ShowWarnings();
-  m_bShowErrors |= pDebugger->ShowErrors();
-  m_bShowOther |= pDebugger->ShowOther();
+  if (pDebugger->ShowMessages()) m_bShowMessages = true;
+  if (pDebugger->ShowWarnings()) m_bShowWarnings = true;
+  if (pDebugger->ShowErrors())   m_bShowErrors = true;
+  if (pDebugger->ShowOther())    m_bShowOther = true;
+  UpdateChannelMask();
 }
 
 void MultiplexOut::RemoveDebugOut(AbstrDebugOut* pDebugger) {
-  std::vector<AbstrDebugOut*>::iterator del;
+  std::lock_guard<std::mutex> lock(m_WriteMutex);
 
-  del = std::find(m_vpDebugger.begin(), m_vpDebugger.end(), pDebugger);
-
-  if(del != m_vpDebugger.end()) {
-    delete *del;
-    m_vpDebugger.erase(del);
+  const std::vector<AbstrDebugOut*>& current = m_pSinks.load()->m_vpDebugger;
+  if(std::find(current.begin(), current.end(), pDebugger) == current.end()) {
+    return;
   }
+
+  SinkList* pList = new SinkList();
+  std::remove_copy(current.begin(), current.end(),
+                   std::back_inserter(pList->m_vpDebugger), pDebugger);
+  Publish(pList);
+  delete pDebugger;
+  UpdateChannelMask();
 }
 
 
 void MultiplexOut::printf(enum DebugChannel channel, const char* source,
                           const char* msg)
 {
-  for (size_t i = 0;i<m_vpDebugger.size();i++) {
-    if(m_vpDebugger[i]->Enabled(channel)) {
-      m_vpDebugger[i]->printf(channel, source, msg);
+  ReadGuard guard(*this);
+  const std::vector<AbstrDebugOut*>& sinks = guard.Sinks();
+  for (size_t i = 0;i<sinks.size();i++) {
+    if(sinks[i]->Enabled(channel)) {
+      sinks[i]->printf(channel, source, msg);
     }
   }
 }
 
 void MultiplexOut::printf(const char *s) const
 {
-  for (size_t i = 0;i<m_vpDebugger.size();i++) {
-    m_vpDebugger[i]->printf(s);
+  ReadGuard guard(*this);
+  const std::vector<AbstrDebugOut*>& sinks = guard.Sinks();
+  for (size_t i = 0;i<sinks.size();i++) {
+    sinks[i]->printf(s);
   }
 }
 
 void MultiplexOut::SetShowMessages(bool bShowMessages) {
+  std::lock_guard<std::mutex> lock(m_WriteMutex);
   AbstrDebugOut::SetShowMessages(bShowMessages);
-  for (size_t i = 0;i<m_vpDebugger.size();i++) m_vpDebugger[i]->SetShowMessages(bShowMessages);
+  const std::vector<AbstrDebugOut*>& sinks = m_pSinks.load()->m_vpDebugger;
+  for (size_t i = 0;i<sinks.size();i++) sinks[i]->SetShowMessages(bShowMessages);
+  UpdateChannelMask();
 }
 
 void MultiplexOut::SetShowWarnings(bool bShowWarnings) {
+  std::lock_guard<std::mutex> lock(m_WriteMutex);
   AbstrDebugOut::SetShowWarnings(bShowWarnings);
-  for (size_t i = 0;i<m_vpDebugger.size();i++) m_vpDebugger[i]->SetShowWarnings(bShowWarnings);
+  const std::vector<AbstrDebugOut*>& sinks = m_pSinks.load()->m_vpDebugger;
+  for (size_t i = 0;i<sinks.size();i++) sinks[i]->SetShowWarnings(bShowWarnings);
+  UpdateChannelMask();
 }
 
 void MultiplexOut::SetShowErrors(bool bShowErrors) {
+  std::lock_guard<std::mutex> lock(m_WriteMutex);
   AbstrDebugOut::SetShowErrors(bShowErrors);
-  for (size_t i = 0;i<m_vpDebugger.size();i++) m_vpDebugger[i]->SetShowErrors(bShowErrors);
+  const std::vector<AbstrDebugOut*>& sinks = m_pSinks.load()->m_vpDebugger;
+  for (size_t i = 0;i<sinks.size();i++) sinks[i]->SetShowErrors(bShowErrors);
+  UpdateChannelMask();
 }
 
 void MultiplexOut::SetShowOther(bool bShowOther) {
+  std::lock_guard<std::mutex> lock(m_WriteMutex);
   AbstrDebugOut::SetShowOther(bShowOther);
-  for (size_t i = 0;i<m_vpDebugger.size();i++) m_vpDebugger[i]->SetShowOther(bShowOther);
+  const std::vector<AbstrDebugOut*>& sinks = m_pSinks.load()->m_vpDebugger;
+  for (size_t i = 0;i<sinks.size();i++) sinks[i]->SetShowOther(bShowOther);
+  UpdateChannelMask();
+}
+
+void MultiplexOut::SetListRecordingErrors(bool bRecord) {
+  std::lock_guard<std::mutex> lock(m_WriteMutex);
+  AbstrDebugOut::SetListRecordingErrors(bRecord);
+  UpdateChannelMask();
+}
+
+void MultiplexOut::SetListRecordingWarnings(bool bRecord) {
+  std::lock_guard<std::mutex> lock(m_WriteMutex);
+  AbstrDebugOut::SetListRecordingWarnings(bRecord);
+  UpdateChannelMask();
+}
+
+void MultiplexOut::SetListRecordingMessages(bool bRecord) {
+  std::lock_guard<std::mutex> lock(m_WriteMutex);
+  AbstrDebugOut::SetListRecordingMessages(bRecord);
+  UpdateChannelMask();
 }
 
 template <class T>
@@ -130,7 +252,10 @@ struct deleter : std::unary_function<T, void> {
 
 void MultiplexOut::clear()
 {
-  std::for_each(m_vpDebugger.begin(), m_vpDebugger.end(),
+  std::lock_guard<std::mutex> lock(m_WriteMutex);
+
+  std::unique_ptr<const SinkList> pOld = Publish(new SinkList());
+  std::for_each(pOld->m_vpDebugger.begin(), pOld->m_vpDebugger.end(),
                 deleter<AbstrDebugOut>());
-  m_vpDebugger.clear();
+  UpdateChannelMask();
 }
@@ -41,14 +41,32 @@
 #ifndef TUVOK_MULTIPLEXOUT_H
 #define TUVOK_MULTIPLEXOUT_H
 
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include "AbstrDebugOut.h"
 
+/// Debug outs can be added and removed while other threads log. The list of
+/// debug outs is copy-on-write: logging never takes a lock, and a removed
+/// debug out is only deleted once no thread is printing to it anymore.
+/// Debug outs must not add or remove debug outs from within their printf.
 class MultiplexOut : public AbstrDebugOut {
   public:
-    MultiplexOut() {}
+    /// If bPublishChannelMask is set, the channels this multiplexer shows are
+    /// published in a global mask (see ChannelEnabled). Only the
+    /// MasterController's multiplexer should do so.
+    explicit MultiplexOut(bool bPublishChannelMask=false);
     ~MultiplexOut();
 
+    /// False if messages on the given channel are certain to be dropped.
+    /// Lock-free; the logging macros check this before evaluating their
+    /// arguments.
+    static bool ChannelEnabled(enum DebugChannel channel) {
+      return (s_iChannelMask.load(std::memory_order_relaxed) &
+              (1u << channel)) != 0;
+    }
+
     void AddDebugOut(AbstrDebugOut* pDebugger);
     void RemoveDebugOut(AbstrDebugOut* pDebugger);
 
@@ -61,11 +79,41 @@ class MultiplexOut : public AbstrDebugOut {
     virtual void SetShowErrors(bool bShowErrors);
     virtual void SetShowOther(bool bShowOther);
 
-    size_t size() const { return m_vpDebugger.size(); }
-    bool empty() const { return m_vpDebugger.empty(); }
+    virtual void SetListRecordingErrors(bool bRecord);
+    virtual void SetListRecordingWarnings(bool bRecord);
+    virtual void SetListRecordingMessages(bool bRecord);
+
+    size_t size() const { return m_pSinks.load()->m_vpDebugger.size(); }
+    bool empty() const { return m_pSinks.load()->m_vpDebugger.empty(); }
     void clear();
 
   private:
-    std::vector<AbstrDebugOut*> m_vpDebugger;
+    MultiplexOut(const MultiplexOut&); ///< unimplemented.
+
+    /// Immutable once published.
+    struct SinkList {
+      std::vector<AbstrDebugOut*> m_vpDebugger;
+    };
+    /// Keeps the SinkList current at construction alive for the lifetime of
+    /// the guard.
+    class ReadGuard;
+
+    /// Makes pList the current list and waits until no reader can still see
+    /// the previous one, which is returned. Requires m_WriteMutex.
+    std::unique_ptr<const SinkList> Publish(SinkList* pList);
+
+    /// Republishes the global channel mask after a change to our channels.
+    void UpdateChannelMask();
+
+    std::atomic<const SinkList*> m_pSinks;
+    /// Readers register in the counter of the epoch they started in. Publish
+    /// flips the epoch and waits for the old epoch's readers to leave.
+    mutable std::atomic<unsigned int> m_iEpoch;
+    mutable std::atomic<int> m_iReaders[2];
+    std::mutex m_WriteMutex;  ///< Serializes writers only.
+    bool m_bPublishChannelMask;
+
+    /// Bit (1 << channel) is set for every channel that may produce output.
+    static std::atomic<unsigned int> s_iChannelMask;
 };
 #endif // TUVOK_MULTIPLEXOUT_H
@@ -0,0 +1,326 @@
+/*
+   For more information, please see: http://software.sci.utah.edu
+
+   The MIT License
+
+   Copyright (c) 2016 Scientific Computing and Imaging Institute,
+   University of Utah.
+
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  \file    StructuredOut.cpp
+  \brief   Debug out for machine ingestion: JSON lines or binary records.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include "StructuredOut.h"
+
+#ifdef DETECTED_OS_WINDOWS
+  #include <windows.h>
+  // undef stupid windows defines to max and min
+  #ifdef max
+  #undef max
+  #endif
+
+  #ifdef min
+  #undef min
+  #endif
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+  // Room kept at the end of a mapping for the overflow notice.
+  const uint64_t OVERFLOW_NOTICE_RESERVE = 256;
+
+  uint64_t NowNS() {
+    return static_cast<uint64_t>(
+      chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count());
+  }
+
+  uint64_t ThreadID() {
+    static thread_local uint64_t tid =
+      static_cast<uint64_t>(hash<thread::id>()(this_thread::get_id()));
+    return tid;
+  }
+
+  void AppendJSONString(string& out, const char* s) {
+    static const char hex[] = "0123456789abcdef";
+    out += '"';
+    for(; *s != 0; ++s) {
+      unsigned char c = static_cast<unsigned char>(*s);
+      switch(c) {
+        case '"':  out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+          if(c < 0x20) {
+            out += "\\u00";
+            out += hex[c >> 4];
+            out += hex[c & 0xf];
+          } else {
+            out += static_cast<char>(c);
+          }
+      }
+    }
+    out += '"';
+  }
+
+  template <typename T> void AppendBinary(string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+}
+
+StructuredOut::StructuredOut(const std::string& strFilename, Format format,
+                             uint64_t iMapSize) :
+  m_strFilename(strFilename),
+  m_Format(format),
+  m_pFile(NULL),
+  m_pMap(NULL),
+  m_iMapSize(0),
+  m_iMapOffset(0),
+#ifdef DETECTED_OS_WINDOWS
+  m_hFile(INVALID_HANDLE_VALUE),
+  m_hMapping(NULL),
+#else
+  m_iFD(-1),
+#endif
+  m_iDropped(0)
+{
+  if(iMapSize == 0 || !OpenMapping(iMapSize)) {
+    m_pFile = fopen(m_strFilename.c_str(), "ab");
+  }
+  this->Message(_func_, "Starting up");
+}
+
+StructuredOut::~StructuredOut() {
+  this->Message(_func_, "Shutting down");
+  if(m_pMap) {
+    CloseMapping();
+  }
+  if(m_pFile) {
+    fclose(m_pFile);
+  }
+}
+
+void StructuredOut::printf(enum DebugChannel channel, const char* source,
+                           const char* msg)
+{
+  Write(channel, source, msg);
+}
+
+void StructuredOut::printf(const char *s) const
+{
+  Write(CHANNEL_NONE, "", s);
+}
+
+void StructuredOut::Write(enum DebugChannel channel, const char* source,
+                          const char* msg) const
+{
+  // Reused, so that steady state logging does not allocate.
+  static thread_local string record;
+  record.clear();
+  Encode(record, channel, source, msg);
+
+  if(m_pMap) {
+    uint64_t offset;
+    uint64_t limit = m_iMapSize - std::min(m_iMapSize, OVERFLOW_NOTICE_RESERVE);
+    if(!ClaimMapped(record.size(), limit, offset)) {
+      if(m_iDropped.fetch_add(1) == 0) {
+        WriteOverflowNotice();
+      }
+      return;
+    }
+    memcpy(m_pMap + offset, record.data(), record.size());
+  } else if(m_pFile) {
+    lock_guard<mutex> lock(m_FileMutex);
+    fwrite(record.data(), 1, record.size(), m_pFile);
+    // Errors are likely followed by a crash; make sure they made it out.
+    if(channel == CHANNEL_ERROR) {
+      fflush(m_pFile);
+    }
+  }
+}
+
+void StructuredOut::Encode(string& record, enum DebugChannel channel,
+                           const char* source, const char* msg) const
+{
+  if(m_Format == FMT_JSON_LINES) {
+    EncodeJSON(record, NowNS(), ThreadID(), channel, source, msg);
+  } else {
+    EncodeBinary(record, NowNS(), ThreadID(), channel, source, msg);
+  }
+}
+
+bool StructuredOut::ClaimMapped(uint64_t size, uint64_t limit,
+                                uint64_t& offset) const
+{
+  // The offset never moves past the limit, so it always marks the end of the
+  // claimed records, even once records are being dropped.
+  offset = m_iMapOffset.load();
+  do {
+    if(offset + size > limit) return false;
+  } while(!m_iMapOffset.compare_exchange_weak(offset, offset + size));
+  return true;
+}
+
+void StructuredOut::WriteOverflowNotice() const
+{
+  string notice;
+  Encode(notice, CHANNEL_ERROR, _func_,
+         "Log file is full; further records are dropped");
+
+  // Only this record may use the reserved room at the end of the mapping.
+  uint64_t offset;
+  if(ClaimMapped(notice.size(), m_iMapSize, offset)) {
+    memcpy(m_pMap + offset, notice.data(), notice.size());
+  }
+}
+
+void StructuredOut::EncodeJSON(string& record, uint64_t ns, uint64_t tid,
+                               enum DebugChannel channel, const char* source,
+                               const char* msg) const
+{
+  char numbers[64];
+  snprintf(numbers, sizeof(numbers), "{\"ns\":%llu,\"tid\":%llu,",
+           static_cast<unsigned long long>(ns),
+           static_cast<unsigned long long>(tid));
+  record += numbers;
+  record += "\"channel\":";
+  AppendJSONString(record, ChannelToString(channel));
+  record += ",\"source\":";
+  AppendJSONString(record, source);
+  record += ",\"msg\":";
+  AppendJSONString(record, msg);
+  record += "}\n";
+}
+
+void StructuredOut::EncodeBinary(string& record, uint64_t ns, uint64_t tid,
+                                 enum DebugChannel channel,
+                                 const char* source, const char* msg) const
+{
+  size_t srcLen = std::min<size_t>(strlen(source), 0xffff);
+  uint32_t msgLen = static_cast<uint32_t>(strlen(msg));
+  uint32_t size = static_cast<uint32_t>(sizeof(uint32_t) + 2*sizeof(uint64_t)
+                                        + sizeof(uint8_t) + sizeof(uint16_t)
+                                        + srcLen + sizeof(uint32_t) + msgLen);
+  AppendBinary(record, size);
+  AppendBinary(record, ns);
+  AppendBinary(record, tid);
+  AppendBinary(record, static_cast<uint8_t>(channel));
+  AppendBinary(record, static_cast<uint16_t>(srcLen));
+  record.append(source, srcLen);
+  AppendBinary(record, msgLen);
+  record.append(msg, msgLen);
+}
+
+#ifdef DETECTED_OS_WINDOWS
+
+bool StructuredOut::OpenMapping(uint64_t iMapSize) {
+  m_hFile = CreateFileA(m_strFilename.c_str(), GENERIC_READ | GENERIC_WRITE,
+                        FILE_SHARE_READ, NULL, CREATE_ALWAYS,
+                        FILE_ATTRIBUTE_NORMAL, NULL);
+  if(m_hFile == INVALID_HANDLE_VALUE) return false;
+
+  m_hMapping = CreateFileMappingA(m_hFile, NULL, PAGE_READWRITE,
+                                  static_cast<DWORD>(iMapSize >> 32),
+                                  static_cast<DWORD>(iMapSize), NULL);
+  if(m_hMapping != NULL) {
+    m_pMap = static_cast<char*>(MapViewOfFile(m_hMapping, FILE_MAP_WRITE,
+                                              0, 0, 0));
+  }
+  if(m_pMap == NULL) {
+    if(m_hMapping != NULL) CloseHandle(m_hMapping);
+    CloseHandle(m_hFile);
+    m_hMapping = NULL;
+    m_hFile = INVALID_HANDLE_VALUE;
+    return false;
+  }
+
+  m_iMapSize = iMapSize;
+  return true;
+}
+
+void StructuredOut::CloseMapping() {
+  uint64_t end = m_iMapOffset.load();
+
+  UnmapViewOfFile(m_pMap);
+  CloseHandle(m_hMapping);
+  m_pMap = NULL;
+
+  // Cut off the unused, preallocated part.
+  LARGE_INTEGER pos;
+  pos.QuadPart = static_cast<LONGLONG>(end);
+  SetFilePointerEx(m_hFile, pos, NULL, FILE_BEGIN);
+  SetEndOfFile(m_hFile);
+  CloseHandle(m_hFile);
+}
+
+#else
+
+bool StructuredOut::OpenMapping(uint64_t iMapSize) {
+  m_iFD = open(m_strFilename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if(m_iFD < 0) return false;
+
+  if(ftruncate(m_iFD, static_cast<off_t>(iMapSize)) == 0) {
+    void* map = mmap(NULL, static_cast<size_t>(iMapSize),
+                     PROT_READ | PROT_WRITE, MAP_SHARED, m_iFD, 0);
+    if(map != MAP_FAILED) {
+      m_pMap = static_cast<char*>(map);
+    }
+  }
+  if(m_pMap == NULL) {
+    close(m_iFD);
+    m_iFD = -1;
+    return false;
+  }
+
+  m_iMapSize = iMapSize;
+  return true;
+}
+
+void StructuredOut::CloseMapping() {
+  uint64_t end = m_iMapOffset.load();
+
+  munmap(m_pMap, static_cast<size_t>(m_iMapSize));
+  m_pMap = NULL;
+
+  // Cut off the unused, preallocated part.
+  if(ftruncate(m_iFD, static_cast<off_t>(end)) != 0) {
+    // Nothing we can do; readers stop at the first zero size/byte.
+  }
+  close(m_iFD);
+  m_iFD = -1;
+}
+
+#endif
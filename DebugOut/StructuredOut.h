@@ -0,0 +1,141 @@
+/*
+   For more information, please see: http://software.sci.utah.edu
+
+   The MIT License
+
+   Copyright (c) 2016 Scientific Computing and Imaging Institute,
+   University of Utah.
+
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  \file    StructuredOut.h
+  \brief   Debug out for machine ingestion: JSON lines or binary records.
+*/
+
+
+#pragma once
+
+#ifndef TUVOK_STRUCTUREDOUT_H
+#define TUVOK_STRUCTUREDOUT_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include "AbstrDebugOut.h"
+
+/// Writes every message as a self-contained record carrying a monotonic
+/// timestamp in nanoseconds, the thread ID, channel, source and message.
+///
+/// FMT_JSON_LINES writes one JSON object per line:
+///   {"ns":123,"tid":456,"channel":"ERROR","source":"f","msg":"text"}
+/// Raw printf(const char*) output uses channel "".
+///
+/// FMT_BINARY writes records in host byte order:
+///   uint32 size of the whole record, in bytes
+///   uint64 nanoseconds
+///   uint64 thread ID
+///   uint8  channel (AbstrDebugOut::DebugChannel)
+///   uint16 source length, followed by the source (not terminated)
+///   uint32 message length, followed by the message (not terminated)
+///
+/// If iMapSize is nonzero, the file is preallocated to iMapSize bytes and
+/// memory mapped; records are then copied into the mapping without any
+/// system call or lock. Records that do not fit anymore are dropped (see
+/// GetDroppedRecords); the first drop is announced by an error record, for
+/// which room is kept at the end of the mapping. The file is truncated to the
+/// bytes written when the debug out is destroyed. Otherwise records are appended to the file with
+/// stdio, serialized by a mutex.
+class StructuredOut : public AbstrDebugOut {
+  public:
+    enum Format {
+      FMT_JSON_LINES,
+      FMT_BINARY
+    };
+
+    StructuredOut(const std::string& strFilename="logfile.jsonl",
+                  Format format=FMT_JSON_LINES, uint64_t iMapSize=0);
+    ~StructuredOut();
+
+    virtual void printf(enum DebugChannel, const char* source,
+                        const char* msg);
+    virtual void printf(const char *s) const;
+
+    const std::string& GetFileName() const {return m_strFilename;}
+    Format GetFormat() const {return m_Format;}
+    bool IsMapped() const {return m_pMap != NULL;}
+
+    /// Records dropped because the mapped file was full.
+    uint64_t GetDroppedRecords() const {return m_iDropped.load();}
+
+  private:
+    StructuredOut(const StructuredOut &); ///< unimplemented.
+
+    /// Serializes a record into a per-thread buffer and writes it.
+    void Write(enum DebugChannel channel, const char* source,
+               const char* msg) const;
+    void EncodeJSON(std::string& record, uint64_t ns, uint64_t tid,
+                    enum DebugChannel channel, const char* source,
+                    const char* msg) const;
+    void EncodeBinary(std::string& record, uint64_t ns, uint64_t tid,
+                      enum DebugChannel channel, const char* source,
+                      const char* msg) const;
+    void Encode(std::string& record, enum DebugChannel channel,
+                const char* source, const char* msg) const;
+
+    /// Claims size bytes of the mapping, without going past limit. Returns
+    /// false, leaving the mapping untouched, if the record does not fit.
+    bool ClaimMapped(uint64_t size, uint64_t limit, uint64_t& offset) const;
+    /// Writes the error record announcing that records are being dropped.
+    void WriteOverflowNotice() const;
+
+    bool OpenMapping(uint64_t iMapSize);
+    void CloseMapping();
+
+  private:
+    std::string m_strFilename;
+    Format      m_Format;
+
+    /// Stream mode.
+    ///@{
+    FILE*              m_pFile;
+    mutable std::mutex m_FileMutex;
+    ///@}
+
+    /// Mapped mode.
+    ///@{
+    char*                         m_pMap;
+    uint64_t                      m_iMapSize;
+    mutable std::atomic<uint64_t> m_iMapOffset;  ///< End of valid records.
+#ifdef DETECTED_OS_WINDOWS
+    void*                         m_hFile;
+    void*                         m_hMapping;
+#else
+    int                           m_iFD;
+#endif
+    ///@}
+
+    mutable std::atomic<uint64_t> m_iDropped;
+};
+
+#endif // TUVOK_STRUCTUREDOUT_H
@@ -34,7 +34,13 @@
   \date    August 2008
 */
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
 #include <fstream>
+#include <mutex>
+#include <thread>
 #include <stdarg.h>
 #ifdef WIN32
   #include <windows.h>
@@ -44,19 +50,263 @@
 
 using namespace std;
 
-TextfileOut::TextfileOut(std::string strFilename) :
+/// Number of records in the asynchronous queue. Must be a power of two.
+#define ASYNC_QUEUE_SIZE            (4096)
+#define ASYNC_DEFAULT_FLUSH_MS      (100)
+
+/// Bounded multi-producer single-consumer queue of log records, drained by a
+/// background thread that keeps the log file open.
+/// Producers claim a slot with a single CAS on the enqueue position; each
+/// slot carries a sequence number telling whether it is free or published.
+/// Slot strings are reused, so once warmed up enqueueing does not allocate.
+class TextfileOut::AsyncWriter {
+  public:
+    AsyncWriter(const TextfileOut* pOwner, const std::string& strFilename);
+    ~AsyncWriter();
+
+    void Push(enum DebugChannel channel, const char* source, const char* msg);
+    void Flush();
+    void SetFlushInterval(unsigned int iMilliseconds);
+
+  private:
+    struct Record {
+      std::atomic<size_t> m_iSequence;
+      time_t              m_Time;
+      DebugChannel        m_Channel;  ///< CHANNEL_NONE for raw printf's.
+      std::string         m_strSource;
+      std::string         m_strMsg;
+    };
+
+    void Run();
+    /// Writes all published records, until at least iTarget records have
+    /// been written in total.
+    void Drain(size_t iTarget);
+    void Write(const Record& r);
+    void WakeUp();
+
+    const TextfileOut*         m_pOwner;
+    std::unique_ptr<Record[]>  m_Ring;
+    const size_t               m_iMask;
+    std::atomic<size_t>        m_iEnqueuePos;
+    size_t                     m_iDequeuePos;  ///< Only used by the thread.
+    std::atomic<size_t>        m_iWritten;
+    std::atomic<size_t>        m_iFlushTarget;
+
+    std::ofstream              m_fs;
+    time_t                     m_LastTime;     ///< Cached timestamp.
+    char                       m_datetime[64];
+
+    std::mutex                 m_Mutex;
+    std::condition_variable    m_WakeUp;
+    std::condition_variable    m_Flushed;
+    bool                       m_bWakeRequested;
+    bool                       m_bStop;
+    std::chrono::milliseconds  m_FlushInterval;
+    std::thread                m_Thread;
+};
+
+TextfileOut::AsyncWriter::AsyncWriter(const TextfileOut* pOwner,
+                                      const std::string& strFilename) :
+  m_pOwner(pOwner),
+  m_Ring(new Record[ASYNC_QUEUE_SIZE]),
+  m_iMask(ASYNC_QUEUE_SIZE - 1),
+  m_iEnqueuePos(0),
+  m_iDequeuePos(0),
+  m_iWritten(0),
+  m_iFlushTarget(0),
+  m_LastTime(0),
+  m_bWakeRequested(false),
+  m_bStop(false),
+  m_FlushInterval(ASYNC_DEFAULT_FLUSH_MS)
+{
+  for(size_t i=0; i < ASYNC_QUEUE_SIZE; ++i) {
+    m_Ring[i].m_iSequence.store(i, memory_order_relaxed);
+  }
+  m_datetime[0] = 0;
+  m_fs.open(strFilename.c_str(), ios_base::app);
+  m_Thread = std::thread(&AsyncWriter::Run, this);
+}
+
+TextfileOut::AsyncWriter::~AsyncWriter() {
+  {
+    lock_guard<mutex> lock(m_Mutex);
+    m_bStop = true;
+  }
+  m_WakeUp.notify_one();
+  m_Thread.join();
+}
+
+void TextfileOut::AsyncWriter::Push(enum DebugChannel channel,
+                                    const char* source, const char* msg)
+{
+  size_t pos = m_iEnqueuePos.load(memory_order_relaxed);
+  Record* r;
+  for(;;) {
+    r = &m_Ring[pos & m_iMask];
+    size_t seq = r->m_iSequence.load(memory_order_acquire);
+    ptrdiff_t diff = static_cast<ptrdiff_t>(seq) - static_cast<ptrdiff_t>(pos);
+    if(diff == 0) {
+      if(m_iEnqueuePos.compare_exchange_weak(pos, pos+1,
+                                             memory_order_relaxed)) {
+        break;
+      }
+    } else if(diff < 0) {
+      // Queue is full; have the thread drain it and retry.
+      WakeUp();
+      std::this_thread::yield();
+      pos = m_iEnqueuePos.load(memory_order_relaxed);
+    } else {
+      pos = m_iEnqueuePos.load(memory_order_relaxed);
+    }
+  }
+
+  time(&r->m_Time);
+  r->m_Channel = channel;
+  r->m_strSource.assign(source);
+  r->m_strMsg.assign(msg);
+  r->m_iSequence.store(pos+1, memory_order_release);
+
+  // Don't wait for the flush interval once half of the queue is in use.
+  // Occupancy grows by one per push, so some producer sees it hit the mark;
+  // a wakeup lost to a racing drain is caught by the full queue path above.
+  size_t iUsed = pos + 1 - m_iWritten.load(memory_order_relaxed);
+  if(iUsed == (m_iMask + 1) / 2) {
+    WakeUp();
+  }
+}
+
+void TextfileOut::AsyncWriter::WakeUp() {
+  {
+    lock_guard<mutex> lock(m_Mutex);
+    m_bWakeRequested = true;
+  }
+  m_WakeUp.notify_one();
+}
+
+void TextfileOut::AsyncWriter::Flush() {
+  size_t iTarget = m_iEnqueuePos.load(memory_order_acquire);
+  unique_lock<mutex> lock(m_Mutex);
+  if(m_iFlushTarget.load() < iTarget) {
+    m_iFlushTarget.store(iTarget);
+  }
+  m_bWakeRequested = true;
+  m_WakeUp.notify_one();
+  m_Flushed.wait(lock, [&] { return m_iWritten.load() >= iTarget; });
+}
+
+void TextfileOut::AsyncWriter::SetFlushInterval(unsigned int iMilliseconds) {
+  lock_guard<mutex> lock(m_Mutex);
+  m_FlushInterval = std::chrono::milliseconds(iMilliseconds);
+}
+
+void TextfileOut::AsyncWriter::Run() {
+  unique_lock<mutex> lock(m_Mutex);
+  bool bStop = false;
+  while(!bStop) {
+    m_WakeUp.wait_for(lock, m_FlushInterval,
+                      [this] { return m_bWakeRequested || m_bStop; });
+    m_bWakeRequested = false;
+    bStop = m_bStop;
+    size_t iTarget = bStop ? m_iEnqueuePos.load() : m_iFlushTarget.load();
+
+    lock.unlock();
+    Drain(iTarget);
+    lock.lock();
+    m_Flushed.notify_all();
+  }
+}
+
+void TextfileOut::AsyncWriter::Drain(size_t iTarget) {
+  size_t iStart = m_iDequeuePos;
+  for(;;) {
+    Record& r = m_Ring[m_iDequeuePos & m_iMask];
+    size_t seq = r.m_iSequence.load(memory_order_acquire);
+    if(seq == m_iDequeuePos + 1) {
+      Write(r);
+      r.m_iSequence.store(m_iDequeuePos + m_iMask + 1, memory_order_release);
+      ++m_iDequeuePos;
+    } else if(m_iDequeuePos < iTarget) {
+      // A slot was claimed, but its producer has not published it yet.
+      std::this_thread::yield();
+    } else {
+      break;
+    }
+  }
+
+  if(m_iDequeuePos != iStart) {
+    m_fs.flush();
+    m_iWritten.store(m_iDequeuePos);
+  }
+}
+
+void TextfileOut::AsyncWriter::Write(const Record& r) {
+  if(m_fs.fail()) return;
+
+  // The timestamp has a resolution of seconds; only reformat when it changed.
+  if(r.m_Time != m_LastTime) {
+#ifdef DETECTED_OS_WINDOWS
+    struct tm now;
+    localtime_s(&now, &r.m_Time);
+#else
+    struct tm now;
+    localtime_r(&r.m_Time, &now);
+#endif
+    if(strftime(m_datetime, 64, "(%d.%m.%Y %H:%M:%S)", &now) == 0) {
+      m_datetime[0] = 0;
+    }
+    m_LastTime = r.m_Time;
+  }
+
+  if(m_datetime[0] != 0) {
+    m_fs << m_datetime << " ";
+  }
+  if(r.m_Channel == CHANNEL_NONE) {
+    m_fs << r.m_strMsg << "\n";
+  } else {
+    m_fs << m_pOwner->ChannelToString(r.m_Channel) << " (" << r.m_strSource
+         << ") " << r.m_strMsg << "\n";
+  }
+}
+
+TextfileOut::TextfileOut(std::string strFilename, bool bAsync) :
   m_strFilename(strFilename)
 {
+  if(bAsync) {
+    m_pAsync.reset(new AsyncWriter(this, m_strFilename));
+  }
   this->Message(_func_, "Starting up");
 }
 
 TextfileOut::~TextfileOut() {
   this->Message(_func_, "Shutting down\n");
+  // Writes everything still queued.
+  m_pAsync.reset();
+}
+
+void TextfileOut::Flush() {
+  if(m_pAsync) {
+    m_pAsync->Flush();
+  }
+}
+
+void TextfileOut::SetFlushInterval(unsigned int iMilliseconds) {
+  if(m_pAsync) {
+    m_pAsync->SetFlushInterval(iMilliseconds);
+  }
 }
 
 void TextfileOut::printf(enum DebugChannel channel, const char* source,
                          const char* buff)
 {
+  if(m_pAsync) {
+    m_pAsync->Push(channel, source, buff);
+    // Make sure errors hit the disk, in case we are about to go down.
+    if(channel == CHANNEL_ERROR) {
+      m_pAsync->Flush();
+    }
+    return;
+  }
+
   time_t epoch_time;
   time(&epoch_time);
 
@@ -66,9 +316,9 @@ void TextfileOut::printf(enum DebugChannel channel, const char* source,
   localtime_s(&now, &epoch_time);
 #define ADDR_NOW (&now)
 #else
-  struct tm* now;
-  now = localtime(&epoch_time);
-#define ADDR_NOW (now)
+  struct tm now;
+  localtime_r(&epoch_time, &now);
+#define ADDR_NOW (&now)
 #endif
   char datetime[64];
 
@@ -87,6 +337,11 @@ void TextfileOut::printf(enum DebugChannel channel, const char* source,
 
 void TextfileOut::printf(const char *s) const
 {
+  if(m_pAsync) {
+    m_pAsync->Push(CHANNEL_NONE, "", s);
+    return;
+  }
+
   time_t epoch_time;
   time(&epoch_time);
 
@@ -96,9 +351,9 @@ void TextfileOut::printf(const char *s) const
   localtime_s(&now, &epoch_time);
 #define ADDR_NOW (&now)
 #else
-  struct tm* now;
-  now = localtime(&epoch_time);
-#define ADDR_NOW (now)
+  struct tm now;
+  localtime_r(&epoch_time, &now);
+#define ADDR_NOW (&now)
 #endif
   char datetime[64];
 
@@ -41,24 +41,41 @@
 #ifndef TUVOK_TEXTFILEOUT_H
 #define TUVOK_TEXTFILEOUT_H
 
+#include <memory>
 #include <string>
 #include "AbstrDebugOut.h"
 
 class TextfileOut : public AbstrDebugOut {
   public:
-    TextfileOut(std::string strFilename="logfile.txt");
+    /// In asynchronous mode the file is kept open and messages are queued
+    /// into a lock-free ring, which a background thread drains in batches.
+    /// Errors and destruction flush the queue. In synchronous mode (the
+    /// default) the file is opened, written and closed for every message.
+    TextfileOut(std::string strFilename="logfile.txt", bool bAsync=false);
     ~TextfileOut();
     virtual void printf(enum DebugChannel, const char* source,
                         const char* msg);
     virtual void printf(const char *s) const;
 
     const std::string& GetFileName() const {return m_strFilename;}
+    bool IsAsync() const {return m_pAsync.get() != NULL;}
+
+    /// Blocks until all queued messages have been written to the file.
+    /// Does nothing in synchronous mode.
+    void Flush();
+
+    /// Sets the interval at which the background thread writes queued
+    /// messages (default 100ms). Does nothing in synchronous mode.
+    void SetFlushInterval(unsigned int iMilliseconds);
 
   private:
     TextfileOut(const TextfileOut &); ///< unimplemented.
 
   private:
+    class AsyncWriter;
+
     std::string m_strFilename;
+    std::unique_ptr<AsyncWriter> m_pAsync;
 
     /// same as printf above but does regard m_bShowOther
     void _printf(const char* format, ...) const;
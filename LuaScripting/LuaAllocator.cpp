@@ -0,0 +1,238 @@
+/*
+   For more information, please see: http://software.sci.utah.edu
+
+   The MIT License
+
+   Copyright (c) 2012 Scientific Computing and Imaging Institute,
+   University of Utah.
+
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  \brief  Size-class pool allocator for the embedded Lua state.
+*/
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "LuaAllocator.h"
+
+using namespace std;
+
+namespace tuvok
+{
+
+// Lua mostly allocates strings, tables (56 bytes on 64 bit), hash nodes and
+// closures; small classes are spaced closely to keep the waste down.
+static const size_t sClassSizes[LuaAllocator::NUM_SIZE_CLASSES] =
+  {16, 32, 48, 64, 80, 96, 112, 128, 192, 256, 384, 512};
+
+//-----------------------------------------------------------------------------
+LuaAllocator::LuaAllocator()
+: mLiveBytes(0)
+, mPeakBytes(0)
+, mFreedBytes(0)
+, mLimit(0)
+, mFailed(0)
+, mLargeBlocks(0)
+, mLargeAllocations(0)
+, mLargeBytes(0)
+{
+  for (size_t i = 0; i < NUM_SIZE_CLASSES; ++i)
+  {
+    mClasses[i].blockSize     = sClassSizes[i];
+    mClasses[i].freeList      = NULL;
+    mClasses[i].liveBlocks    = 0;
+    mClasses[i].allocations   = 0;
+    mClasses[i].reservedBytes = 0;
+  }
+
+  size_t c = 0;
+  for (size_t i = 0; i < mClassOf.size(); ++i)
+  {
+    while (sClassSizes[c] < i * 16)
+      ++c;
+    mClassOf[i] = static_cast<unsigned char>(c);
+  }
+}
+
+//-----------------------------------------------------------------------------
+LuaAllocator::~LuaAllocator()
+{
+  for (vector<void*>::iterator it = mChunks.begin(); it != mChunks.end(); ++it)
+    free(*it);
+}
+
+//-----------------------------------------------------------------------------
+void* LuaAllocator::luaAlloc(void* ud, void* ptr, size_t osize, size_t nsize)
+{
+  // When ptr is NULL, osize encodes the type of the object being allocated.
+  return static_cast<LuaAllocator*>(ud)->reallocate(ptr, ptr ? osize : 0,
+                                                     nsize);
+}
+
+//-----------------------------------------------------------------------------
+void* LuaAllocator::reallocate(void* ptr, size_t osize, size_t nsize)
+{
+  if (nsize == 0)
+  {
+    if (ptr != NULL)
+    {
+      release(ptr, osize);
+      mFreedBytes += osize;
+    }
+    return NULL;
+  }
+
+  // Lua requires that shrinking never fails, so only growth is limited.
+  if (mLimit != 0 && nsize > osize && mLiveBytes + (nsize - osize) > mLimit)
+  {
+    ++mFailed;
+    return NULL;
+  }
+
+  if (ptr == NULL)
+    return allocate(nsize);
+
+  size_t oldClass = classOf(osize);
+  size_t newClass = classOf(nsize);
+  if (oldClass == newClass)
+  {
+    if (oldClass == NUM_SIZE_CLASSES)
+    {
+      void* p = ::realloc(ptr, nsize);
+      if (p == NULL)
+        return NULL;
+      mLargeBytes = mLargeBytes - osize + nsize;
+      ptr = p;
+    }
+    mLiveBytes = mLiveBytes - osize + nsize;
+    mPeakBytes = max(mPeakBytes, mLiveBytes);
+    return ptr;
+  }
+
+  void* p = allocate(nsize);
+  if (p == NULL)
+    return NULL;
+  memcpy(p, ptr, min(osize, nsize));
+  release(ptr, osize);
+  return p;
+}
+
+//-----------------------------------------------------------------------------
+void* LuaAllocator::allocate(size_t size)
+{
+  void* p;
+  size_t c = classOf(size);
+  if (c == NUM_SIZE_CLASSES)
+  {
+    p = malloc(size);
+    if (p == NULL)
+      return NULL;
+    ++mLargeBlocks;
+    ++mLargeAllocations;
+    mLargeBytes += size;
+  }
+  else
+  {
+    SizeClass& sc = mClasses[c];
+    if (sc.freeList == NULL && refill(sc) == false)
+      return NULL;
+    FreeBlock* b = sc.freeList;
+    sc.freeList = b->next;
+    ++sc.liveBlocks;
+    ++sc.allocations;
+    p = b;
+  }
+
+  mLiveBytes += size;
+  mPeakBytes = max(mPeakBytes, mLiveBytes);
+  return p;
+}
+
+//-----------------------------------------------------------------------------
+void LuaAllocator::release(void* ptr, size_t size)
+{
+  size_t c = classOf(size);
+  if (c == NUM_SIZE_CLASSES)
+  {
+    free(ptr);
+    --mLargeBlocks;
+    mLargeBytes -= size;
+  }
+  else
+  {
+    SizeClass& sc = mClasses[c];
+    FreeBlock* b = static_cast<FreeBlock*>(ptr);
+    b->next = sc.freeList;
+    sc.freeList = b;
+    --sc.liveBlocks;
+  }
+  mLiveBytes -= size;
+}
+
+//-----------------------------------------------------------------------------
+bool LuaAllocator::refill(SizeClass& sc)
+{
+  char* chunk = static_cast<char*>(malloc(CHUNK_SIZE));
+  if (chunk == NULL)
+    return false;
+  mChunks.push_back(chunk);
+  sc.reservedBytes += CHUNK_SIZE;
+
+  // Link the blocks in address order.
+  size_t numBlocks = CHUNK_SIZE / sc.blockSize;
+  for (size_t i = numBlocks; i > 0; --i)
+  {
+    FreeBlock* b = reinterpret_cast<FreeBlock*>(chunk + (i-1)*sc.blockSize);
+    b->next = sc.freeList;
+    sc.freeList = b;
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+size_t LuaAllocator::getReservedBytes() const
+{
+  size_t reserved = mLargeBytes;
+  for (size_t i = 0; i < NUM_SIZE_CLASSES; ++i)
+    reserved += mClasses[i].reservedBytes;
+  return reserved;
+}
+
+//-----------------------------------------------------------------------------
+vector<tuple<size_t, size_t, size_t, size_t> >
+LuaAllocator::getSizeClassStats() const
+{
+  vector<tuple<size_t, size_t, size_t, size_t> > stats;
+  for (size_t i = 0; i < NUM_SIZE_CLASSES; ++i)
+  {
+    const SizeClass& sc = mClasses[i];
+    stats.push_back(make_tuple(sc.blockSize, sc.liveBlocks, sc.allocations,
+                               sc.reservedBytes));
+  }
+  stats.push_back(make_tuple(size_t(0), mLargeBlocks, mLargeAllocations,
+                             mLargeBytes));
+  return stats;
+}
+
+} /* namespace tuvok */
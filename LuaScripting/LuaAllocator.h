@@ -0,0 +1,142 @@
+/*
+   For more information, please see: http://software.sci.utah.edu
+
+   The MIT License
+
+   Copyright (c) 2012 Scientific Computing and Imaging Institute,
+   University of Utah.
+
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  \brief  Size-class pool allocator for the embedded Lua state.
+*/
+
+#ifndef TUVOK_LUAALLOCATOR_H_
+#define TUVOK_LUAALLOCATOR_H_
+
+#include <array>
+#include <cstddef>
+#include <tuple>
+#include <vector>
+
+namespace tuvok
+{
+
+/// lua_Alloc implementation used by LuaScripting.
+///
+/// Blocks of up to MAX_POOLED_SIZE bytes are carved out of CHUNK_SIZE
+/// chunks and recycled through one free list per size class; Lua passes
+/// the size of every block it frees, so blocks carry no header. Larger
+/// blocks go to malloc. Chunks are only returned to the system when the
+/// allocator is destroyed.
+///
+/// The allocator is confined to its lua_State and, like the state, must not
+/// be used from more than one thread at a time. It takes no locks.
+class LuaAllocator
+{
+public:
+
+  /// Blocks larger than this are allocated with malloc.
+  static const size_t MAX_POOLED_SIZE = 512;
+  static const size_t NUM_SIZE_CLASSES = 12;
+  static const size_t CHUNK_SIZE = 64 * 1024;
+
+  LuaAllocator();
+  ~LuaAllocator();
+
+  /// lua_Alloc entry point. 'ud' is the LuaAllocator.
+  static void* luaAlloc(void* ud, void* ptr, size_t osize, size_t nsize);
+
+  /// Bytes currently requested by Lua.
+  size_t getLiveBytes() const         {return mLiveBytes;}
+  /// Highest value getLiveBytes has had.
+  size_t getPeakBytes() const         {return mPeakBytes;}
+  /// Bytes obtained from the system (pool chunks and large blocks).
+  size_t getReservedBytes() const;
+  /// Total bytes Lua has freed, most of them by the garbage collector.
+  size_t getFreedBytes() const        {return mFreedBytes;}
+
+  /// Allocations that would take the live bytes above the limit fail, which
+  /// makes Lua raise a 'not enough memory' error (after an emergency garbage
+  /// collection). 0 disables the limit.
+  void   setLimit(size_t bytes)       {mLimit = bytes;}
+  size_t getLimit() const             {return mLimit;}
+  /// Number of allocations refused because of the limit.
+  size_t getFailedAllocations() const {return mFailed;}
+
+  /// Per size class: block size, live blocks, total allocations, and bytes
+  /// reserved for the class. Blocks handled by malloc are reported with a
+  /// block size of 0.
+  std::vector<std::tuple<size_t, size_t, size_t, size_t> >
+  getSizeClassStats() const;
+
+private:
+
+  LuaAllocator(const LuaAllocator&);
+  LuaAllocator& operator=(const LuaAllocator&);
+
+  struct FreeBlock
+  {
+    FreeBlock* next;
+  };
+
+  struct SizeClass
+  {
+    size_t      blockSize;
+    FreeBlock*  freeList;
+    size_t      liveBlocks;
+    size_t      allocations;
+    size_t      reservedBytes;
+  };
+
+  void* reallocate(void* ptr, size_t osize, size_t nsize);
+  void* allocate(size_t size);
+  void  release(void* ptr, size_t size);
+
+  /// Size class for a block of 'size' bytes, or NUM_SIZE_CLASSES if the
+  /// block is not pooled.
+  size_t classOf(size_t size) const
+  {
+    return size <= MAX_POOLED_SIZE ? mClassOf[(size + 15) / 16]
+                                   : NUM_SIZE_CLASSES;
+  }
+
+  /// Carves a new chunk into blocks of the given class.
+  bool refill(SizeClass& sc);
+
+  std::array<SizeClass, NUM_SIZE_CLASSES>           mClasses;
+  std::array<unsigned char, MAX_POOLED_SIZE/16 + 1> mClassOf;
+  std::vector<void*>  mChunks;
+
+  size_t              mLiveBytes;
+  size_t              mPeakBytes;
+  size_t              mFreedBytes;
+  size_t              mLimit;
+  size_t              mFailed;
+  size_t              mLargeBlocks;
+  size_t              mLargeAllocations;
+  size_t              mLargeBytes;
+};
+
+} /* namespace tuvok */
+
+#endif
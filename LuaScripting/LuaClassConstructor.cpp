@@ -41,6 +41,7 @@ namespace tuvok
 
 const char* LuaClassConstructor::CONS_MD_FACTORY_NAME           = "factoryName";
 const char* LuaClassConstructor::CONS_MD_FUNC_REGISTRATION_FPTR = "consFptr";
+const char* LuaClassConstructor::CONS_MD_METHOD_PROTOS          = "methodProtos";
 
 LuaClassConstructor::LuaClassConstructor(LuaScripting* ss)
 : mSS(ss)
@@ -88,6 +89,18 @@ int LuaClassConstructor::createCoreMetatable(lua_State* L, int instID,
   lua_pushboolean(L, 0);
   lua_setfield(L, mt, LuaClassInstance::MD_NO_DELETE_HINT);
 
+  // All instances of the class share its method prototypes (see
+  // LuaMemberRegUnsafe::registerClassMethod).
+  lua_getfield(L, consTable, CONS_MD_METHOD_PROTOS);
+  if (lua_isnil(L, -1))
+  {
+    lua_pop(L, 1);
+    lua_newtable(L);
+    lua_pushvalue(L, -1);
+    lua_setfield(L, consTable, CONS_MD_METHOD_PROTOS);
+  }
+  lua_setfield(L, mt, LuaClassInstance::MD_METHOD_PROTOS);
+
   return mt;
 }
 
@@ -110,6 +123,7 @@ LuaClassInstance LuaClassConstructor::finalizeInstanceTable(LuaScripting* ss,
   LuaClassInstance instance(instID);
 
   ss->bindClosureTableWithFQName(instance.fqName(), instTable);
+  ss->bindInstanceSlot(instID, instTable);
 
   return instance;
 }
@@ -121,6 +135,7 @@ void LuaClassConstructor::postExecFailure(LuaScripting* ss,
   removeClass += " = nil";
 
   luaL_dostring(ss->getLuaState(), removeClass.c_str());
+  ss->releaseInstanceSlot(inst.getGlobalInstID());
 }
 
 void LuaClassConstructor::postExecSuccess(LuaScripting* ss,
@@ -157,6 +172,7 @@ void LuaClassConstructor::finalize(lua_State* L, LuaScripting* ss, void* r,
   addToLookupTable(ss, L, r, inst.getGlobalInstID());
 
   finalizeMetatable(L, mt, r, delFun);
+  ss->setInstanceSlotPointer(inst.getGlobalInstID(), r);
 
   // Remove the metatable first, then the instance table (otherwise,
   // metatable's index would be one lower than what we recorded).
@@ -165,7 +181,7 @@ void LuaClassConstructor::finalize(lua_State* L, LuaScripting* ss, void* r,
 
   // Place function table on the top of the stack (could just leave instTable
   // on the top of the stack).
-  if (ss->getFunctionTable(inst.fqName()) == false)
+  if (ss->getClassTable(inst) == false)
     throw LuaFunBindError("Unable to find table after it was created!");
 }
 
@@ -49,6 +49,7 @@ public:
   ///@{
   static const char*    CONS_MD_FACTORY_NAME;
   static const char*    CONS_MD_FUNC_REGISTRATION_FPTR;
+  static const char*    CONS_MD_METHOD_PROTOS;
   ///@}
 
   template <typename CLS, typename FunPtr>
@@ -240,6 +241,7 @@ private:
           lua_touserdata(L, lua_upvalueindex(1)));                            //
       LuaScripting* ss = static_cast<LuaScripting*>(                          //
                   lua_touserdata(L, lua_upvalueindex(3)));                    //
+      LuaScripting::ProfileScope _p(ss, L, consTable);
 
       std::shared_ptr<LuaCFunAbstract> execParams(
           new LuaCFunExec<FunPtr>());
@@ -357,6 +359,7 @@ private:
                       lua_touserdata(L, lua_upvalueindex(2)));                //
       LuaScripting* ss = static_cast<LuaScripting*>(                          //
                   lua_touserdata(L, lua_upvalueindex(4)));                    //
+      LuaScripting::ProfileScope _p(ss, L, consTable);
 
       std::shared_ptr<LuaCFunAbstract> execParams(
           new LuaCFunExec<FunPtr>());
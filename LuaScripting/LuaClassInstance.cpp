@@ -46,6 +46,8 @@ const char* LuaClassInstance::MD_INSTANCE           = "instance";
 const char* LuaClassInstance::MD_DEL_FUN            = "delFun";
 const char* LuaClassInstance::MD_DEL_CALLBACK_PTR   = "delCallbackPtr";
 const char* LuaClassInstance::MD_NO_DELETE_HINT     = "deleteHint";
+const char* LuaClassInstance::MD_METHOD_PROTOS      = "methodProtos";
+const char* LuaClassInstance::MD_LAZY_METHODS       = "lazyMethods";
 
 // NOTE: Only keys that begin with an underscore and are followed by upper
 // case letters are reserved by Lua. See:
@@ -55,6 +57,7 @@ const char* LuaClassInstance::SYSTEM_TABLE          = "_sys_";
 const char* LuaClassInstance::CLASS_INSTANCE_TABLE  = "_sys_.inst";
 const char* LuaClassInstance::CLASS_INSTANCE_PREFIX = "m";
 const char* LuaClassInstance::CLASS_LOOKUP_TABLE    = "_sys_.lookup";
+const char* LuaClassInstance::INSTANCE_SLOT_TABLE   = "tuvok_instSlots";
 
 LuaClassInstance::LuaClassInstance(int instanceID)
 : mInstanceID(instanceID)
@@ -90,38 +93,18 @@ bool LuaClassInstance::isValid(std::shared_ptr<LuaScripting> ss) const
 
 bool LuaClassInstance::isValid(LuaScripting* ss) const
 {
-  LuaStackRAII _a(ss->getLuaState(), 0, 0);
-
-  if (isDefaultInstance())
-    return false;
-
-  // Check to see whether an instance is present in the instance table.
-  // If it is not, then this is NOT a valid class.
-  if (ss->getFunctionTable(fqName()))
-  {
-    lua_pop(ss->getLuaState(), 1);
-    return true;
-  }
-  else
-  {
+  // An instance is valid as long as its table is bound to its slot.
+  if (mInstanceID < 0
+      || static_cast<size_t>(mInstanceID) >= ss->mInstanceSlots.size())
     return false;
-  }
+  return ss->mInstanceSlots[mInstanceID].live;
 }
 
 void* LuaClassInstance::getVoidPointer(LuaScripting* ss)
 {
-  lua_State* L = ss->getLuaState();
-  LuaStackRAII _a(L, 0, 0);
-
-  if (ss->getFunctionTable(fqName()) == false)
+  if (isValid(ss) == false)
     throw LuaError("Invalid function table.");
-  if (lua_getmetatable(L, -1) == 0)
-    throw LuaError("Unable to obtain function metatable");
-  lua_getfield(L, -1, MD_INSTANCE);
-  void* r = lua_touserdata(L, -1);
-  lua_pop(L, 3);  // Table, metatable, and userdata.
-
-  return r;
+  return ss->mInstanceSlots[mInstanceID].instance;
 }
 
 void LuaClassInstance::invalidate()
@@ -83,6 +83,10 @@ public:
                                                 ///< called on the class.
                                                 ///< Used when the constructor
                                                 ///< notifies us of destruction.
+  static const char*    MD_METHOD_PROTOS;       ///< Method prototypes shared
+                                                ///< by the class' instances.
+  static const char*    MD_LAZY_METHODS;        ///< Names of methods bound on
+                                                ///< first access (__index).
   ///@}
 
   /// SYSTEM_TABLE really should be stored in LuaScripting. But do to its
@@ -92,6 +96,8 @@ public:
   static const char* CLASS_INSTANCE_TABLE;  ///< The global class instance table
   static const char* CLASS_INSTANCE_PREFIX; ///< Prefix for class instances
   static const char* CLASS_LOOKUP_TABLE;    ///< Global class lookup table.
+  static const char* INSTANCE_SLOT_TABLE;   ///< Registry table of instance
+                                            ///< tables keyed by instance ID.
 
   static const int DEFAULT_INSTANCE_ID = -1;
 
@@ -50,6 +50,7 @@ namespace tuvok
 #ifdef LUASCRIPTING_UNIT_TESTS
 #include "utestCommon.h"
 #include "LuaClassRegistration.h"
+#include "LuaFunctionHandle.h"
 #include "LuaProvenance.h"
 
 using namespace tuvok;
@@ -1429,6 +1430,49 @@ SUITE(LuaTestClassRegistration)
     delete y;
   }
 
+  TEST(SharedMethodPrototypes)
+  {
+    TEST_HEADER;
+
+    shared_ptr<LuaScripting> sc(new LuaScripting());
+
+    Y* y = new Y(sc);
+    sc->registerClass<X>(y, &Y::constructX, "factory.x", "",
+                         LuaClassRegCallback<X>::Type(&X::registerFunctions));
+
+    LuaClassInstance x1 = sc->cexecRet<LuaClassInstance>("factory.x.new");
+    LuaClassInstance x2 = sc->cexecRet<LuaClassInstance>("factory.x.new");
+    std::string x1Inst = x1.fqName();
+    std::string x2Inst = x2.fqName();
+
+    // Both instances reference the same method prototype, but call into
+    // their own object.
+    CHECK_EQUAL(true, sc->execRet<bool>(
+        "getmetatable(" + x1Inst + ".set_i1) == "
+        "getmetatable(" + x2Inst + ".set_i1)"));
+    CHECK_EQUAL(x2Inst + ".set_i1", sc->execRet<std::string>(
+        x2Inst + ".set_i1." + LuaScripting::TBL_MD_QNAME));
+
+    sc->exec(x1Inst + ".set_i1(1)");
+    sc->exec(x2Inst + ".set_i1(2)");
+    sc->setDefaults(x2Inst + ".set_f1", 4.5f, true);
+    CHECK_EQUAL(1, sc->execRet<int>(x1Inst + ".get_i1()"));
+    CHECK_EQUAL(2, sc->execRet<int>(x2Inst + ".get_i1()"));
+
+    // Last exec and defaults tables are per instance.
+    sc->exec("provenance.undo()");
+    CHECK_EQUAL(1, x1.getRawPointer<X>(sc)->i1);
+    CHECK_EQUAL(0, x2.getRawPointer<X>(sc)->i1);
+    sc->exec(x1Inst + ".set_f1(1.5)");
+    sc->exec("provenance.undo()");
+    CHECK_CLOSE(0.0f, x1.getRawPointer<X>(sc)->f1, 0.001f);
+    CHECK_CLOSE(4.5f, x2.getRawPointer<X>(sc)->f1, 0.001f);
+
+    sc->clean();
+
+    delete y;
+  }
+
   TEST(PointerRetrievalOfClasses)
   {
     TEST_HEADER;
@@ -1455,6 +1499,86 @@ SUITE(LuaTestClassRegistration)
     sc->clean();
   }
 
+  TEST(InstanceSlots)
+  {
+    TEST_HEADER;
+
+    shared_ptr<LuaScripting> sc(new LuaScripting());
+
+    sc->registerClassStatic<A>(&A::luaConstruct, "factory.a1", "a class",
+                                LuaClassRegCallback<A>::Type(
+                                    &A::registerFunctions));
+
+    LuaClassInstance a_1 = sc->cexecRet<LuaClassInstance>(
+        "factory.a1.new", 2, 2.63, "str", sc);
+    std::string aInst = a_1.fqName();
+
+    CHECK_EQUAL(true, a_1.isValid(sc));
+    unsigned int gen = sc->getClassInstanceGeneration(a_1);
+    A* a = a_1.getRawPointer<A>(sc);
+    CHECK_EQUAL(a_1.getGlobalInstID(),
+                sc->getLuaClassInstance(a).getGlobalInstID());
+
+    LuaClassInstance a_2 = sc->cexecRet<LuaClassInstance>(
+        "factory.a1.new", 3, 1.5, "str", sc);
+    LuaFunctionHandle get1 = sc->resolve(aInst + ".get_i1");
+    LuaFunctionHandle get2 = sc->resolve(a_2.fqName() + ".get_i1");
+
+    sc->exec("deleteClass(" + aInst + ")");
+    CHECK_EQUAL(false, a_1.isValid(sc));
+    // Only handles to the deleted instance are invalidated.
+    CHECK_EQUAL(false, get1.isValid());
+    CHECK_EQUAL(3, get2.call<int>());
+    CHECK(gen != sc->getClassInstanceGeneration(a_1));
+    CHECK_THROW(a_1.getRawPointer<A>(sc), LuaError);
+
+    // Undo recreates the instance under the same ID, in a new generation.
+    sc->exec("provenance.undo()");
+    CHECK_EQUAL(true, a_1.isValid(sc));
+    CHECK(gen != sc->getClassInstanceGeneration(a_1));
+    a = a_1.getRawPointer<A>(sc);
+    CHECK_EQUAL(a_1.getGlobalInstID(),
+                sc->getLuaClassInstance(a).getGlobalInstID());
+
+    sc->exec("provenance.redo()");
+    CHECK_EQUAL(false, a_1.isValid(sc));
+
+    LuaClassInstance unknown(1000);
+    CHECK_EQUAL(false, unknown.isValid(sc));
+    CHECK_EQUAL(0u, sc->getClassInstanceGeneration(unknown));
+
+    sc->clean();
+  }
+
+  TEST(LazyMethodHelp)
+  {
+    TEST_HEADER;
+
+    shared_ptr<LuaScripting> sc(new LuaScripting());
+
+    sc->registerClassStatic<A>(&A::luaConstruct, "factory.a1", "a class",
+                                LuaClassRegCallback<A>::Type(
+                                    &A::registerFunctions));
+
+    LuaClassInstance a_1 = sc->cexecRet<LuaClassInstance>(
+        "factory.a1.new", 2, 2.63, "str", sc);
+    std::string aInst = a_1.fqName();
+
+    // A function __index that binds methods on first access. Help has to
+    // look up the listed lazy methods and must not descend into __index.
+    sc->exec("seen = {}");
+    sc->exec("getmetatable(" + aInst + ").__index = "
+             "function(t, k) seen[k] = true end");
+    sc->exec("getmetatable(" + aInst + ").lazyMethods = {lazy_fn = true}");
+
+    std::string help = sc->execRet<std::string>("helpStr(" + aInst + ")");
+    CHECK(help.find("get_i1") != std::string::npos);
+    CHECK_EQUAL(true, sc->execRet<bool>("seen.lazy_fn == true"));
+    CHECK_EQUAL(2, sc->execRet<int>(aInst + ".get_i1()"));
+
+    sc->clean();
+  }
+
   TEST(ClassHelpAndLog)
   {
     // Help should be given for classes, but not for any of their instances
@@ -125,16 +125,10 @@ std::string LuaClassRegistration<T>::function(FunPtr f,
         "error indicates that you have a Lua class that was not created using "
         "the scripting system.");
 
-  LuaClassInstance inst(mGlobalID);
-
-  std::ostringstream qualifiedName;
-  qualifiedName << inst.fqName() << "." << unqualifiedName;
-
   // Function pointer f is guaranteed to be a member function pointer.
-  mRegistration.registerFunction(mPtr, f, qualifiedName.str(), desc,
-                                 undoRedo);
-
-  return qualifiedName.str();
+  return mRegistration.registerClassMethod(mPtr, f,
+                                           LuaClassInstance(mGlobalID),
+                                           unqualifiedName, desc, undoRedo);
 }
 
 template <typename T>
@@ -150,20 +144,16 @@ std::string LuaClassRegistration<T>::functionProxy(
         "error indicates that you have a Lua class that was not created using "
         "the scripting system.");
 
-  LuaClassInstance inst(mGlobalID);
-
-  std::ostringstream qualifiedName;
-  qualifiedName << inst.fqName() << "." << unqualifiedName;
-
   // Function pointer f is guaranteed to be a member function pointer.
-  mRegistration.registerFunction(otherClass, f, qualifiedName.str(), desc,
-                                 undoRedo);
+  std::string qualifiedName = mRegistration.registerClassMethod(
+      otherClass, f, LuaClassInstance(mGlobalID), unqualifiedName, desc,
+      undoRedo);
 
   // Add this function to the proxy function list. This list can be used to
   // wipe out existing proxy functions.
   mProxyFunctions.push_back(unqualifiedName);
 
-  return qualifiedName.str();
+  return qualifiedName;
 }
 
 template <typename T>
@@ -33,17 +33,30 @@
  \brief   
  */
 
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
 #include <string>
 #include <vector>
 
+#include "LuaScripting.h"
 #include "LuaDebug.h"
 
+using namespace std;
+
 namespace tuvok
 {
 
+/// Registry key under which the sampling LuaDebug instance is stored.
+static const char sProfilerKey = 0;
+
 //-----------------------------------------------------------------------------
 LuaDebug::LuaDebug(LuaScripting* scripting)
-: mMemberReg(scripting)
+: mScripting(scripting)
+, mMemberReg(scripting)
+, mSamplesUsed(0)
+, mSamplesDropped(0)
 {
 
 }
@@ -72,12 +85,165 @@ void LuaDebug::registerLuaDebugFunctions()
 //                              "function is executed, a notification is "
 //                              "printed to the console.",
 //                              false);
+  mMemberReg.registerFunction(this, &LuaDebug::profileStart,
+                              "debug.profileStart",
+                              "Starts sampling the Lua call stack every N VM "
+                              "instructions (e.g. 1000).",
+                              false);
+  mMemberReg.registerFunction(this, &LuaDebug::profileStop,
+                              "debug.profileStop",
+                              "Stops sampling and writes the samples to the "
+                              "given file as folded stacks, for use with "
+                              "flamegraph.pl.",
+                              false);
+  mMemberReg.registerFunction(this, &LuaDebug::getProfileDropped,
+                              "debug.profileDropped",
+                              "Number of samples dropped by the last "
+                              "sampling run because its buffer was full.",
+                              false);
+}
+
+//-----------------------------------------------------------------------------
+void LuaDebug::watchFunction(const std::string& /*function*/)
+{
+
+}
+
+//-----------------------------------------------------------------------------
+void LuaDebug::profileStart(int sampleEvery)
+{
+  if (sampleEvery <= 0)
+    throw LuaError("debug.profileStart: the sampling interval must be "
+                   "positive.");
+
+  mSamples.assign(SAMPLE_BUFFER_ENTRIES, 0);
+  mSamplesUsed    = 0;
+  mSamplesDropped = 0;
+  mFrameNames.clear();
+  mFrameIDs.clear();
+
+  lua_State* L = mScripting->getLuaState();
+  lua_pushlightuserdata(L, this);
+  lua_rawsetp(L, LUA_REGISTRYINDEX, &sProfilerKey);
+  lua_sethook(L, &LuaDebug::profileHook, LUA_MASKCOUNT, sampleEvery);
 }
 
 //-----------------------------------------------------------------------------
-void LuaDebug::watchFunction(const std::string& function)
+void LuaDebug::profileStop(const std::string& file)
 {
+  lua_State* L = mScripting->getLuaState();
+  lua_sethook(L, NULL, 0, 0);
+  lua_pushnil(L);
+  lua_rawsetp(L, LUA_REGISTRYINDEX, &sProfilerKey);
+
+  // Fold identical stacks.
+  map<string, uint64_t> folded;
+  for (size_t i = 0; i < mSamplesUsed; )
+  {
+    uint32_t depth = mSamples[i];
+    string stack;
+    for (uint32_t f = depth; f > 0; --f)
+    {
+      if (!stack.empty())
+        stack += ';';
+      stack += mFrameNames[mSamples[i + f]];
+    }
+    ++folded[stack];
+    i += depth + 1;
+  }
+
+  // Release the sample buffer.
+  vector<uint32_t>().swap(mSamples);
+  mSamplesUsed = 0;
+
+  ofstream os(file.c_str());
+  if (!os)
+  {
+    ostringstream err;
+    err << "debug.profileStop: unable to open '" << file << "'.";
+    throw LuaError(err.str());
+  }
+  for (map<string, uint64_t>::const_iterator it = folded.begin();
+       it != folded.end(); ++it)
+  {
+    os << it->first << " " << it->second << "\n";
+  }
+}
 
+//-----------------------------------------------------------------------------
+void LuaDebug::profileHook(lua_State* L, lua_Debug*)
+{
+  lua_rawgetp(L, LUA_REGISTRYINDEX, &sProfilerKey);
+  LuaDebug* self = static_cast<LuaDebug*>(lua_touserdata(L, -1));
+  lua_pop(L, 1);
+
+  if (self != NULL)
+    self->takeSample(L);
+}
+
+//-----------------------------------------------------------------------------
+void LuaDebug::takeSample(lua_State* L)
+{
+  uint32_t frames[MAX_SAMPLE_DEPTH];
+  uint32_t depth = 0;
+
+  lua_Debug ar;
+  for (int level = 0; depth < MAX_SAMPLE_DEPTH && lua_getstack(L, level, &ar);
+       ++level)
+  {
+    frames[depth++] = frameID(L, &ar);
+  }
+
+  if (depth == 0)
+    return;
+
+  if (mSamplesUsed + depth + 1 > mSamples.size())
+  {
+    ++mSamplesDropped;
+    return;
+  }
+
+  mSamples[mSamplesUsed++] = depth;
+  for (uint32_t f = 0; f < depth; ++f)
+    mSamples[mSamplesUsed++] = frames[f];
+}
+
+//-----------------------------------------------------------------------------
+uint32_t LuaDebug::frameID(lua_State* L, lua_Debug* ar)
+{
+  lua_getinfo(L, "f", ar);
+  const void* fun = lua_topointer(L, -1);
+  lua_pop(L, 1);
+
+  unordered_map<const void*, uint32_t>::const_iterator it =
+      mFrameIDs.find(fun);
+  if (it != mFrameIDs.end())
+    return it->second;
+
+  // First time we see this function: name it after its call site and
+  // definition.
+  lua_getinfo(L, "Sn", ar);
+  ostringstream os;
+  if (strcmp(ar->what, "main") == 0)
+    os << "[main] " << ar->short_src;
+  else if (strcmp(ar->what, "C") == 0)
+    os << (ar->name ? ar->name : "?") << " [C]";
+  else
+    os << (ar->name ? ar->name : "?") << " " << ar->short_src << ":"
+       << ar->linedefined;
+
+  // ';' separates frames in the folded format.
+  string name = os.str();
+  for (string::iterator c = name.begin(); c != name.end(); ++c)
+  {
+    if (*c == ';' || *c == '\n')
+      *c = ' ';
+  }
+
+  uint32_t id = static_cast<uint32_t>(mFrameNames.size());
+  mFrameNames.push_back(name);
+  mFrameIDs[fun] = id;
+  return id;
 }
 
 } /* namespace tuvok */
@@ -36,6 +36,10 @@
 #ifndef LUADEBUG_H_
 #define LUADEBUG_H_
 
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #include "LuaMemberRegUnsafe.h"
 
 namespace tuvok
@@ -51,13 +55,51 @@ public:
   /// Registers debugging functions in Lua.
   void registerLuaDebugFunctions();
 
+  /// Starts sampling the Lua call stack every 'sampleEvery' VM instructions.
+  /// Unlike the call profiler (profile.*), this sees time spent in pure Lua.
+  /// Only the main Lua thread is sampled, not coroutines.
+  void profileStart(int sampleEvery);
+
+  /// Stops sampling and writes the samples to 'file' in the folded stack
+  /// format ("outer;inner;leaf count" per line), as consumed by
+  /// flamegraph.pl and speedscope.
+  void profileStop(const std::string& file);
+
+  /// Number of samples dropped because the sample buffer was full.
+  int getProfileDropped() const   {return mSamplesDropped;}
+
 private:
 
   /// Watches the given function for changes.
   void watchFunction(const std::string& function);
 
+  /// lua_Hook installed by profileStart.
+  static void profileHook(lua_State* L, lua_Debug* ar);
+
+  /// Records the current call stack of L into mSamples.
+  void takeSample(lua_State* L);
 
+  /// Index into mFrameNames of the function active at the given level.
+  uint32_t frameID(lua_State* L, lua_Debug* ar);
+
+  /// Number of uint32_t entries in the sample buffer. Each sample takes its
+  /// depth plus one entry per frame.
+  static const size_t SAMPLE_BUFFER_ENTRIES = 1 << 20;
+  /// Frames deeper than this are not recorded.
+  static const int    MAX_SAMPLE_DEPTH      = 64;
+
+  LuaScripting*             mScripting;
   LuaMemberRegUnsafe        mMemberReg;     ///< Used for member registration.
+
+  /// Samples as [depth, frame_leaf, ..., frame_root] records. Allocated by
+  /// profileStart so that sampling itself does not allocate.
+  std::vector<uint32_t>     mSamples;
+  size_t                    mSamplesUsed;
+  int                       mSamplesDropped;
+
+  /// Frame names, and the functions they were resolved from.
+  std::vector<std::string>  mFrameNames;
+  std::unordered_map<const void*, uint32_t> mFrameIDs;
 };
 
 } /* namespace tuvok */
@@ -570,19 +570,16 @@ public:
   {
     LuaStackRAII _a(L, 0, 1);
 
-    // Lookup the instance table in the global instance table based on the
+    // Lookup the instance table in the instance slot table based on the
     // instance ID.
-    // TODO: This can be done more efficiently by parsing and walking the
-    // tables ourselves (LuaScripting::getFunctionTable)
     if (in.getGlobalInstID() != LuaClassInstance::DEFAULT_INSTANCE_ID)
     {
-      std::ostringstream os;
-      os << "return " << LuaClassInstance::CLASS_INSTANCE_TABLE << "."
-         << LuaClassInstance::CLASS_INSTANCE_PREFIX << in.getGlobalInstID();
-      luaL_dostring(L, os.str().c_str()); // Return the class instance.
+      lua_getfield(L, LUA_REGISTRYINDEX, LuaClassInstance::INSTANCE_SLOT_TABLE);
+      lua_rawgeti(L, -1, in.getGlobalInstID()); // Push the class instance.
+      lua_remove(L, -2);
 
       // Interesting corner case: If the class instance has already been
-      // deleted, luaL_dostring will return nil, and result in us deleting
+      // deleted, its slot will be nil, and result in us deleting
       // elements from our last exec table.
       //
       // Since deleteClass has a null undo function, we are safe doing this.
@@ -1404,6 +1401,49 @@ void LSS_pushTypeInfo(lua_State* L)
 
 #endif
 
+//==============================================================
+//
+// PARAMETER SIZES (used to bound the undo/redo stack's memory)
+//
+//==============================================================
+
+/// Approximate number of bytes a captured parameter holds, including the
+/// heap memory it owns. Types that own heap memory and are not covered here
+/// overload luaParamBytes in their own namespace (see LuaTypedArray).
+///@{
+template <typename T>
+size_t luaParamBytes(const T&)
+{ return sizeof(T); }
+
+inline size_t luaParamBytes(const std::string& s)
+{ return sizeof(s) + s.capacity(); }
+
+template <typename T>
+size_t luaParamBytes(const std::vector<T>& v);
+template <typename T>
+size_t luaParamBytes(const std::list<T>& l);
+
+template <typename T>
+size_t luaParamBytes(const std::vector<T>& v)
+{
+  size_t bytes = sizeof(v) + (v.capacity() - v.size()) * sizeof(T);
+  for (typename std::vector<T>::const_iterator it = v.begin(); it != v.end();
+       ++it)
+    bytes += luaParamBytes(*it);
+  return bytes;
+}
+
+template <typename T>
+size_t luaParamBytes(const std::list<T>& l)
+{
+  // Each node also holds two pointers.
+  size_t bytes = sizeof(l);
+  for (typename std::list<T>::const_iterator it = l.begin(); it != l.end();
+       ++it)
+    bytes += 2 * sizeof(void*) + luaParamBytes(*it);
+  return bytes;
+}
+///@}
 
 } /* namespace tuvok */
 
@@ -60,8 +60,13 @@ namespace tuvok
 class LuaCFunAbstract
 {
 public:
+  LuaCFunAbstract() : mParamBytes(0) {}
   virtual ~LuaCFunAbstract() {}
 
+  /// Approximate number of bytes held by this object and the parameters
+  /// pulled into it (see luaParamBytes). 0 until pullParamsFromStack is called.
+  size_t sizeBytes() const                                  {return mParamBytes;}
+
   virtual void pushParamsToStack(lua_State* L) const      = 0;
 
   /// Pulls parameters from the stack, starting at the non-pseudo index si.
@@ -72,6 +77,9 @@ public:
   /// e.g. If there were 3 parameters, a boolean, a string, and an int, then
   /// "true, 'hi', 463" would be a possible result of the function.
   virtual std::string getFormattedParameterValues() const = 0;
+
+protected:
+  size_t mParamBytes;
 };
 
 
@@ -178,6 +186,8 @@ public:
   {
     int pos = si;
     TLUA_M_VNM(P1) = LuaStrictStack<P1>::get(L, pos++);
+    mParamBytes = sizeof(*this)
+        + luaParamBytes(TLUA_M_VNM(P1));
 }
 
   virtual std::string getFormattedParameterValues() const
@@ -243,6 +253,9 @@ public:
     int pos = si;
     TLUA_M_VNM(P1) = LuaStrictStack<P1>::get(L, pos++);
     TLUA_M_VNM(P2) = LuaStrictStack<P2>::get(L, pos++);
+    mParamBytes = sizeof(*this)
+        + luaParamBytes(TLUA_M_VNM(P1))
+        + luaParamBytes(TLUA_M_VNM(P2));
 }
 
   virtual std::string getFormattedParameterValues() const
@@ -319,6 +332,10 @@ public:
     TLUA_M_VNM(P1) = LuaStrictStack<P1>::get(L, pos++);
     TLUA_M_VNM(P2) = LuaStrictStack<P2>::get(L, pos++);
     TLUA_M_VNM(P3) = LuaStrictStack<P3>::get(L, pos++);
+    mParamBytes = sizeof(*this)
+        + luaParamBytes(TLUA_M_VNM(P1))
+        + luaParamBytes(TLUA_M_VNM(P2))
+        + luaParamBytes(TLUA_M_VNM(P3));
 }
 
   virtual std::string getFormattedParameterValues() const
@@ -406,6 +423,11 @@ public:
     TLUA_M_VNM(P2) = LuaStrictStack<P2>::get(L, pos++);
     TLUA_M_VNM(P3) = LuaStrictStack<P3>::get(L, pos++);
     TLUA_M_VNM(P4) = LuaStrictStack<P4>::get(L, pos++);
+    mParamBytes = sizeof(*this)
+        + luaParamBytes(TLUA_M_VNM(P1))
+        + luaParamBytes(TLUA_M_VNM(P2))
+        + luaParamBytes(TLUA_M_VNM(P3))
+        + luaParamBytes(TLUA_M_VNM(P4));
 }
 
   virtual std::string getFormattedParameterValues() const
@@ -504,6 +526,12 @@ public:
     TLUA_M_VNM(P3) = LuaStrictStack<P3>::get(L, pos++);
     TLUA_M_VNM(P4) = LuaStrictStack<P4>::get(L, pos++);
     TLUA_M_VNM(P5) = LuaStrictStack<P5>::get(L, pos++);
+    mParamBytes = sizeof(*this)
+        + luaParamBytes(TLUA_M_VNM(P1))
+        + luaParamBytes(TLUA_M_VNM(P2))
+        + luaParamBytes(TLUA_M_VNM(P3))
+        + luaParamBytes(TLUA_M_VNM(P4))
+        + luaParamBytes(TLUA_M_VNM(P5));
 }
 
   virtual std::string getFormattedParameterValues() const
@@ -613,6 +641,13 @@ public:
     TLUA_M_VNM(P4) = LuaStrictStack<P4>::get(L, pos++);
     TLUA_M_VNM(P5) = LuaStrictStack<P5>::get(L, pos++);
     TLUA_M_VNM(P6) = LuaStrictStack<P6>::get(L, pos++);
+    mParamBytes = sizeof(*this)
+        + luaParamBytes(TLUA_M_VNM(P1))
+        + luaParamBytes(TLUA_M_VNM(P2))
+        + luaParamBytes(TLUA_M_VNM(P3))
+        + luaParamBytes(TLUA_M_VNM(P4))
+        + luaParamBytes(TLUA_M_VNM(P5))
+        + luaParamBytes(TLUA_M_VNM(P6));
 }
 
   virtual std::string getFormattedParameterValues() const
@@ -733,6 +768,14 @@ public:
     TLUA_M_VNM(P5) = LuaStrictStack<P5>::get(L, pos++);
     TLUA_M_VNM(P6) = LuaStrictStack<P6>::get(L, pos++);
     TLUA_M_VNM(P7) = LuaStrictStack<P7>::get(L, pos++);
+    mParamBytes = sizeof(*this)
+        + luaParamBytes(TLUA_M_VNM(P1))
+        + luaParamBytes(TLUA_M_VNM(P2))
+        + luaParamBytes(TLUA_M_VNM(P3))
+        + luaParamBytes(TLUA_M_VNM(P4))
+        + luaParamBytes(TLUA_M_VNM(P5))
+        + luaParamBytes(TLUA_M_VNM(P6))
+        + luaParamBytes(TLUA_M_VNM(P7));
 }
 
   virtual std::string getFormattedParameterValues() const
@@ -864,6 +907,15 @@ public:
     TLUA_M_VNM(P6) = LuaStrictStack<P6>::get(L, pos++);
     TLUA_M_VNM(P7) = LuaStrictStack<P7>::get(L, pos++);
     TLUA_M_VNM(P8) = LuaStrictStack<P8>::get(L, pos++);
+    mParamBytes = sizeof(*this)
+        + luaParamBytes(TLUA_M_VNM(P1))
+        + luaParamBytes(TLUA_M_VNM(P2))
+        + luaParamBytes(TLUA_M_VNM(P3))
+        + luaParamBytes(TLUA_M_VNM(P4))
+        + luaParamBytes(TLUA_M_VNM(P5))
+        + luaParamBytes(TLUA_M_VNM(P6))
+        + luaParamBytes(TLUA_M_VNM(P7))
+        + luaParamBytes(TLUA_M_VNM(P8));
 }
 
   virtual std::string getFormattedParameterValues() const
@@ -1006,6 +1058,16 @@ public:
     TLUA_M_VNM(P7) = LuaStrictStack<P7>::get(L, pos++);
     TLUA_M_VNM(P8) = LuaStrictStack<P8>::get(L, pos++);
     TLUA_M_VNM(P9) = LuaStrictStack<P9>::get(L, pos++);
+    mParamBytes = sizeof(*this)
+        + luaParamBytes(TLUA_M_VNM(P1))
+        + luaParamBytes(TLUA_M_VNM(P2))
+        + luaParamBytes(TLUA_M_VNM(P3))
+        + luaParamBytes(TLUA_M_VNM(P4))
+        + luaParamBytes(TLUA_M_VNM(P5))
+        + luaParamBytes(TLUA_M_VNM(P6))
+        + luaParamBytes(TLUA_M_VNM(P7))
+        + luaParamBytes(TLUA_M_VNM(P8))
+        + luaParamBytes(TLUA_M_VNM(P9));
 }
 
   virtual std::string getFormattedParameterValues() const
@@ -1159,6 +1221,17 @@ public:
     TLUA_M_VNM(P8) = LuaStrictStack<P8>::get(L, pos++);
     TLUA_M_VNM(P9) = LuaStrictStack<P9>::get(L, pos++);
     TLUA_M_VNM(P10) = LuaStrictStack<P10>::get(L, pos++);
+    mParamBytes = sizeof(*this)
+        + luaParamBytes(TLUA_M_VNM(P1))
+        + luaParamBytes(TLUA_M_VNM(P2))
+        + luaParamBytes(TLUA_M_VNM(P3))
+        + luaParamBytes(TLUA_M_VNM(P4))
+        + luaParamBytes(TLUA_M_VNM(P5))
+        + luaParamBytes(TLUA_M_VNM(P6))
+        + luaParamBytes(TLUA_M_VNM(P7))
+        + luaParamBytes(TLUA_M_VNM(P8))
+        + luaParamBytes(TLUA_M_VNM(P9))
+        + luaParamBytes(TLUA_M_VNM(P10));
 }
 
   virtual std::string getFormattedParameterValues() const
@@ -1317,6 +1390,8 @@ public:
   {
     int pos = si;
     TLUA_M_VNM(P1) = LuaStrictStack<P1>::get(L, pos++);
+    mParamBytes = sizeof(*this)
+        + luaParamBytes(TLUA_M_VNM(P1));
 }
 
   virtual std::string getFormattedParameterValues() const
@@ -1381,6 +1456,9 @@ public:
     int pos = si;
     TLUA_M_VNM(P1) = LuaStrictStack<P1>::get(L, pos++);
     TLUA_M_VNM(P2) = LuaStrictStack<P2>::get(L, pos++);
+    mParamBytes = sizeof(*this)
+        + luaParamBytes(TLUA_M_VNM(P1))
+        + luaParamBytes(TLUA_M_VNM(P2));
 }
 
   virtual std::string getFormattedParameterValues() const
@@ -1458,6 +1536,10 @@ public:
     TLUA_M_VNM(P1) = LuaStrictStack<P1>::get(L, pos++);
     TLUA_M_VNM(P2) = LuaStrictStack<P2>::get(L, pos++);
     TLUA_M_VNM(P3) = LuaStrictStack<P3>::get(L, pos++);
+    mParamBytes = sizeof(*this)
+        + luaParamBytes(TLUA_M_VNM(P1))
+        + luaParamBytes(TLUA_M_VNM(P2))
+        + luaParamBytes(TLUA_M_VNM(P3));
 }
 
   virtual std::string getFormattedParameterValues() const
@@ -1546,6 +1628,11 @@ public:
     TLUA_M_VNM(P2) = LuaStrictStack<P2>::get(L, pos++);
     TLUA_M_VNM(P3) = LuaStrictStack<P3>::get(L, pos++);
     TLUA_M_VNM(P4) = LuaStrictStack<P4>::get(L, pos++);
+    mParamBytes = sizeof(*this)
+        + luaParamBytes(TLUA_M_VNM(P1))
+        + luaParamBytes(TLUA_M_VNM(P2))
+        + luaParamBytes(TLUA_M_VNM(P3))
+        + luaParamBytes(TLUA_M_VNM(P4));
 }
 
   virtual std::string getFormattedParameterValues() const
@@ -1645,6 +1732,12 @@ public:
     TLUA_M_VNM(P3) = LuaStrictStack<P3>::get(L, pos++);
     TLUA_M_VNM(P4) = LuaStrictStack<P4>::get(L, pos++);
     TLUA_M_VNM(P5) = LuaStrictStack<P5>::get(L, pos++);
+    mParamBytes = sizeof(*this)
+        + luaParamBytes(TLUA_M_VNM(P1))
+        + luaParamBytes(TLUA_M_VNM(P2))
+        + luaParamBytes(TLUA_M_VNM(P3))
+        + luaParamBytes(TLUA_M_VNM(P4))
+        + luaParamBytes(TLUA_M_VNM(P5));
 }
 
   virtual std::string getFormattedParameterValues() const
@@ -1755,6 +1848,13 @@ public:
     TLUA_M_VNM(P4) = LuaStrictStack<P4>::get(L, pos++);
     TLUA_M_VNM(P5) = LuaStrictStack<P5>::get(L, pos++);
     TLUA_M_VNM(P6) = LuaStrictStack<P6>::get(L, pos++);
+    mParamBytes = sizeof(*this)
+        + luaParamBytes(TLUA_M_VNM(P1))
+        + luaParamBytes(TLUA_M_VNM(P2))
+        + luaParamBytes(TLUA_M_VNM(P3))
+        + luaParamBytes(TLUA_M_VNM(P4))
+        + luaParamBytes(TLUA_M_VNM(P5))
+        + luaParamBytes(TLUA_M_VNM(P6));
 }
 
   virtual std::string getFormattedParameterValues() const
@@ -1876,6 +1976,14 @@ public:
     TLUA_M_VNM(P5) = LuaStrictStack<P5>::get(L, pos++);
     TLUA_M_VNM(P6) = LuaStrictStack<P6>::get(L, pos++);
     TLUA_M_VNM(P7) = LuaStrictStack<P7>::get(L, pos++);
+    mParamBytes = sizeof(*this)
+        + luaParamBytes(TLUA_M_VNM(P1))
+        + luaParamBytes(TLUA_M_VNM(P2))
+        + luaParamBytes(TLUA_M_VNM(P3))
+        + luaParamBytes(TLUA_M_VNM(P4))
+        + luaParamBytes(TLUA_M_VNM(P5))
+        + luaParamBytes(TLUA_M_VNM(P6))
+        + luaParamBytes(TLUA_M_VNM(P7));
 }
 
   virtual std::string getFormattedParameterValues() const
@@ -2008,6 +2116,15 @@ public:
     TLUA_M_VNM(P6) = LuaStrictStack<P6>::get(L, pos++);
     TLUA_M_VNM(P7) = LuaStrictStack<P7>::get(L, pos++);
     TLUA_M_VNM(P8) = LuaStrictStack<P8>::get(L, pos++);
+    mParamBytes = sizeof(*this)
+        + luaParamBytes(TLUA_M_VNM(P1))
+        + luaParamBytes(TLUA_M_VNM(P2))
+        + luaParamBytes(TLUA_M_VNM(P3))
+        + luaParamBytes(TLUA_M_VNM(P4))
+        + luaParamBytes(TLUA_M_VNM(P5))
+        + luaParamBytes(TLUA_M_VNM(P6))
+        + luaParamBytes(TLUA_M_VNM(P7))
+        + luaParamBytes(TLUA_M_VNM(P8));
 }
 
   virtual std::string getFormattedParameterValues() const
@@ -2151,6 +2268,16 @@ public:
     TLUA_M_VNM(P7) = LuaStrictStack<P7>::get(L, pos++);
     TLUA_M_VNM(P8) = LuaStrictStack<P8>::get(L, pos++);
     TLUA_M_VNM(P9) = LuaStrictStack<P9>::get(L, pos++);
+    mParamBytes = sizeof(*this)
+        + luaParamBytes(TLUA_M_VNM(P1))
+        + luaParamBytes(TLUA_M_VNM(P2))
+        + luaParamBytes(TLUA_M_VNM(P3))
+        + luaParamBytes(TLUA_M_VNM(P4))
+        + luaParamBytes(TLUA_M_VNM(P5))
+        + luaParamBytes(TLUA_M_VNM(P6))
+        + luaParamBytes(TLUA_M_VNM(P7))
+        + luaParamBytes(TLUA_M_VNM(P8))
+        + luaParamBytes(TLUA_M_VNM(P9));
 }
 
   virtual std::string getFormattedParameterValues() const
@@ -2305,6 +2432,17 @@ public:
     TLUA_M_VNM(P8) = LuaStrictStack<P8>::get(L, pos++);
     TLUA_M_VNM(P9) = LuaStrictStack<P9>::get(L, pos++);
     TLUA_M_VNM(P10) = LuaStrictStack<P10>::get(L, pos++);
+    mParamBytes = sizeof(*this)
+        + luaParamBytes(TLUA_M_VNM(P1))
+        + luaParamBytes(TLUA_M_VNM(P2))
+        + luaParamBytes(TLUA_M_VNM(P3))
+        + luaParamBytes(TLUA_M_VNM(P4))
+        + luaParamBytes(TLUA_M_VNM(P5))
+        + luaParamBytes(TLUA_M_VNM(P6))
+        + luaParamBytes(TLUA_M_VNM(P7))
+        + luaParamBytes(TLUA_M_VNM(P8))
+        + luaParamBytes(TLUA_M_VNM(P9))
+        + luaParamBytes(TLUA_M_VNM(P10));
 }
 
   virtual std::string getFormattedParameterValues() const
@@ -2462,6 +2600,8 @@ public:
   {
     int pos = si;
     TLUA_M_VNM(P1) = LuaStrictStack<P1>::get(L, pos++);
+    mParamBytes = sizeof(*this)
+        + luaParamBytes(TLUA_M_VNM(P1));
 }
 
   virtual std::string getFormattedParameterValues() const
@@ -2525,6 +2665,9 @@ public:
     int pos = si;
     TLUA_M_VNM(P1) = LuaStrictStack<P1>::get(L, pos++);
     TLUA_M_VNM(P2) = LuaStrictStack<P2>::get(L, pos++);
+    mParamBytes = sizeof(*this)
+        + luaParamBytes(TLUA_M_VNM(P1))
+        + luaParamBytes(TLUA_M_VNM(P2));
 }
 
   virtual std::string getFormattedParameterValues() const
@@ -2596,6 +2739,10 @@ public:
     TLUA_M_VNM(P1) = LuaStrictStack<P1>::get(L, pos++);
     TLUA_M_VNM(P2) = LuaStrictStack<P2>::get(L, pos++);
     TLUA_M_VNM(P3) = LuaStrictStack<P3>::get(L, pos++);
+    mParamBytes = sizeof(*this)
+        + luaParamBytes(TLUA_M_VNM(P1))
+        + luaParamBytes(TLUA_M_VNM(P2))
+        + luaParamBytes(TLUA_M_VNM(P3));
 }
 
   virtual std::string getFormattedParameterValues() const
@@ -2675,6 +2822,11 @@ public:
     TLUA_M_VNM(P2) = LuaStrictStack<P2>::get(L, pos++);
     TLUA_M_VNM(P3) = LuaStrictStack<P3>::get(L, pos++);
     TLUA_M_VNM(P4) = LuaStrictStack<P4>::get(L, pos++);
+    mParamBytes = sizeof(*this)
+        + luaParamBytes(TLUA_M_VNM(P1))
+        + luaParamBytes(TLUA_M_VNM(P2))
+        + luaParamBytes(TLUA_M_VNM(P3))
+        + luaParamBytes(TLUA_M_VNM(P4));
 }
 
   virtual std::string getFormattedParameterValues() const
@@ -2762,6 +2914,12 @@ public:
     TLUA_M_VNM(P3) = LuaStrictStack<P3>::get(L, pos++);
     TLUA_M_VNM(P4) = LuaStrictStack<P4>::get(L, pos++);
     TLUA_M_VNM(P5) = LuaStrictStack<P5>::get(L, pos++);
+    mParamBytes = sizeof(*this)
+        + luaParamBytes(TLUA_M_VNM(P1))
+        + luaParamBytes(TLUA_M_VNM(P2))
+        + luaParamBytes(TLUA_M_VNM(P3))
+        + luaParamBytes(TLUA_M_VNM(P4))
+        + luaParamBytes(TLUA_M_VNM(P5));
 }
 
   virtual std::string getFormattedParameterValues() const
@@ -2857,6 +3015,13 @@ public:
     TLUA_M_VNM(P4) = LuaStrictStack<P4>::get(L, pos++);
     TLUA_M_VNM(P5) = LuaStrictStack<P5>::get(L, pos++);
     TLUA_M_VNM(P6) = LuaStrictStack<P6>::get(L, pos++);
+    mParamBytes = sizeof(*this)
+        + luaParamBytes(TLUA_M_VNM(P1))
+        + luaParamBytes(TLUA_M_VNM(P2))
+        + luaParamBytes(TLUA_M_VNM(P3))
+        + luaParamBytes(TLUA_M_VNM(P4))
+        + luaParamBytes(TLUA_M_VNM(P5))
+        + luaParamBytes(TLUA_M_VNM(P6));
 }
 
   virtual std::string getFormattedParameterValues() const
@@ -2960,6 +3125,14 @@ public:
     TLUA_M_VNM(P5) = LuaStrictStack<P5>::get(L, pos++);
     TLUA_M_VNM(P6) = LuaStrictStack<P6>::get(L, pos++);
     TLUA_M_VNM(P7) = LuaStrictStack<P7>::get(L, pos++);
+    mParamBytes = sizeof(*this)
+        + luaParamBytes(TLUA_M_VNM(P1))
+        + luaParamBytes(TLUA_M_VNM(P2))
+        + luaParamBytes(TLUA_M_VNM(P3))
+        + luaParamBytes(TLUA_M_VNM(P4))
+        + luaParamBytes(TLUA_M_VNM(P5))
+        + luaParamBytes(TLUA_M_VNM(P6))
+        + luaParamBytes(TLUA_M_VNM(P7));
 }
 
   virtual std::string getFormattedParameterValues() const
@@ -3071,6 +3244,15 @@ public:
     TLUA_M_VNM(P6) = LuaStrictStack<P6>::get(L, pos++);
     TLUA_M_VNM(P7) = LuaStrictStack<P7>::get(L, pos++);
     TLUA_M_VNM(P8) = LuaStrictStack<P8>::get(L, pos++);
+    mParamBytes = sizeof(*this)
+        + luaParamBytes(TLUA_M_VNM(P1))
+        + luaParamBytes(TLUA_M_VNM(P2))
+        + luaParamBytes(TLUA_M_VNM(P3))
+        + luaParamBytes(TLUA_M_VNM(P4))
+        + luaParamBytes(TLUA_M_VNM(P5))
+        + luaParamBytes(TLUA_M_VNM(P6))
+        + luaParamBytes(TLUA_M_VNM(P7))
+        + luaParamBytes(TLUA_M_VNM(P8));
 }
 
   virtual std::string getFormattedParameterValues() const
@@ -3190,6 +3372,16 @@ public:
     TLUA_M_VNM(P7) = LuaStrictStack<P7>::get(L, pos++);
     TLUA_M_VNM(P8) = LuaStrictStack<P8>::get(L, pos++);
     TLUA_M_VNM(P9) = LuaStrictStack<P9>::get(L, pos++);
+    mParamBytes = sizeof(*this)
+        + luaParamBytes(TLUA_M_VNM(P1))
+        + luaParamBytes(TLUA_M_VNM(P2))
+        + luaParamBytes(TLUA_M_VNM(P3))
+        + luaParamBytes(TLUA_M_VNM(P4))
+        + luaParamBytes(TLUA_M_VNM(P5))
+        + luaParamBytes(TLUA_M_VNM(P6))
+        + luaParamBytes(TLUA_M_VNM(P7))
+        + luaParamBytes(TLUA_M_VNM(P8))
+        + luaParamBytes(TLUA_M_VNM(P9));
 }
 
   virtual std::string getFormattedParameterValues() const
@@ -3317,6 +3509,17 @@ public:
     TLUA_M_VNM(P8) = LuaStrictStack<P8>::get(L, pos++);
     TLUA_M_VNM(P9) = LuaStrictStack<P9>::get(L, pos++);
     TLUA_M_VNM(P10) = LuaStrictStack<P10>::get(L, pos++);
+    mParamBytes = sizeof(*this)
+        + luaParamBytes(TLUA_M_VNM(P1))
+        + luaParamBytes(TLUA_M_VNM(P2))
+        + luaParamBytes(TLUA_M_VNM(P3))
+        + luaParamBytes(TLUA_M_VNM(P4))
+        + luaParamBytes(TLUA_M_VNM(P5))
+        + luaParamBytes(TLUA_M_VNM(P6))
+        + luaParamBytes(TLUA_M_VNM(P7))
+        + luaParamBytes(TLUA_M_VNM(P8))
+        + luaParamBytes(TLUA_M_VNM(P9))
+        + luaParamBytes(TLUA_M_VNM(P10));
 }
 
   virtual std::string getFormattedParameterValues() const
@@ -0,0 +1,95 @@
+/*
+   For more information, please see: http://software.sci.utah.edu
+
+   The MIT License
+
+   Copyright (c) 2012 Scientific Computing and Imaging Institute,
+   University of Utah.
+
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  \brief  Pre-resolved handle to a registered Lua function.
+*/
+
+#include <sstream>
+#include <vector>
+
+#include "LuaScripting.h"
+#include "LuaFunctionHandle.h"
+
+using namespace std;
+
+namespace tuvok
+{
+
+//-----------------------------------------------------------------------------
+LuaFunctionHandle::LuaFunctionHandle()
+: mSS(NULL)
+, mSlot(LuaScripting::NO_FUNCTION_REF)
+, mGeneration(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+LuaFunctionHandle::LuaFunctionHandle(LuaScripting* ss, const string& fqName)
+: mSS(ss)
+, mFQName(fqName)
+, mSlot(LuaScripting::NO_FUNCTION_REF)
+, mGeneration(0)
+{
+  refresh();
+}
+
+//-----------------------------------------------------------------------------
+bool LuaFunctionHandle::isValid()
+{
+  if (mSS == NULL)
+    return false;
+
+  if (isCurrent())
+    return true;
+
+  size_t slot = mSS->getFunctionRef(mFQName);
+  if (slot == LuaScripting::NO_FUNCTION_REF)
+    return false;
+
+  mSlot       = slot;
+  mGeneration = mSS->mFunctionRefSlots[slot].generation;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void LuaFunctionHandle::refresh()
+{
+  size_t slot = mSS->getFunctionRef(mFQName);
+  if (slot == LuaScripting::NO_FUNCTION_REF)
+  {
+    ostringstream os;
+    os << "Could not resolve '" << mFQName << "' function.";
+    throw LuaNonExistantFunction(os.str());
+  }
+
+  mSlot       = slot;
+  mGeneration = mSS->mFunctionRefSlots[slot].generation;
+}
+
+} /* namespace tuvok */
@@ -0,0 +1,162 @@
+/*
+   For more information, please see: http://software.sci.utah.edu
+
+   The MIT License
+
+   Copyright (c) 2012 Scientific Computing and Imaging Institute,
+   University of Utah.
+
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  \brief  Pre-resolved handle to a registered Lua function.
+          Calling through a handle avoids the qualified name lookup that
+          cexec / cexecRet perform on every call: the function table is
+          fetched from the Lua registry with a single lua_rawgeti.
+*/
+
+#ifndef TUVOK_LUAFUNCTIONHANDLE_H_
+#define TUVOK_LUAFUNCTIONHANDLE_H_
+
+#include <string>
+
+#include "LuaScripting.h"
+
+namespace tuvok
+{
+
+/// Obtain handles through LuaScripting::resolve.
+///
+/// A handle is invalidated when its function (or a table containing it) is
+/// unregistered, when the class instance it belongs to is destroyed, or when
+/// removeAllRegistrations is called. The next call through an invalidated
+/// handle resolves the name again, and throws LuaNonExistantFunction if the
+/// function no longer exists.
+///
+/// A handle must not outlive the LuaScripting instance that created it.
+///
+/// Example:
+///  LuaFunctionHandle h = ss->resolve("tuvok.state.getHashTableSize");
+///  unsigned int size = h.call<unsigned int>();
+class LuaFunctionHandle
+{
+public:
+
+  LuaFunctionHandle();
+  LuaFunctionHandle(LuaScripting* ss, const std::string& fqName);
+
+  /// Returns true if the handle refers to a registered function.
+  /// Re-resolves the function if the handle was invalidated.
+  bool isValid();
+
+  /// Fully qualified name the handle was resolved from.
+  const std::string& fqName() const   {return mFQName;}
+
+  /// Calls the function with the given parameters. Provenance and hooks
+  /// behave exactly as they do for cexec / cexecRet.
+  /// Use call<void>(...) for functions that do not return a value.
+  template <typename T, typename... Args>
+  T call(Args... args);
+
+private:
+
+  /// Pushes the function table onto the stack of the returned Lua state.
+  lua_State* pushFunction();
+
+  /// Re-resolves mFQName. Throws LuaNonExistantFunction on failure.
+  void refresh();
+
+  /// True if mSlot still references the function that was resolved.
+  bool isCurrent() const
+  {
+    return mSlot != LuaScripting::NO_FUNCTION_REF
+        && mSS->mFunctionRefSlots[mSlot].generation == mGeneration;
+  }
+
+  LuaScripting* mSS;         ///< Not owned. Whoever holds the handle must
+                             ///< keep the scripting system alive, e.g. by
+                             ///< holding its shared_ptr for longer.
+  std::string   mFQName;
+  size_t        mSlot;        ///< Slot in LuaScripting::mFunctionRefSlots.
+  unsigned      mGeneration;  ///< Generation of the slot when resolved.
+};
+
+inline void luaPushHandleParams(lua_State*) {}
+
+template <typename P, typename... Rest>
+void luaPushHandleParams(lua_State* L, P p, Rest... rest)
+{
+  LuaStrictStack<P>::push(L, p);
+  luaPushHandleParams(L, rest...);
+}
+
+/// Handles void return types for LuaFunctionHandle::call.
+///@{
+template <typename T>
+struct LuaHandleReturn
+{
+  static T call(lua_State* L, int nparams)
+  {
+    lua_call(L, nparams, 1);
+    T ret = LuaStrictStack<T>::get(L, lua_gettop(L));
+    lua_pop(L, 1);
+    return ret;
+  }
+};
+
+template <>
+struct LuaHandleReturn<void>
+{
+  static void call(lua_State* L, int nparams)
+  {
+    lua_call(L, nparams, 0);
+  }
+};
+///@}
+
+inline lua_State* LuaFunctionHandle::pushFunction()
+{
+  if (mSS == NULL)
+    throw LuaNonExistantFunction("Call through an empty function handle.");
+
+  if (isCurrent() == false)
+    refresh();
+
+  lua_State* L = mSS->mL;
+  lua_rawgeti(L, LUA_REGISTRYINDEX, mSS->mFunctionRefSlots[mSlot].ref);
+  return L;
+}
+
+template <typename T, typename... Args>
+T LuaFunctionHandle::call(Args... args)
+{
+  lua_State* L = pushFunction();
+  LuaStackRAII _a = LuaStackRAII(L, 1, 0); // Consumes the function table.
+
+  // Calling the function table directly invokes its __call metamethod with
+  // the table as the first parameter, which is what LuaCallback expects.
+  luaPushHandleParams(L, args...);
+  return LuaHandleReturn<T>::call(L, static_cast<int>(sizeof...(Args)));
+}
+
+} /* namespace tuvok */
+
+#endif
@@ -74,6 +74,7 @@ LuaMemberReg::~LuaMemberReg()
 
 #ifdef LUASCRIPTING_UNIT_TESTS
 #include "utestCommon.h"
+#include "LuaFunctionHandle.h"
 using namespace tuvok;
 
 SUITE(LuaTestMemberFunctionRegistration)
@@ -159,6 +160,45 @@ SUITE(LuaTestMemberFunctionRegistration)
     sc->setExpectedExceptionFlag(false);
   }
 
+  TEST(MemberFunctionHandleDereg)
+  {
+    TEST_HEADER;
+
+    shared_ptr<LuaScripting> sc(new LuaScripting());
+
+    unique_ptr<A> a(new A(sc));
+    a->mReg.registerFunction(a.get(), &A::m2, "a.m2", "A::m2", true);
+
+    unique_ptr<A> b(new A(sc));
+    b->mReg.registerFunction(b.get(), &A::m2, "b.m2", "A::m2", true);
+    b->mReg.registerFunction(b.get(), &A::m1, "b.m1", "A::m1", true);
+
+    LuaFunctionHandle h = sc->resolve("a.m2");
+    LuaFunctionHandle hb = sc->resolve("b.m2");
+    CHECK_EQUAL(true, h.call<bool>(41));
+    CHECK_EQUAL(false, h.call<bool>(40));
+
+    // Deregistration invalidates the handle, but not handles to other
+    // functions. Rebinding b.m2 in Lua would be picked up by a handle that
+    // re-resolves its name (provenance would look up the rebound name too).
+    sc->enableProvenance(false);
+    sc->exec("bm2 = b.m2; b.m2 = b.m1");
+    a.reset();
+    CHECK_EQUAL(false, h.isValid());
+    CHECK_EQUAL(false, hb.call<bool>(40));
+    sc->exec("b.m2 = bm2; bm2 = nil");
+    sc->enableProvenance(true);
+    sc->setExpectedExceptionFlag(true);
+    CHECK_THROW(h.call<bool>(41), LuaNonExistantFunction);
+    sc->setExpectedExceptionFlag(false);
+
+    // The handle picks up a function registered under the same name.
+    a = unique_ptr<A>(new A(sc));
+    a->mReg.registerFunction(a.get(), &A::m2, "a.m2", "A::m2", true);
+    CHECK_EQUAL(true, h.isValid());
+    CHECK_EQUAL(true, h.call<bool>(41));
+  }
+
   TEST(MemberFunctionCallHooksAndDereg)
   {
     TEST_HEADER;
@@ -211,6 +251,18 @@ SUITE(LuaTestMemberFunctionRegistration)
     CHECK_EQUAL(452, a->hookm2_var);
 
     sc->exec("provenance.logProvRecord_toConsole()");
+
+    // Without provenance only hooked functions leave the fast path, and
+    // they return to it once their hooks are gone.
+    sc->enableProvenance(false);
+    sc->exec("m2(7)");
+    CHECK_EQUAL(7, a->hookm2_var);
+    a->mReg.unregisterHooks();
+    sc->exec("m2(8)");
+    CHECK_EQUAL(7, a->hookm2_var);
+    a->mReg.strictHook(a.get(), &A::hookm2, "m2");
+    sc->exec("m2(9)");
+    CHECK_EQUAL(9, a->hookm2_var);
   }
 
   class B
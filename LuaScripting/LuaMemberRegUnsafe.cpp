@@ -118,17 +118,29 @@ void LuaMemberRegUnsafe::unregisterHooks()
       continue;
     }
 
+    int funcTable = lua_gettop(L);
+
     // Obtain the hooked member function table.
     lua_getfield(L, -1, LuaScripting::TBL_MD_MEMBER_HOOKS);
 
-    // Just set the member hook ID field to nil, don't check to see if its there
-    // since we do not wan to throw an exception (likely called from
-    // destructor).
-    lua_pushnil(L);
-    lua_setfield(L, -2, mHookID.c_str());
+    // Just set the member hook ID field to nil, don't throw an exception if it
+    // is not there (likely called from destructor).
+    bool hooked = false;
+    if (lua_istable(L, -1))
+    {
+      lua_getfield(L, -1, mHookID.c_str());
+      hooked = (lua_isnil(L, -1) == 0);
+      lua_pop(L, 1);
+      lua_pushnil(L);
+      lua_setfield(L, -2, mHookID.c_str());
+    }
+    lua_pop(L, 1);  // Pop the hooks table.
 
-    // Pop function table and hooks table off the stack.
-    lua_pop(L, 2);
+    if (hooked)
+      mScriptSystem->hookRemoved(funcTable);
+
+    // Pop function table off the stack.
+    lua_pop(L, 1);
   }
 
   mHookedFunctions.clear();
@@ -70,6 +70,16 @@ public:
   std::string registerFunction(T* C, FunPtr f, const std::string& name,
                                const std::string& desc, bool undoRedo);
 
+  /// Registers the member function f of C as the method unqualifiedName of
+  /// the class instance inst. The closure and metadata are built once per
+  /// class and method (see LuaScripting::createClassMethodProto), so only a
+  /// small function table is created per instance.
+  /// \return The fully qualified name of the method.
+  template <typename T, typename FunPtr>
+  std::string registerClassMethod(T* C, FunPtr f, LuaClassInstance inst,
+                                  const std::string& unqualifiedName,
+                                  const std::string& desc, bool undoRedo);
+
   /// See LuaScripting::strictHook.
   template <typename T, typename FunPtr>
   void strictHook(T* C, FunPtr f, const std::string& name);
@@ -137,6 +147,14 @@ private:
 
       FunPtr fp = *static_cast<FunPtr*>(lua_touserdata(L, lua_upvalueindex(1)));
       T* bClass = reinterpret_cast<T*>(lua_touserdata(L, lua_upvalueindex(2)));
+      if (bClass == NULL)
+      {
+        // Class methods share their closure, the object is stored in the
+        // function table.
+        lua_getfield(L, 1, LuaScripting::TBL_MD_MEMBER_INST);
+        bClass = reinterpret_cast<T*>(lua_touserdata(L, -1));
+        lua_pop(L, 1);
+      }
       typename LuaCFunExec<FunPtr>::classType* C =
           dynamic_cast<typename LuaCFunExec<FunPtr>::classType*>(bClass);
       typename LuaStrictStack<Ret>::Type r;
@@ -144,6 +162,16 @@ private:
       {
         LuaScripting* ss = static_cast<LuaScripting*>(
             lua_touserdata(L, lua_upvalueindex(4)));
+        LuaScripting::ProfileScope _p(ss, L, 1);
+
+        // Fast path: nothing to record or dispatch when provenance is
+        // disabled and the function has no hooks.
+        if (ss->isFastCallEligible(L, 1))
+        {
+          r = LuaCFunExec<FunPtr>::run(L, 2, C, fp);
+          LuaStrictStack<Ret>().push(L, r);
+          return 1;
+        }
 
         std::shared_ptr<LuaCFunAbstract> execParams(
             new LuaCFunExec<FunPtr>());
@@ -199,6 +227,14 @@ private:
 
       FunPtr fp = *static_cast<FunPtr*>(lua_touserdata(L, lua_upvalueindex(1)));
       T* bClass = reinterpret_cast<T*>(lua_touserdata(L, lua_upvalueindex(2)));
+      if (bClass == NULL)
+      {
+        // Class methods share their closure, the object is stored in the
+        // function table.
+        lua_getfield(L, 1, LuaScripting::TBL_MD_MEMBER_INST);
+        bClass = reinterpret_cast<T*>(lua_touserdata(L, -1));
+        lua_pop(L, 1);
+      }
       typename LuaCFunExec<FunPtr>::classType* C =
           dynamic_cast<typename LuaCFunExec<FunPtr>::classType*>(bClass);
 
@@ -206,6 +242,13 @@ private:
       {
         LuaScripting* ss = static_cast<LuaScripting*>(
             lua_touserdata(L, lua_upvalueindex(4)));
+        LuaScripting::ProfileScope _p(ss, L, 1);
+
+        if (ss->isFastCallEligible(L, 1))
+        {
+          LuaCFunExec<FunPtr>::run(L, 2, C, fp);
+          return 0;
+        }
 
         std::shared_ptr<LuaCFunAbstract> execParams(
             new LuaCFunExec<FunPtr>());
@@ -337,6 +380,61 @@ std::string LuaMemberRegUnsafe::registerFunction(T* C, FunPtr f,
   return name;
 }
 
+template <typename T, typename FunPtr>
+std::string LuaMemberRegUnsafe::registerClassMethod(
+    T* C, FunPtr f, LuaClassInstance inst,
+    const std::string& unqualifiedName,
+    const std::string& desc, bool undoRedo)
+{
+  LuaScripting* ss  = mScriptSystem;
+  lua_State*    L   = ss->getLuaState();
+
+  LuaStackRAII _a = LuaStackRAII(L, 0, 0);
+
+  lua_CFunction proxyFunc = &LuaMemberCallback<T, FunPtr, typename
+      LuaCFunExec<FunPtr>::returnType>::exec;
+
+  if (ss->getClassMethodProto(inst, unqualifiedName, proxyFunc, &f,
+                              sizeof(FunPtr), desc, undoRedo) == false)
+  {
+    // Same closure as registerFunction, except that the object is looked up
+    // in the function table.
+    void* udata = lua_newuserdata(L, sizeof(FunPtr));
+    memcpy(udata, &f, sizeof(FunPtr));
+    lua_pushlightuserdata(L, NULL);
+    lua_pushboolean(L, 0);  // We are NOT a hook.
+    lua_pushlightuserdata(L, static_cast<void*>(mScriptSystem));
+    lua_pushcclosure(L, proxyFunc, 4);
+    int closure = lua_gettop(L);
+
+    LuaCFunExec<FunPtr> defaultParams = LuaCFunExec<FunPtr>();
+    lua_checkstack(L, LUAC_MAX_NUM_PARAMS); // Max num parameters supported
+    defaultParams.pushParamsToStack(L);
+    int numFunParams = lua_gettop(L) - closure;
+
+    ss->createClassMethodProto(
+        inst, unqualifiedName, desc,
+        LuaCFunExec<FunPtr>::getSignature(""),
+        LuaCFunExec<FunPtr>::getSignature(unqualifiedName),
+        LuaCFunExec<FunPtr>::getSigNoReturn(""),
+        undoRedo, numFunParams);
+
+#ifdef TUVOK_DEBUG_LUA_USE_RTTI_CHECKS
+    lua_getfield(L, -1, "__index");
+    LuaCFunExec<FunPtr>::buildTypeTable(L);
+    lua_setfield(L, -2, LuaScripting::TBL_MD_TYPES_TABLE);
+    lua_pop(L, 1);
+#endif
+  }
+
+  std::string name = ss->bindClassMethod(inst, unqualifiedName,
+                                         reinterpret_cast<void*>(C),
+                                         lua_gettop(L));
+  lua_pop(L, 1);   // Pop the prototype.
+
+  return name;
+}
+
 template <typename T, typename FunPtr>
 void LuaMemberRegUnsafe::strictHook(T* C, FunPtr f, const std::string& name)
 {
@@ -381,11 +479,14 @@ void LuaMemberRegUnsafe::strictHookInternal(
   }
   lua_pop(L, 1);
 
-  // Obtain hook table.
-  lua_getfield(L, -1, LuaScripting::TBL_MD_MEMBER_HOOKS);
+  // Obtain hook table (undo/redo functions are stored in the function table).
+  bool regUndoRedo = (registerUndo || registerRedo);
+  if (regUndoRedo)
+    lua_pushnil(L);
+  else
+    mScriptSystem->pushHookTable(funcTable, LuaScripting::TBL_MD_MEMBER_HOOKS);
   int hookTable = lua_gettop(L);
 
-  bool regUndoRedo = (registerUndo || registerRedo);
   if (!regUndoRedo)
   {
     // Ensure our hook descriptor is not already there.
@@ -415,6 +516,7 @@ void LuaMemberRegUnsafe::strictHookInternal(
   {
     // Associate closure with hook table.
     lua_setfield(L, hookTable, mHookID.c_str());
+    mScriptSystem->hookAdded(funcTable);
     mHookedFunctions.push_back(name);
   }
   else
@@ -0,0 +1,233 @@
+/*
+   For more information, please see: http://software.sci.utah.edu
+
+   The MIT License
+
+   Copyright (c) 2012 Scientific Computing and Imaging Institute,
+   University of Utah.
+
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  \brief   Call profiler composited inside of the LuaScripting class.
+*/
+
+#include <algorithm>
+#include <cassert>
+
+#include "LuaScripting.h"
+#include "LuaProfiler.h"
+
+using namespace std;
+
+namespace tuvok
+{
+
+//-----------------------------------------------------------------------------
+LuaProfiler::LuaProfiler(LuaScripting* scripting)
+: mEnabled(false)
+, mScripting(scripting)
+, mMemberReg(scripting)
+{
+}
+
+//-----------------------------------------------------------------------------
+LuaProfiler::~LuaProfiler()
+{
+  // We purposefully do NOT unregister our Lua functions (see
+  // ~LuaProvenance).
+}
+
+//-----------------------------------------------------------------------------
+void LuaProfiler::registerLuaProfilerFunctions()
+{
+  mMemberReg.registerFunction(this, &LuaProfiler::setEnabled,
+                              "profile.enable",
+                              "Enables/Disables the call profiler "
+                              "(def: false).",
+                              false);
+  mMemberReg.registerFunction(this, &LuaProfiler::isEnabled,
+                              "profile.isEnabled",
+                              "True if the call profiler is enabled.",
+                              false);
+  mMemberReg.registerFunction(this, &LuaProfiler::reset,
+                              "profile.reset",
+                              "Discards all recorded call statistics.",
+                              false);
+  mMemberReg.registerFunction(this, &LuaProfiler::report,
+                              "profile.report",
+                              "Returns a table with one row {name, calls, "
+                              "self (ms), inclusive (ms)} per function called "
+                              "while profiling, most expensive first.",
+                              false);
+}
+
+//-----------------------------------------------------------------------------
+void LuaProfiler::setEnabled(bool enabled)
+{
+  mEnabled = enabled;
+  mScripting->mProfiling = enabled;
+}
+
+//-----------------------------------------------------------------------------
+void LuaProfiler::reset()
+{
+  // Entries stay allocated: frames of calls in progress (at least the call
+  // to profile.reset) still refer to them.
+  for (vector<Entry>::iterator it = mEntries.begin(); it != mEntries.end();
+       ++it)
+  {
+    it->calls     = 0;
+    it->inclusive = 0;
+    it->self      = 0;
+  }
+}
+
+//-----------------------------------------------------------------------------
+void LuaProfiler::forgetFunctions(const string& fqName)
+{
+  static const string hooksSuffix = " (hooks)";
+
+  for (int hooks = 0; hooks < 2; ++hooks)
+  {
+    unordered_map<const void*, size_t>::iterator it =
+        mEntryByTable[hooks].begin();
+    while (it != mEntryByTable[hooks].end())
+    {
+      string name = mEntries[it->second].name;
+      if (hooks)
+        name.erase(name.size() - hooksSuffix.size());
+
+      if (name.compare(0, fqName.size(), fqName) == 0
+          && (name.size() == fqName.size() || name[fqName.size()] == '.'))
+        it = mEntryByTable[hooks].erase(it);
+      else
+        ++it;
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+void LuaProfiler::forgetAllFunctions()
+{
+  mEntryByTable[0].clear();
+  mEntryByTable[1].clear();
+}
+
+//-----------------------------------------------------------------------------
+size_t LuaProfiler::lookupEntry(lua_State* L, int tableIndex, bool hooks)
+{
+  const void* table = lua_topointer(L, tableIndex);
+  unordered_map<const void*, size_t>::iterator it =
+      mEntryByTable[hooks].find(table);
+  if (it != mEntryByTable[hooks].end())
+    return it->second;
+
+  lua_getfield(L, tableIndex, LuaScripting::TBL_MD_QNAME);
+  string name = lua_isstring(L, -1) ? lua_tostring(L, -1) : "<unknown>";
+  lua_pop(L, 1);
+  if (hooks)
+    name += " (hooks)";
+
+  size_t entry;
+  unordered_map<string, size_t>::iterator byName = mEntryByName.find(name);
+  if (byName != mEntryByName.end())
+  {
+    entry = byName->second;
+  }
+  else
+  {
+    entry = mEntries.size();
+    mEntries.push_back(Entry(name));
+    mEntryByName[name] = entry;
+  }
+
+  mEntryByTable[hooks][table] = entry;
+  return entry;
+}
+
+//-----------------------------------------------------------------------------
+void LuaProfiler::enter(lua_State* L, int tableIndex, bool hooks)
+{
+  Frame f;
+  f.entry    = lookupEntry(L, tableIndex, hooks);
+  f.children = 0;
+
+  Entry& e = mEntries[f.entry];
+  ++e.calls;
+  ++e.active;
+
+  if (!hooks)
+  {
+    lua_getfield(L, tableIndex, LuaScripting::TBL_MD_NUM_EXEC);
+    lua_Integer numExec = lua_tointeger(L, -1);
+    lua_pop(L, 1);
+    lua_pushinteger(L, numExec + 1);
+    lua_setfield(L, tableIndex, LuaScripting::TBL_MD_NUM_EXEC);
+  }
+
+  f.start = Clock::now();
+  mStack.push_back(f);
+}
+
+//-----------------------------------------------------------------------------
+void LuaProfiler::leave()
+{
+  assert(!mStack.empty());
+  const Frame& f = mStack.back();
+  double elapsed = chrono::duration<double, milli>(
+      Clock::now() - f.start).count();
+
+  Entry& e = mEntries[f.entry];
+  e.self += elapsed - f.children;
+  if (--e.active == 0)
+    e.inclusive += elapsed;
+
+  mStack.pop_back();
+  if (!mStack.empty())
+    mStack.back().children += elapsed;
+}
+
+//-----------------------------------------------------------------------------
+vector<tuple<string, uint64_t, double, double> > LuaProfiler::report() const
+{
+  vector<const Entry*> sorted;
+  for (vector<Entry>::const_iterator it = mEntries.begin();
+       it != mEntries.end(); ++it)
+  {
+    if (it->calls > 0)
+      sorted.push_back(&*it);
+  }
+  sort(sorted.begin(), sorted.end(),
+       [](const Entry* a, const Entry* b) {return a->self > b->self;});
+
+  vector<tuple<string, uint64_t, double, double> > rows;
+  rows.reserve(sorted.size());
+  for (vector<const Entry*>::const_iterator it = sorted.begin();
+       it != sorted.end(); ++it)
+  {
+    const Entry& e = **it;
+    rows.push_back(make_tuple(e.name, e.calls, e.self, e.inclusive));
+  }
+  return rows;
+}
+
+} /* namespace tuvok */
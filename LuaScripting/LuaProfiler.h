@@ -0,0 +1,136 @@
+/*
+   For more information, please see: http://software.sci.utah.edu
+
+   The MIT License
+
+   Copyright (c) 2012 Scientific Computing and Imaging Institute,
+   University of Utah.
+
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  \brief   Call profiler composited inside of the LuaScripting class.
+           Records the number of calls, inclusive time and self time of every
+           registered function, hook and class instance method.
+*/
+
+#ifndef TUVOK_LUAPROFILER_H_
+#define TUVOK_LUAPROFILER_H_
+
+#include <chrono>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "LuaMemberRegUnsafe.h"
+
+namespace tuvok
+{
+
+class LuaScripting;
+
+/// The profiler is disabled by default. While disabled, calls only pay for
+/// the check of LuaScripting::isProfiling.
+///
+/// Hooks are accounted under the name of the function they are attached to,
+/// with a ' (hooks)' suffix. Self time is the inclusive time minus the time
+/// spent in nested registered calls; recursive calls do not count towards
+/// the inclusive time twice.
+class LuaProfiler
+{
+public:
+  // This class is made for compositing inside LuaScripting, hence the pointer.
+  LuaProfiler(LuaScripting* scripting);
+  ~LuaProfiler();
+
+  bool isEnabled() const    {return mEnabled;}
+  void setEnabled(bool enabled);
+
+  /// Discards all recorded statistics.
+  void reset();
+
+  /// One row per function that was called, most self time first: name,
+  /// calls, self time and inclusive time (both in milliseconds).
+  std::vector<std::tuple<std::string, uint64_t, double, double> >
+  report() const;
+
+  /// Registers profiler functions with Lua.
+  /// These functions are NEVER deregistered and persist for the lifetime
+  /// of the associated LuaScripting system.
+  void registerLuaProfilerFunctions();
+
+  /// Begins a call of the function table at tableIndex. Every call to enter
+  /// must be matched by a call to leave, even if the profiler is disabled in
+  /// between.
+  void enter(lua_State* L, int tableIndex, bool hooks);
+  void leave();
+
+  /// Drops the cached function tables of fqName and of the functions below
+  /// it. Called by the scripting system before they are unregistered.
+  void forgetFunctions(const std::string& fqName);
+  /// Drops all cached function tables.
+  void forgetAllFunctions();
+
+private:
+
+  typedef std::chrono::steady_clock Clock;
+
+  struct Entry
+  {
+    Entry(const std::string& n)
+    : name(n), calls(0), inclusive(0), self(0), active(0)
+    {}
+
+    std::string name;
+    uint64_t    calls;
+    double      inclusive;  ///< Milliseconds.
+    double      self;       ///< Milliseconds.
+    int         active;     ///< Recursion depth.
+  };
+
+  struct Frame
+  {
+    size_t            entry;
+    Clock::time_point start;
+    double            children; ///< Milliseconds spent in nested calls.
+  };
+
+  /// Index of the entry for the function table at tableIndex.
+  size_t lookupEntry(lua_State* L, int tableIndex, bool hooks);
+
+  bool                                  mEnabled;
+  LuaScripting*                         mScripting;
+  LuaMemberRegUnsafe                    mMemberReg;
+
+  std::vector<Entry>                    mEntries;
+  std::unordered_map<std::string, size_t> mEntryByName;
+  /// Function tables resolved to entries. Function tables may be collected
+  /// once they are unregistered, so the scripting system makes us forget
+  /// them (see forgetFunctions).
+  std::unordered_map<const void*, size_t> mEntryByTable[2];
+
+  std::vector<Frame>                    mStack;
+};
+
+} /* namespace tuvok */
+
+#endif
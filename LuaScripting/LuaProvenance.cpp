@@ -42,7 +42,16 @@
 using namespace std;
 
 #define DEFAULT_UNDOREDO_BUFFER_SIZE  (50)
-#define DEFAULT_PROVENANCE_BUFFER_SIZE  (150)
+#define DEFAULT_PROVENANCE_BUFFER_SIZE  (4096)
+
+// Parameter captures larger than this are formatted when they are logged
+// instead of being shared with the undo/redo stack. Their text is truncated to
+// the same length.
+#define PROVENANCE_LOG_MAX_CAPTURE_BYTES  (1024)
+
+// Default limits for the undo/redo stack (0 = unlimited).
+#define DEFAULT_UNDOREDO_MAX_ITEMS    (0)
+#define DEFAULT_UNDOREDO_MAX_MEMORY   (64 * 1024 * 1024)
 
 namespace tuvok
 {
@@ -53,16 +62,21 @@ LuaProvenance::LuaProvenance(LuaScripting* scripting)
 , mTemporarilyDisabled(false)
 , mUndoingInstanceDel(false)
 , mStackPointer(0)
+, mMaxItems(DEFAULT_UNDOREDO_MAX_ITEMS)
+, mMaxBytes(DEFAULT_UNDOREDO_MAX_MEMORY)
+, mUndoRedoBytes(0)
+, mProvLogSize(DEFAULT_PROVENANCE_BUFFER_SIZE)
+, mProvLogHead(0)
+, mProvLogCount(0)
 , mScripting(scripting)
 , mMemberReg(scripting)
 , mLoggingProvenance(false)
 , mDoProvReenterException(true)
 , mProvenanceDescLogEnabled(false)  // Disable the provenance log (performance)
 , mUndoRedoProvenanceDisable(false)
+, mRedoing(false)
 , mCommandDepth(0)
 {
-  mUndoRedoStack.reserve(DEFAULT_PROVENANCE_BUFFER_SIZE);
-  mProvenanceDescList.reserve(DEFAULT_PROVENANCE_BUFFER_SIZE);
 }
 
 //-----------------------------------------------------------------------------
@@ -97,6 +111,12 @@ void LuaProvenance::registerLuaProvenanceFunctions()
                               "provenance.enableProvLog",
                               "Enables/Disables provenance log (def: false).",
                               false);
+  mMemberReg.registerFunction(this, &LuaProvenance::setProvLogSize,
+                              "provenance.setProvLogSize",
+                              "Number of records kept in the provenance log. "
+                              "The oldest records are overwritten once the "
+                              "log is full (def: 4096). Clears the log.",
+                              false);
   mMemberReg.registerFunction(this, &LuaProvenance::clearProvenance,
                               "provenance.clear",
                               "Clears all provenance and undo/redo stacks. "
@@ -127,6 +147,25 @@ void LuaProvenance::registerLuaProvenanceFunctions()
                               "Prints the entire provenance record "
                               "to 'log.info'.",
                               false);
+  mMemberReg.registerFunction(this, &LuaProvenance::setMaxItems,
+                              "provenance.setMaxItems",
+                              "Maximum number of undo/redo entries. Older "
+                              "entries are evicted to the journal "
+                              "(0 = unlimited, the default).",
+                              false);
+  mMemberReg.registerFunction(this, &LuaProvenance::setMaxMemory,
+                              "provenance.setMaxMemory",
+                              "Maximum estimated memory, in bytes, held by "
+                              "undo/redo entries. Older entries are evicted "
+                              "to the journal (0 = unlimited, def: 64MB).",
+                              false);
+  mMemberReg.registerFunction(this, &LuaProvenance::setJournalFile,
+                              "provenance.setJournal",
+                              "Append evicted undo/redo entries to the given "
+                              "file as Lua statements that can be replayed "
+                              "in the same session. An empty string "
+                              "discards evicted entries.",
+                              false);
   // Reentry exception does not need to be stack exempt.
 }
 
@@ -136,14 +175,187 @@ bool LuaProvenance::isEnabled() const
   return mEnabled;
 }
 
+//-----------------------------------------------------------------------------
+bool LuaProvenance::isRecording() const
+{
+  return mEnabled && !mTemporarilyDisabled && !mUndoRedoProvenanceDisable;
+}
+
+//-----------------------------------------------------------------------------
+void LuaProvenance::addClearObserver(const void* owner,
+                                     std::function<void ()> observer)
+{
+  mClearObservers.push_back(make_pair(owner, observer));
+}
+
+//-----------------------------------------------------------------------------
+void LuaProvenance::removeClearObservers(const void* owner)
+{
+  for (vector<ClearObserver>::iterator it = mClearObservers.begin();
+       it != mClearObservers.end();)
+  {
+    if (it->first == owner)
+      it = mClearObservers.erase(it);
+    else
+      ++it;
+  }
+}
+
 //-----------------------------------------------------------------------------
 void LuaProvenance::enableLogAll(bool enabled)
 {
   mProvenanceDescLogEnabled = enabled;
 
-  if (mProvenanceDescLogEnabled == false)
+  // The ring is allocated lazily, most sessions never enable the log.
+  if (mProvenanceDescLogEnabled)
+  {
+    if (mProvLog.empty())
+      mProvLog.resize(mProvLogSize);
+  }
+  else
+  {
+    clearProvLog();
+    vector<ProvLogRecord>().swap(mProvLog);
+  }
+}
+
+//-----------------------------------------------------------------------------
+void LuaProvenance::setProvLogSize(size_t records)
+{
+  if (records == 0)
+    records = 1;
+
+  clearProvLog();
+  mProvLogSize = records;
+  if (mProvenanceDescLogEnabled)
+  {
+    mProvLog.resize(records);
+    mProvLog.shrink_to_fit();
+  }
+}
+
+//-----------------------------------------------------------------------------
+void LuaProvenance::clearProvLog()
+{
+  for (size_t i = 0; i < mProvLogCount; ++i)
+  {
+    ProvLogRecord& rec = mProvLog[(mProvLogHead + i) % mProvLog.size()];
+    rec.params.reset();
+    rec.text.clear();
+  }
+  mProvLogHead = 0;
+  mProvLogCount = 0;
+
+  // No record references the interned names anymore.
+  mProvLogFunNames.clear();
+  mProvLogFunIDs.clear();
+}
+
+//-----------------------------------------------------------------------------
+LuaProvenance::ProvLogRecord&
+LuaProvenance::pushProvLogRecord(ProvLogRecord::Type type)
+{
+  size_t index = (mProvLogHead + mProvLogCount) % mProvLog.size();
+  if (mProvLogCount == mProvLog.size())
+    mProvLogHead = (mProvLogHead + 1) % mProvLog.size();
+  else
+    ++mProvLogCount;
+
+  // Records are reused in place, so the text buffer keeps its capacity.
+  ProvLogRecord& rec = mProvLog[index];
+  rec.type = type;
+  rec.funID = -1;
+  rec.instID = -1;
+  rec.value = 0;
+  rec.params.reset();
+  rec.text.clear();
+  return rec;
+}
+
+//-----------------------------------------------------------------------------
+void LuaProvenance::internFunctionName(ProvLogRecord& rec,
+                                       const string& fname)
+{
+  // Instance functions are named '_sys_.inst.m<ID>.<method>'. Interning them
+  // as is would add a name for every instance ever created, so only the method
+  // part is interned.
+  string name = fname;
+  string instPath = string(LuaClassInstance::CLASS_INSTANCE_TABLE) + "."
+      + LuaClassInstance::CLASS_INSTANCE_PREFIX;
+  if (fname.compare(0, instPath.size(), instPath) == 0)
+  {
+    size_t idEnd = fname.find_first_not_of("0123456789", instPath.size());
+    if (idEnd != string::npos && idEnd > instPath.size()
+        && fname[idEnd] == '.')
+    {
+      rec.instID = atoi(fname.c_str() + instPath.size());
+      name = fname.substr(idEnd);
+    }
+  }
+
+  unordered_map<string, int>::iterator it = mProvLogFunIDs.find(name);
+  if (it != mProvLogFunIDs.end())
+  {
+    rec.funID = it->second;
+    return;
+  }
+
+  rec.funID = static_cast<int>(mProvLogFunNames.size());
+  mProvLogFunNames.push_back(name);
+  mProvLogFunIDs.insert(make_pair(name, rec.funID));
+}
+
+//-----------------------------------------------------------------------------
+string LuaProvenance::getFunctionName(const ProvLogRecord& rec) const
+{
+  if (rec.instID == -1)
+    return mProvLogFunNames[rec.funID];
+
+  ostringstream os;
+  os << LuaClassInstance::CLASS_INSTANCE_TABLE << "."
+     << LuaClassInstance::CLASS_INSTANCE_PREFIX << rec.instID
+     << mProvLogFunNames[rec.funID];
+  return os.str();
+}
+
+//-----------------------------------------------------------------------------
+void LuaProvenance::setProvLogParams(ProvLogRecord& rec,
+                                     shared_ptr<LuaCFunAbstract> params)
+{
+  if (params.get() == NULL
+      || params->sizeBytes() <= PROVENANCE_LOG_MAX_CAPTURE_BYTES)
+  {
+    rec.params = params;
+    return;
+  }
+
+  rec.text = params->getFormattedParameterValues();
+  if (rec.text.size() > PROVENANCE_LOG_MAX_CAPTURE_BYTES)
+  {
+    rec.text.resize(PROVENANCE_LOG_MAX_CAPTURE_BYTES);
+    rec.text += "...";
+  }
+}
+
+//-----------------------------------------------------------------------------
+string LuaProvenance::formatProvLogParams(const ProvLogRecord& rec) const
+{
+  if (rec.params.get() != NULL)
+    return rec.params->getFormattedParameterValues();
+  return rec.text;
+}
+
+//-----------------------------------------------------------------------------
+void LuaProvenance::releaseProvLogParams()
+{
+  for (size_t i = 0; i < mProvLogCount; ++i)
   {
-    mProvenanceDescList.clear();
+    ProvLogRecord& rec = mProvLog[(mProvLogHead + i) % mProvLog.size()];
+    if (rec.params.get() != NULL)
+    {
+      rec.text = rec.params->getFormattedParameterValues();
+      rec.params.reset();
+    }
   }
 }
 
@@ -161,14 +373,10 @@ void LuaProvenance::setEnabled(bool enabled)
 //-----------------------------------------------------------------------------
 void LuaProvenance::ammendLastProvLog(const string& ammend)
 {
-  if (mProvenanceDescList.size() <= 0)
+  if (mProvLogCount == 0)
     return;
 
-  string ammendedLog = mProvenanceDescList.back();
-  ammendedLog += ammend;
-
-  mProvenanceDescList.pop_back();
-  mProvenanceDescList.push_back(ammendedLog);
+  pushProvLogRecord(ProvLogRecord::AMEND).text = ammend;
 }
 
 //-----------------------------------------------------------------------------
@@ -177,12 +385,10 @@ void LuaProvenance::logHooks(int staticHooks, int memberHooks)
   if (mEnabled == false || mProvenanceDescLogEnabled == false)
     return;
 
-  int hooksCalled = staticHooks + memberHooks;
-
-  ostringstream os;
-  os << " -- " << hooksCalled << " hook(s) called";
+  if (mProvLogCount == 0)
+    return;
 
-  ammendLastProvLog(os.str());
+  pushProvLogRecord(ProvLogRecord::HOOKS).value = staticHooks + memberHooks;
 }
 
 //-----------------------------------------------------------------------------
@@ -213,25 +419,17 @@ void LuaProvenance::logExecution(const string& fname,
 
   mLoggingProvenance = true;
 
-  if (mProvenanceDescLogEnabled)
+  // Only the parameter capture is stored; the text is generated when the log
+  // is requested.
+  if (mProvenanceDescLogEnabled
+      && (mUndoRedoProvenanceDisable == false || mProvLogCount > 0))
   {
-    string provParams = funParams->getFormattedParameterValues();
-
-    ostringstream os;
-    if (mUndoRedoProvenanceDisable)
-      os << " -- Called: \"";
-
-    os << fname << "(" << provParams << ")"
-       << " - depth:" << mCommandDepth;
-    if (mUndoRedoProvenanceDisable)
-    {
-      os << "\"";
-      ammendLastProvLog(os.str());
-    }
-    else
-    {
-      mProvenanceDescList.push_back(os.str());
-    }
+    ProvLogRecord& rec = pushProvLogRecord(
+        mUndoRedoProvenanceDisable ? ProvLogRecord::CALLED
+                                   : ProvLogRecord::EXEC);
+    internFunctionName(rec, fname);
+    rec.value = mCommandDepth;
+    setProvLogParams(rec, funParams);
   }
 
   if (undoRedoStackExempt || mUndoRedoProvenanceDisable)
@@ -244,6 +442,7 @@ void LuaProvenance::logExecution(const string& fname,
   int stackDiff = static_cast<int>(mUndoRedoStack.size()) - mStackPointer;
   for (int i = 0; i < stackDiff; i++)
   {
+    mUndoRedoBytes -= mUndoRedoStack.back().memBytes;
     mUndoRedoStack.pop_back();
   }
   assert(mUndoRedoStack.size() ==
@@ -254,7 +453,7 @@ void LuaProvenance::logExecution(const string& fname,
   LuaStackRAII _a = LuaStackRAII(L, 0, 0);
   if (mScripting->getFunctionTable(fname.c_str()) == false)
     throw LuaError("Provenance unable to find function");
-  lua_getfield(L, -1, LuaScripting::TBL_MD_FUN_LAST_EXEC);
+  mScripting->pushLastExecTable(lua_gettop(L));
   int lastExecTable = lua_gettop(L);
 
   lua_checkstack(L, LUAC_MAX_NUM_PARAMS + 2); // 2 = key/value pair.
@@ -286,7 +485,10 @@ void LuaProvenance::logExecution(const string& fname,
 
   if (mCommandDepth == 0)
   {
-    mUndoRedoStack.push_back(UndoRedoItem(fname, emptyParams, funParams));
+    UndoRedoItem item(fname, emptyParams, funParams);
+    item.memBytes = estimateItemBytes(item);
+    mUndoRedoBytes += item.memBytes;
+    mUndoRedoStack.push_back(item);
     ++mStackPointer;
   }
   else
@@ -294,10 +496,15 @@ void LuaProvenance::logExecution(const string& fname,
     assert(!mUndoRedoStack.empty());
     // Push a child (child on the top of the stack -- we know there must be an
     // entry on the top of the stack because our depth is greater than 0).
-    mUndoRedoStack.back().addChildItem(
-        UndoRedoItem(fname, emptyParams, funParams));
+    UndoRedoItem child(fname, emptyParams, funParams);
+    size_t childBytes = estimateItemBytes(child);
+    mUndoRedoStack.back().addChildItem(child);
+    mUndoRedoStack.back().memBytes += childBytes;
+    mUndoRedoBytes += childBytes;
   }
 
+  enforceStackLimits();
+
   // Repopulate the lastExec table to most recently executed function parameters
   // We are overwriting the previous entries (see
   // createDefaultsAndLastExecTables in LuaScripting).
@@ -523,12 +730,14 @@ void LuaProvenance::issueRedo()
     mScripting->setNextTempClassInstRange(lowestID, highestID);
   }
 
+  mRedoing = true;
   try
   {
     performUndoRedoOp(redoItem.function, redoItem.redoParams, false);
   }
   catch (LuaProvenanceInvalidUndoOrRedo& e)
   {
+    mRedoing = false;
     throw LuaProvenanceInvalidRedo(e.what(), e.where(), e.lineno());
   }
 
@@ -551,11 +760,13 @@ void LuaProvenance::issueRedo()
         }
         catch (LuaProvenanceInvalidUndoOrRedo& e)
         {
+          mRedoing = false;
           throw LuaProvenanceInvalidRedo(e.what(), e.where(), e.lineno());
         }
       }
     }
   }
+  mRedoing = false;
 
   // Notice, we ignore any child undo/redo items. They exist solely to help
   // undo reset the program state when a composited function is undone.
@@ -563,6 +774,98 @@ void LuaProvenance::issueRedo()
   ++mStackPointer;
 }
 
+//-----------------------------------------------------------------------------
+void LuaProvenance::setMaxItems(size_t maxItems)
+{
+  mMaxItems = maxItems;
+  enforceStackLimits();
+}
+
+//-----------------------------------------------------------------------------
+void LuaProvenance::setMaxMemory(size_t maxBytes)
+{
+  mMaxBytes = maxBytes;
+  enforceStackLimits();
+}
+
+//-----------------------------------------------------------------------------
+void LuaProvenance::setJournalFile(const std::string& filename)
+{
+  mJournalFile = filename;
+}
+
+//-----------------------------------------------------------------------------
+size_t LuaProvenance::estimateItemBytes(const UndoRedoItem& item) const
+{
+  // Parameter captures measure themselves when they pull their values.
+  size_t bytes = sizeof(UndoRedoItem) + item.function.capacity();
+  if (item.undoParams.get() != NULL)
+    bytes += item.undoParams->sizeBytes();
+  if (item.redoParams.get() != NULL)
+    bytes += item.redoParams->sizeBytes();
+
+  if (item.childItems.get() != NULL)
+  {
+    for (vector<UndoRedoItem>::const_iterator it = item.childItems->begin();
+         it != item.childItems->end(); ++it)
+    {
+      bytes += estimateItemBytes(*it);
+    }
+  }
+
+  return bytes;
+}
+
+//-----------------------------------------------------------------------------
+void LuaProvenance::enforceStackLimits()
+{
+  ofstream journal;
+
+  // Only evict entries beneath the stack pointer (never the redo history),
+  // and always leave the most recent entry in place: it may be a command
+  // that is still collecting child items.
+  while (mStackPointer > 1 &&
+         (   (mMaxItems != 0 && mUndoRedoStack.size() > mMaxItems)
+          || (mMaxBytes != 0 && mUndoRedoBytes > mMaxBytes)))
+  {
+    const UndoRedoItem& item = mUndoRedoStack.front();
+
+    if (mJournalFile.empty() == false)
+    {
+      if (journal.is_open() == false)
+        journal.open(mJournalFile.c_str(), ios::out | ios::app);
+      writeJournalEntry(journal, item);
+    }
+
+    mUndoRedoBytes -= item.memBytes;
+    mUndoRedoStack.pop_front();
+    --mStackPointer;
+  }
+}
+
+//-----------------------------------------------------------------------------
+void LuaProvenance::writeJournalEntry(ofstream& journal,
+                                      const UndoRedoItem& item)
+{
+  if (journal.is_open() == false)
+    return;
+
+  // Mirror issueRedo: the function itself, then its children only when they
+  // are not re-created by the function.
+  journal << item.function << "("
+          << item.redoParams->getFormattedParameterValues() << ")\n";
+
+  if (item.alsoRedoChildren && item.childItems.get() != NULL)
+  {
+    for (vector<UndoRedoItem>::const_iterator it = item.childItems->begin();
+         it != item.childItems->end(); ++it)
+    {
+      journal << it->function << "("
+              << it->redoParams->getFormattedParameterValues() << ")\n";
+    }
+  }
+}
+
 //-----------------------------------------------------------------------------
 void LuaProvenance::performUndoRedoOp(const string& funcName,
                                       shared_ptr<LuaCFunAbstract> params,
@@ -682,7 +985,7 @@ void LuaProvenance::performUndoRedoOp(const string& funcName,
     numParams = lua_gettop(L) - paramStart;
     paramStart += 1;
 
-    lua_getfield(L, funTable, LuaScripting::TBL_MD_FUN_LAST_EXEC);
+    mScripting->pushLastExecTable(funTable);
 
     mScripting->copyParamsToTable(lua_gettop(L), paramStart, numParams);
 
@@ -709,6 +1012,17 @@ void LuaProvenance::clearProvenance()
 {
   mUndoRedoStack.clear();
   mStackPointer = 0;
+  mUndoRedoBytes = 0;
+
+  // The log outlives the undo/redo stack. Keep its text, but let go of the
+  // parameters.
+  releaseProvLogParams();
+
+  for (vector<ClearObserver>::const_iterator it = mClearObservers.begin();
+       it != mClearObservers.end(); ++it)
+  {
+    it->second();
+  }
 
   // Clear out last exec for ALL functions. This will clean up any dangling
   // shared pointers.
@@ -771,25 +1085,61 @@ vector<string> LuaProvenance::getRedoStackDesc()
 //-----------------------------------------------------------------------------
 void LuaProvenance::beginCommand()
 {
-  if (mEnabled == false)
-    return;
-
+  // The depth is tracked even when provenance is disabled. Calls made while
+  // provenance is disabled take the fast path in LuaCallback and skip
+  // begin/endCommand entirely, so provenance.enable(true) never ends the
+  // command that provenance.enable(false) began.
 	++mCommandDepth;
 }
 
 //-----------------------------------------------------------------------------
 void LuaProvenance::endCommand()
 {
-  if (mEnabled == false)
-    return;
-
 	--mCommandDepth;
 }
 
 //-----------------------------------------------------------------------------
 std::vector<std::string> LuaProvenance::getFullProvenanceDesc()
 {
-  return mProvenanceDescList;
+  vector<string> ret;
+  ret.reserve(mProvLogCount);
+
+  for (size_t i = 0; i < mProvLogCount; ++i)
+  {
+    const ProvLogRecord& rec = mProvLog[(mProvLogHead + i) % mProvLog.size()];
+
+    // Amendments whose line has been overwritten in the ring are dropped.
+    if (rec.type != ProvLogRecord::EXEC && ret.empty())
+      continue;
+
+    ostringstream os;
+    switch (rec.type)
+    {
+      case ProvLogRecord::EXEC:
+        os << getFunctionName(rec) << "(" << formatProvLogParams(rec)
+           << ")" << " - depth:" << rec.value;
+        ret.push_back(os.str());
+        break;
+
+      case ProvLogRecord::CALLED:
+        os << " -- Called: \"" << getFunctionName(rec) << "("
+           << formatProvLogParams(rec) << ")" << " - depth:" << rec.value
+           << "\"";
+        ret.back() += os.str();
+        break;
+
+      case ProvLogRecord::HOOKS:
+        os << " -- " << rec.value << " hook(s) called";
+        ret.back() += os.str();
+        break;
+
+      case ProvLogRecord::AMEND:
+        ret.back() += rec.text;
+        break;
+    }
+  }
+
+  return ret;
 }
 
 //-----------------------------------------------------------------------------
@@ -1418,6 +1768,124 @@ SUITE(LuaProvenanceTests)
 
   }
 
+  // Keeps its own undo state, like the bulk edits of the transfer function
+  // proxies: the undo and redo hooks ignore their parameters.
+  static int          ownVal = 0;
+  static vector<int>  ownUndo;
+  static vector<int>  ownRedo;
+  static bool         ownHookRecorded = false;
+
+  static void own_set(int v)
+  {
+    if (sc->isProvenanceRecording())
+    {
+      ownUndo.push_back(ownVal);
+      ownRedo.clear();
+    }
+    else if (sc->isProvenanceRedoing() && !ownRedo.empty())
+    {
+      ownUndo.push_back(ownVal);
+      ownRedo.pop_back();
+    }
+    ownVal = v;
+  }
+
+  static void own_undo(int)
+  {
+    if (sc->isProvenanceRecording()) ownHookRecorded = true;
+    ownRedo.push_back(ownVal);
+    ownVal = ownUndo.back();
+    ownUndo.pop_back();
+  }
+
+  static void own_redo(int)
+  {
+    if (sc->isProvenanceRecording()) ownHookRecorded = true;
+    ownUndo.push_back(ownVal);
+    ownVal = ownRedo.back();
+    ownRedo.pop_back();
+  }
+
+  static void own_setTwice(int a, int b)
+  {
+    {
+      ostringstream os;
+      os << "own_set(" << a << ")";
+      sc->exec(os.str());
+    }
+
+    {
+      ostringstream os;
+      os << "own_set(" << b << ")";
+      sc->exec(os.str());
+    }
+  }
+
+  static void own_clear()
+  {
+    ownUndo.clear();
+    ownRedo.clear();
+  }
+
+  TEST(ProvenanceOwnUndoState)
+  {
+    TEST_HEADER;
+
+    sc = new LuaScripting();
+
+    sc->registerFunction(&own_set, "own_set", "", true);
+    sc->setUndoFun(&own_undo, "own_set");
+    sc->setRedoFun(&own_redo, "own_set");
+    sc->registerFunction(&own_setTwice, "own_setTwice", "", true);
+    sc->setNullUndoFun("own_setTwice");
+    sc->addProvenanceClearObserver(&ownUndo, &own_clear);
+
+    CHECK_EQUAL(true, sc->isProvenanceRecording());
+    sc->exec("own_set(1)");
+    sc->exec("own_setTwice(2, 3)");
+    CHECK_EQUAL(3, ownVal);
+    CHECK_EQUAL(3, ownUndo.size());
+
+    // A single undo entry: the hooks of both nested calls run, each popping
+    // the most recent state.
+    sc->exec("provenance.undo()");
+    CHECK_EQUAL(1, ownVal);
+    CHECK_EQUAL(2, ownRedo.size());
+
+    // Redo executes own_setTwice again. Its nested calls are not recorded,
+    // but replay the undone state.
+    sc->exec("provenance.redo()");
+    CHECK_EQUAL(3, ownVal);
+    CHECK_EQUAL(3, ownUndo.size());
+    CHECK_EQUAL(0, ownRedo.size());
+
+    sc->exec("provenance.undo()");
+    CHECK_EQUAL(1, ownVal);
+    sc->exec("provenance.undo()");
+    CHECK_EQUAL(0, ownVal);
+    sc->exec("provenance.redo()");
+    CHECK_EQUAL(1, ownVal);
+    CHECK_EQUAL(false, ownHookRecorded);
+
+    sc->setTempProvDisable(true);
+    CHECK_EQUAL(false, sc->isProvenanceRecording());
+    sc->setTempProvDisable(false);
+
+    sc->exec("provenance.clear()");
+    CHECK_EQUAL(0, ownUndo.size());
+    CHECK_EQUAL(0, ownRedo.size());
+
+    sc->removeProvenanceClearObservers(&ownUndo);
+    sc->exec("own_set(4)");
+    sc->exec("provenance.clear()");
+    CHECK_EQUAL(1, ownUndo.size());
+
+    sc->enableProvenance(false);
+    CHECK_EQUAL(false, sc->isProvenanceRecording());
+
+    delete sc;
+  }
+
   TEST(ProvenanceNullUndoRedo)
   {
     TEST_HEADER;
@@ -1464,6 +1932,156 @@ SUITE(LuaProvenanceTests)
     CHECK_EQUAL(false, b1);
   }
 
+  TEST(ProvenanceStackLimits)
+  {
+    TEST_HEADER;
+
+    unique_ptr<LuaScripting> sc(new LuaScripting());
+
+    sc->registerFunction(&set_i1, "set_i1", "", true);
+    sc->registerFunction(&set_s1, "set_s1", "", true);
+
+    const char* journal = "provenanceJournalTest.lua";
+    remove(journal);
+    sc->cexec("provenance.setJournal", journal);
+    sc->exec("provenance.setMaxItems(3)");
+
+    sc->exec("set_i1(1)");
+    sc->exec("set_i1(2)");
+    sc->exec("set_s1('journal')");
+    sc->exec("set_i1(3)");
+    sc->exec("set_i1(4)");
+
+    // Only the 3 most recent entries remain.
+    sc->exec("provenance.undo()");
+    CHECK_EQUAL(3, i1);
+    sc->exec("provenance.undo()");
+    sc->exec("provenance.undo()");
+    CHECK_EQUAL("", s1.c_str());
+    sc->setExpectedExceptionFlag(true);
+    CHECK_THROW(sc->exec("provenance.undo()"), LuaProvenanceInvalidUndo);
+    sc->setExpectedExceptionFlag(false);
+
+    // The evicted entries can be replayed from the journal.
+    i1 = 0;
+    sc->cexec("provenance.enable", false);
+    sc->exec(string("dofile('") + journal + "')");
+    CHECK_EQUAL(2, i1);
+    sc->cexec("provenance.enable", true);
+    remove(journal);
+
+    // A memory limit evicts all but the most recent entry.
+    sc->cexec("provenance.setJournal", "");
+    sc->exec("provenance.setMaxItems(0)");
+    sc->exec("set_s1('a long string to make this entry large enough')");
+    sc->exec("set_s1('b')");
+    sc->exec("set_s1('c')");
+    sc->exec("provenance.setMaxMemory(1)");
+    sc->exec("provenance.undo()");
+    CHECK_EQUAL("b", s1.c_str());
+    sc->setExpectedExceptionFlag(true);
+    CHECK_THROW(sc->exec("provenance.undo()"), LuaProvenanceInvalidUndo);
+    sc->setExpectedExceptionFlag(false);
+
+    // Entries are charged for the parameters they capture.
+    LuaProvenance* prov = sc->getProvenanceSys();
+    sc->exec("provenance.setMaxMemory(0)");
+    sc->exec("provenance.clear()");
+    sc->exec("set_s1('x')");
+    size_t small = prov->getEstimatedMemory();
+    sc->exec("provenance.clear()");
+    sc->exec("set_s1(string.rep('x', 100000))");
+    CHECK(small < 1000);
+    CHECK(prov->getEstimatedMemory() > 100000);
+  }
+
+  TEST(ProvenanceLogRing)
+  {
+    TEST_HEADER;
+
+    unique_ptr<LuaScripting> sc(new LuaScripting());
+
+    sc->registerFunction(&set_i1, "set_i1", "", true);
+    sc->registerFunction(&set_s1, "set_s1", "", true);
+
+    sc->cexec("provenance.enableProvLog", true);
+    sc->exec("provenance.setProvLogSize(4)");
+
+    sc->exec("set_i1(1)");
+    sc->exec("set_s1('log')");
+    sc->exec("set_i1(2)");
+    sc->exec("set_i1(3)");
+    sc->exec("provenance.undo()");
+
+    const char* logFile = "provenanceLogTest.txt";
+    sc->cexec("provenance.logProvRecord_toFile", logFile);
+
+    vector<string> lines;
+    ifstream f(logFile);
+    string line;
+    getline(f, line); // Header
+    while (getline(f, line))
+      lines.push_back(line);
+    f.close();
+    remove(logFile);
+
+    // Only the last 4 records are kept. The call to set_i1 issued by the undo
+    // amends the line of provenance.undo.
+    CHECK_EQUAL(3, lines.size());
+    if (lines.size() == 3)
+    {
+      CHECK_EQUAL("set_i1(3) - depth:0", lines[0].c_str());
+      CHECK_EQUAL("provenance.undo() - depth:0 -- Called: \"set_i1(2) "
+                  "- depth:1\"", lines[1].c_str());
+      CHECK_EQUAL("provenance.logProvRecord_toFile('provenanceLogTest.txt') "
+                  "- depth:0", lines[2].c_str());
+    }
+  }
+
+  TEST(ProvenanceLogCompact)
+  {
+    TEST_HEADER;
+
+    unique_ptr<LuaScripting> sc(new LuaScripting());
+    LuaProvenance* prov = sc->getProvenanceSys();
+
+    sc->registerFunction(&set_s1, "set_s1", "", true);
+    sc->cexec("provenance.enableProvLog", true);
+    sc->exec("provenance.setProvLogSize(4)");
+
+    // Instance IDs are kept out of the interned name.
+    prov->logExecution("_sys_.inst.m12.set", true,
+                       shared_ptr<LuaCFunAbstract>(),
+                       shared_ptr<LuaCFunAbstract>());
+    prov->logExecution("_sys_.inst.m7.set", true,
+                       shared_ptr<LuaCFunAbstract>(),
+                       shared_ptr<LuaCFunAbstract>());
+
+    // Large parameters are formatted and truncated up front.
+    sc->exec("set_s1(string.rep('x', 100000))");
+
+    const char* logFile = "provenanceLogCompactTest.txt";
+    sc->cexec("provenance.logProvRecord_toFile", logFile);
+
+    vector<string> lines;
+    ifstream f(logFile);
+    string line;
+    getline(f, line); // Header
+    while (getline(f, line))
+      lines.push_back(line);
+    f.close();
+    remove(logFile);
+
+    CHECK_EQUAL(4, lines.size());
+    if (lines.size() == 4)
+    {
+      CHECK_EQUAL("_sys_.inst.m12.set() - depth:0", lines[0].c_str());
+      CHECK_EQUAL("_sys_.inst.m7.set() - depth:0", lines[1].c_str());
+      CHECK(lines[2].size() < 2000);
+      CHECK_EQUAL(0, lines[2].find("set_s1('xxx"));
+    }
+  }
+
   TEST(ProvenanceDisabling)
   {
     TEST_HEADER;
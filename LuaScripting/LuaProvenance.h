@@ -36,15 +36,16 @@
 
 #include "LuaMemberRegUnsafe.h"
 #include <algorithm>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <unordered_map>
 
 namespace tuvok
 {
 
 class LuaScripting;
 
-// TODO: Implement MAX size for undo / redo buffer. Think circular buffer, or
-//       just std::vector::erase for simplicity.
-
 class LuaProvenance
 {
 public:
@@ -55,9 +56,28 @@ public:
   bool isEnabled() const;
   void setEnabled(bool enabled);
 
+  /// True if a provenance enabled command executed now would be placed on
+  /// the undo/redo stack (false while undoing or redoing).
+  bool isRecording() const;
+
+  /// True while a redo executes the recorded command again.
+  bool isRedoing() const    {return mRedoing;}
+
+  /// Observers are called whenever the undo/redo stack is cleared, so that
+  /// functions keeping their own undo state can drop it.
+  ///@{
+  void addClearObserver(const void* owner, std::function<void ()> observer);
+  void removeClearObservers(const void* owner);
+  ///@}
+
   /// Enable/Disable provenance logs of all commands.
   void enableLogAll(bool enabled);
 
+  /// Sets the number of records kept in the provenance log ring. Once full,
+  /// the oldest records are overwritten. Clears the log. The ring is only
+  /// allocated while the log is enabled.
+  void setProvLogSize(size_t records);
+
   /// Logs the execution of a function.
   /// \param  function            Name of the function that executed.
   /// \param  undoRedoStackExempt True if no entry should be genereated inside
@@ -79,6 +99,27 @@ public:
   /// Performs a redo.
   void issueRedo();
 
+  /// Limits the undo/redo stack. When either limit is exceeded, the oldest
+  /// entries are evicted from the bottom of the stack (and written to the
+  /// journal, if one is set). The entry on the top of the stack is never
+  /// evicted. A limit of 0 means unlimited.
+  ///@{
+  void setMaxItems(size_t maxItems);
+  void setMaxMemory(size_t maxBytes);
+  ///@}
+
+  /// Sets the append-only journal evicted undo/redo entries are written to.
+  /// Each entry is written as the Lua statement that redoes it, so the
+  /// evicted history can be replayed with dofile. An empty filename
+  /// disables the journal (evicted entries are discarded).
+  /// The journal is bound to the session that wrote it: calls on class
+  /// instances are recorded through the instance's _sys_.inst path, which
+  /// names a different instance (or none) in any other session.
+  void setJournalFile(const std::string& filename);
+
+  /// Estimated number of bytes held by the undo/redo stack.
+  size_t getEstimatedMemory() const   {return mUndoRedoBytes;}
+
   /// Registers provenance functions with Lua.
   /// These functions are NEVER deregistered and persist for the lifetime
   /// of the associated LuaScripting system.
@@ -158,7 +199,7 @@ private:
                  std::shared_ptr<LuaCFunAbstract> undo,
                  std::shared_ptr<LuaCFunAbstract> redo)
     : function(funName), undoParams(undo), redoParams(redo), childItems()
-    , instCreations(), instDeletions(), alsoRedoChildren(false)
+    , instCreations(), instDeletions(), alsoRedoChildren(false), memBytes(0)
     {}
 
     /// Function name we operate on at this stack index.
@@ -235,9 +276,24 @@ private:
     /// item must be explicitly called by the redo mechanism. This is only
     /// used to group command together.
     bool alsoRedoChildren;
+
+    /// Estimated memory held by this item and its children. Only maintained
+    /// for items on the undo/redo stack itself.
+    size_t memBytes;
   };
 
-  typedef std::vector<UndoRedoItem> URStackType;
+  /// A deque, so that evicting from the bottom of the stack is cheap.
+  typedef std::deque<UndoRedoItem> URStackType;
+
+  /// Estimates the memory held by item (including its children).
+  size_t estimateItemBytes(const UndoRedoItem& item) const;
+
+  /// Evicts items from the bottom of the undo/redo stack until both
+  /// mMaxItems and mMaxBytes are satisfied.
+  void enforceStackLimits();
+
+  /// Appends the Lua statements that redo item to the journal.
+  void writeJournalEntry(std::ofstream& journal, const UndoRedoItem& item);
 
   // Calls the function at UndoRedoItem index: funcIndex using the params
   // specified by funcToUse.
@@ -264,13 +320,82 @@ private:
   int                       mStackPointer;  ///< 1 based Index into
                                             ///< mUndoRedoStack.
 
-  /// Provenance description list. Text description of all functions executed to
-  /// this point (including undo/redo exempt functions).
-  std::vector<std::string>  mProvenanceDescList;
+  size_t                    mMaxItems;      ///< 0 = unlimited.
+  size_t                    mMaxBytes;      ///< 0 = unlimited.
+  size_t                    mUndoRedoBytes; ///< Estimated stack memory.
+  std::string               mJournalFile;   ///< Evicted entries go here.
+
+  /// Record in the provenance log. Text is only generated when the log is
+  /// requested (getFullProvenanceDesc). A line in the log starts with an
+  /// EXEC record; every other record type amends the line before it.
+  struct ProvLogRecord
+  {
+    enum Type
+    {
+      EXEC,       ///< Function call: 'fun(params) - depth:N'
+      CALLED,     ///< Call issued by undo/redo: ' -- Called: "..."'
+      HOOKS,      ///< ' -- N hook(s) called'
+      AMEND       ///< Free text amendment (failures and the like).
+    };
+
+    Type        type;
+    int         funID;  ///< Index into mProvLogFunNames (EXEC, CALLED).
+    int         instID; ///< Class instance of the function, -1 if none.
+    int         value;  ///< Command depth (EXEC, CALLED) or hook count.
+
+    /// Parameter capture of the call. Formatted lazily. Only small captures
+    /// are shared, large ones are formatted (and truncated) right away so
+    /// the log doesn't keep them alive (see setProvLogParams).
+    std::shared_ptr<LuaCFunAbstract> params;
+
+    /// AMEND text, or the formatted parameters once params has been released
+    /// (see releaseProvLogParams).
+    std::string text;
+  };
+
+  /// Appends a record to the provenance log ring, overwriting the oldest
+  /// record when the ring is full. Returns the record to fill in.
+  ProvLogRecord& pushProvLogRecord(ProvLogRecord::Type type);
+
+  /// Interns the function name of an EXEC or CALLED record. Functions of
+  /// class instances are interned without their instance ID, which is stored
+  /// in the record instead.
+  void internFunctionName(ProvLogRecord& rec, const std::string& fname);
+
+  /// Returns the full function name of an EXEC or CALLED record.
+  std::string getFunctionName(const ProvLogRecord& rec) const;
+
+  /// Stores the parameter capture of an EXEC or CALLED record.
+  void setProvLogParams(ProvLogRecord& rec,
+                        std::shared_ptr<LuaCFunAbstract> params);
+
+  /// Formats the parameters of an EXEC or CALLED record.
+  std::string formatProvLogParams(const ProvLogRecord& rec) const;
+
+  /// Formats parameters that are still held by log records and releases the
+  /// shared_ptrs, so the log doesn't keep objects alive.
+  void releaseProvLogParams();
+
+  void clearProvLog();
+
+  /// Provenance log. Structured record of all functions executed to this
+  /// point (including undo/redo exempt functions), kept in a fixed size ring.
+  std::vector<ProvLogRecord>  mProvLog;
+  size_t                      mProvLogSize;   ///< Ring size once allocated.
+  size_t                      mProvLogHead;   ///< Index of the oldest record.
+  size_t                      mProvLogCount;  ///< Number of valid records.
+
+  /// Interned function names referenced by ProvLogRecord::funID. Dropped
+  /// along with the records in clearProvLog.
+  std::vector<std::string>              mProvLogFunNames;
+  std::unordered_map<std::string, int>  mProvLogFunIDs;
 
   LuaScripting* const       mScripting;
   LuaMemberRegUnsafe        mMemberReg;     ///< Used for member registration.
 
+  typedef std::pair<const void*, std::function<void ()> > ClearObserver;
+  std::vector<ClearObserver> mClearObservers;
+
 
   /// This flag is only used when issuing an undo or redo. This is to ensure
   /// we don't get called when we are logging provenance.
@@ -282,6 +407,9 @@ private:
   /// call.
   bool                      mUndoRedoProvenanceDisable;
 
+  /// Set while issueRedo replays an entry.
+  bool                      mRedoing;
+
   /// Current command depth. Only the first command is placed in provenance
   /// and the undo/redo buffer. The calls deeper than the first command are
   /// still logged into the provenance logging system for debugging purposes.
@@ -40,6 +40,7 @@
 
 #include "StdTuvokDefines.h"
 #include <sstream>
+#include <chrono>
 #include <cstring>
 #include <functional>
 #include <iostream>
@@ -61,11 +62,20 @@
 
 #include "LuaScripting.h"
 #include "LuaProvenance.h"
+#include "LuaProfiler.h"
+#include "LuaDebug.h"
+#include "LuaAllocator.h"
+#include "LuaTypedArray.h"
+#include "LuaFunctionHandle.h"
 
 using namespace std;
 
 #define QUALIFIED_NAME_DELIMITER  "."
 
+// Large enough to hold the statements of a scripted camera path, which are
+// re-issued every frame.
+#define DEFAULT_EXEC_CACHE_CAPACITY 1024
+
 // Disable "'this' used in base member initializer list warning"
 // this is not referenced in either of the initialized classes,
 // but is merely stored.
@@ -96,6 +106,11 @@ const char* LuaScripting::TBL_MD_REDO_FUNC      = "redoHook";
 const char* LuaScripting::TBL_MD_NULL_UNDO      = "nullUndo";
 const char* LuaScripting::TBL_MD_NULL_REDO      = "nullRedo";
 const char* LuaScripting::TBL_MD_PARAM_DESC     = "tblParamDesc";
+const char* LuaScripting::TBL_MD_MEMBER_INST    = "memberInst";
+const char* LuaScripting::TBL_MD_PROTO_PDEFS    = "tblProtoDefaults";
+const char* LuaScripting::TBL_MD_HAS_HOOKS      = "hasHooks";
+
+const size_t LuaScripting::NO_FUNCTION_REF = static_cast<size_t>(-1);
 
 const char* LuaScripting::PARAM_DESC_NAME_SUFFIX = "n";
 const char* LuaScripting::PARAM_DESC_INFO_SUFFIX = "i";
@@ -113,23 +128,39 @@ const char* LuaScripting::TBL_MD_TYPES_TABLE    = "typesTable";
 
 //-----------------------------------------------------------------------------
 LuaScripting::LuaScripting()
-: mMemberHookIndex(0)
+: mAllocator(new LuaAllocator())
+, mMemberHookIndex(0)
+, mNumHooks(0)
 , mGlobalInstanceID(0)
 , mGlobalTempInstRange(false)
 , mGlobalTempInstLow(0)
 , mGlobalTempInstHigh(0)
 , mGlobalTempCurrent(0)
 , mProvenance(new LuaProvenance(this))
+, mProfiler(new LuaProfiler(this))
+, mProfiling(false)
+, mDebug(new LuaDebug(this))
 , mMemberReg(new LuaMemberRegUnsafe(this))
 , mClassCons(new LuaClassConstructor(this))
 , mVerboseMode(false)
+, mExecCacheCapacity(DEFAULT_EXEC_CACHE_CAPACITY)
+, mExecCacheHits(0)
+, mExecCacheMisses(0)
+, mGCCycles(0)
+, mGCCycleTime(0.0)
+, mGCCycleBytes(0)
+, mGCFreedAtCycle(0)
+, mGCInStep(false)
+, mGCCyclePending(false)
+, mClosing(false)
 {
-  mL = lua_newstate(luaInternalAlloc, NULL);
+  mL = lua_newstate(luaInternalAlloc, mAllocator.get());
 
   if (mL == NULL) throw LuaError("Failed to initialize Lua.");
 
   lua_atpanic(mL, &luaPanic);
   luaL_openlibs(mL);
+  createGCSentinel();
 
   LuaStackRAII _a(mL, 0, 0);
 
@@ -140,11 +171,16 @@ LuaScripting::LuaScripting()
   lua_newtable(mL);
   lua_setglobal(mL, LuaClassInstance::SYSTEM_TABLE);
 
+  lua_newtable(mL);
+  lua_setfield(mL, LUA_REGISTRYINDEX, LuaClassInstance::INSTANCE_SLOT_TABLE);
+
   setExpectedExceptionFlag(false);
 
   registerScriptFunctions();
 
   mProvenance->registerLuaProvenanceFunctions();
+  mProfiler->registerLuaProfilerFunctions();
+  mDebug->registerLuaDebugFunctions();
 
   // Generate class lookup table.
   {
@@ -159,6 +195,8 @@ LuaScripting::~LuaScripting()
 {
   removeAllRegistrations();
 
+  // lua_close runs the finalizer of the GC sentinel.
+  mClosing = true;
   lua_close(mL);
 }
 
@@ -199,6 +237,97 @@ void LuaScripting::removeAllRegistrations()
   deleteAllClassInstances();
   cleanupClassConstructors();
   unregisterAllFunctions();
+  invalidateFunctionHandles();
+}
+
+//-----------------------------------------------------------------------------
+LuaFunctionHandle LuaScripting::resolve(const std::string& fqName)
+{
+  return LuaFunctionHandle(this, fqName);
+}
+
+//-----------------------------------------------------------------------------
+size_t LuaScripting::getFunctionRef(const std::string& fqName)
+{
+  LuaStackRAII _a = LuaStackRAII(mL, 0, 0);
+
+  map<string, size_t>::const_iterator it = mFunctionRefs.find(fqName);
+  if (it != mFunctionRefs.end())
+    return it->second;
+
+  if (getFunctionTable(fqName) == false)
+    return NO_FUNCTION_REF;
+
+  if (isRegisteredFunction(lua_gettop(mL)) == false)
+  {
+    lua_pop(mL, 1);
+    return NO_FUNCTION_REF;
+  }
+
+  size_t slot;
+  if (mFreeFunctionRefSlots.empty())
+  {
+    slot = mFunctionRefSlots.size();
+    FunctionRef unused = {LUA_NOREF, 0};
+    mFunctionRefSlots.push_back(unused);
+  }
+  else
+  {
+    slot = mFreeFunctionRefSlots.back();
+    mFreeFunctionRefSlots.pop_back();
+  }
+
+  // Pops the function table.
+  mFunctionRefSlots[slot].ref = luaL_ref(mL, LUA_REGISTRYINDEX);
+  mFunctionRefs.insert(make_pair(fqName, slot));
+  return slot;
+}
+
+//-----------------------------------------------------------------------------
+void LuaScripting::releaseFunctionRef(size_t slot)
+{
+  luaL_unref(mL, LUA_REGISTRYINDEX, mFunctionRefSlots[slot].ref);
+  mFunctionRefSlots[slot].ref = LUA_NOREF;
+  ++mFunctionRefSlots[slot].generation;
+  mFreeFunctionRefSlots.push_back(slot);
+}
+
+//-----------------------------------------------------------------------------
+void LuaScripting::invalidateFunctionHandles(const std::string& fqName)
+{
+  // Names below fqName sort directly after it.
+  map<string, size_t>::iterator it = mFunctionRefs.lower_bound(fqName);
+  while (it != mFunctionRefs.end()
+         && it->first.compare(0, fqName.size(), fqName) == 0)
+  {
+    if (it->first.size() == fqName.size()
+        || it->first[fqName.size()] == QUALIFIED_NAME_DELIMITER[0])
+    {
+      releaseFunctionRef(it->second);
+      mFunctionRefs.erase(it++);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+
+  if (mProfiler)
+    mProfiler->forgetFunctions(fqName);
+}
+
+//-----------------------------------------------------------------------------
+void LuaScripting::invalidateFunctionHandles()
+{
+  for (map<string, size_t>::const_iterator it = mFunctionRefs.begin();
+       it != mFunctionRefs.end(); ++it)
+  {
+    releaseFunctionRef(it->second);
+  }
+  mFunctionRefs.clear();
+
+  if (mProfiler)
+    mProfiler->forgetAllFunctions();
 }
 
 #ifdef DETECTED_OS_WINDOWS
@@ -256,19 +385,10 @@ int LuaScripting::luaPanic(lua_State* L)
 #endif
 
 //-----------------------------------------------------------------------------
-void* LuaScripting::luaInternalAlloc(void* /*ud*/, void* ptr, size_t /*osize*/,
+void* LuaScripting::luaInternalAlloc(void* ud, void* ptr, size_t osize,
                                      size_t nsize)
 {
-  // TODO: Convert to use new (mind the realloc).
-  if (nsize == 0)
-  {
-    free(ptr);
-    return NULL;
-  }
-  else
-  {
-    return realloc(ptr, nsize);
-  }
+  return LuaAllocator::luaAlloc(ud, ptr, osize, nsize);
 }
 
 //-----------------------------------------------------------------------------
@@ -365,6 +485,50 @@ void LuaScripting::registerScriptFunctions()
                                false);
   setProvenanceExempt("helpAllFunctions");
 
+  LuaAllocator* alloc = mAllocator.get();
+  mMemberReg->registerFunction(alloc, &LuaAllocator::getLiveBytes,
+                               "memory.liveBytes",
+                               "Bytes currently allocated by Lua.",
+                               false);
+  setProvenanceExempt("memory.liveBytes");
+  mMemberReg->registerFunction(alloc, &LuaAllocator::getPeakBytes,
+                               "memory.peakBytes",
+                               "Highest number of bytes allocated by Lua.",
+                               false);
+  setProvenanceExempt("memory.peakBytes");
+  mMemberReg->registerFunction(alloc, &LuaAllocator::getReservedBytes,
+                               "memory.reservedBytes",
+                               "Bytes obtained from the system for Lua.",
+                               false);
+  setProvenanceExempt("memory.reservedBytes");
+  mMemberReg->registerFunction(alloc, &LuaAllocator::getSizeClassStats,
+                               "memory.sizeClasses",
+                               "Returns {blockSize, liveBlocks, allocations, "
+                               "reservedBytes} for each size class of the "
+                               "allocator. Block size 0 stands for blocks "
+                               "too large to be pooled.",
+                               false);
+  setProvenanceExempt("memory.sizeClasses");
+  mMemberReg->registerFunction(alloc, &LuaAllocator::setLimit,
+                               "memory.setLimit",
+                               "Limits the bytes Lua may allocate; scripts "
+                               "exceeding it fail with 'not enough memory'. "
+                               "0 removes the limit (def: 0).",
+                               false);
+  setProvenanceExempt("memory.setLimit");
+  mMemberReg->registerFunction(alloc, &LuaAllocator::getLimit,
+                               "memory.getLimit",
+                               "Returns the limit set with memory.setLimit.",
+                               false);
+  setProvenanceExempt("memory.getLimit");
+
+  registerFunction(&LuaTypedArray::luaNew, "typedArray.new",
+                   "Creates a zero-filled typed array. The element type is "
+                   "'float', 'double', 'uint8', 'uint16' or 'uint32'; the "
+                   "shape is a table of dimensions, fastest last.",
+                   false);
+  setProvenanceExempt("typedArray.new");
+
   registerFunction(&nopFun, SYSTEM_NOP_COMMAND, "No-op "
       "function that helps to logically group commands in the provenance "
       "system.", true);
@@ -468,6 +632,27 @@ string LuaScripting::getClassHelp(int tableIndex)
   ostringstream ret;
   vector<LuaScripting::FunctionDesc> funcDescs;
 
+  // Methods that are bound on first access have to be looked up once so that
+  // they show up in the listing.
+  if (lua_getmetatable(mL, tableIndex))
+  {
+    lua_getfield(mL, -1, LuaClassInstance::MD_LAZY_METHODS);
+    if (lua_istable(mL, -1))
+    {
+      lua_pushnil(mL);
+      while (lua_next(mL, -2))
+      {
+        lua_pop(mL, 1);
+        if (lua_type(mL, -1) == LUA_TSTRING)
+        {
+          lua_getfield(mL, tableIndex, lua_tostring(mL, -1));
+          lua_pop(mL, 1);
+        }
+      }
+    }
+    lua_pop(mL, 2);
+  }
+
   lua_pushvalue(mL, tableIndex);
   getTableFuncDefs(funcDescs);
   lua_pop(mL, 1);
@@ -782,6 +967,31 @@ bool LuaScripting::isProvenanceEnabled() const
   return mProvenance->isEnabled();
 }
 
+//-----------------------------------------------------------------------------
+bool LuaScripting::isProvenanceRecording() const
+{
+  return mProvenance->isRecording();
+}
+
+//-----------------------------------------------------------------------------
+bool LuaScripting::isProvenanceRedoing() const
+{
+  return mProvenance->isRedoing();
+}
+
+//-----------------------------------------------------------------------------
+void LuaScripting::addProvenanceClearObserver(const void* owner,
+                                              std::function<void ()> observer)
+{
+  mProvenance->addClearObserver(owner, observer);
+}
+
+//-----------------------------------------------------------------------------
+void LuaScripting::removeProvenanceClearObservers(const void* owner)
+{
+  mProvenance->removeClearObservers(owner);
+}
+
 //-----------------------------------------------------------------------------
 void LuaScripting::enableProvenance(bool enable)
 {
@@ -822,6 +1032,8 @@ void LuaScripting::deleteAllClassInstances()
   // on all of the key values.
   LuaStackRAII _a(mL, 0, 0);
 
+  releaseAllInstanceSlots();
+
   lua_getglobal(mL, LuaClassInstance::SYSTEM_TABLE);
   if (lua_isnil(mL, -1) == 1)
   {
@@ -887,6 +1099,12 @@ void LuaScripting::destroyClassInstanceTable(int tableIndex)
     throw LuaError("Unable to obtain function metatable.");
   int mt = lua_gettop(mL);
 
+  // Handles to the instance's member functions must not outlive it.
+  lua_getfield(mL, mt, LuaClassInstance::MD_GLOBAL_INSTANCE_ID);
+  LuaClassInstance inst(static_cast<int>(lua_tointeger(mL, -1)));
+  lua_pop(mL, 1);
+  invalidateFunctionHandles(inst.fqName());
+
   // Pull the delete function from the table.
   lua_getfield(mL, mt, LuaClassInstance::MD_DEL_FUN);
   LuaClassConstructor::DelFunSig fun = reinterpret_cast<
@@ -967,12 +1185,11 @@ void LuaScripting::notifyOfDeletion(LuaClassInstance inst)
   try
   {
     // Don't even attempt anything if we did not find the function table.
-    if (getFunctionTable(inst.fqName()) == false)
+    if (inst.isValid(this) == false)
     {
       setExpectedExceptionFlag(false);
       return;
     }
-    lua_pop(mL, 1); // Pop the function table.
 
     // Ensure the delete call does not attempt to delete the object.
     // (since this function is called from the destructor, delete has already
@@ -1069,9 +1286,9 @@ void LuaScripting::clearLastExecFromTable()
     // Only output function info its registered to us.
     if (isOurRegisteredFunction(-1))
     {
+      // Recreated from the defaults on next use (see pushLastExecTable).
       lua_pushnil(mL);
       lua_setfield(mL, tablePos, TBL_MD_FUN_LAST_EXEC);
-      copyDefaultsTableToLastExec(tablePos);
     }
 
     // This was a function, not a table.
@@ -1168,7 +1385,7 @@ void LuaScripting::getTableFuncDefs(vector<LuaScripting::FunctionDesc>& descs)
   if (lua_getmetatable(mL, tablePos))
   {
     lua_getfield(mL, -1, "__index");
-    if (lua_isnil(mL, -1) == false)
+    if (lua_istable(mL, -1))
     {
       // Recurse into the table.
       lua_checkstack(mL, 4);
@@ -1491,6 +1708,14 @@ void LuaScripting::bindClosureTableWithFQName(const string& fqName,
         throw LuaFunBindError("Can't register functions on top of other "
                               "functions.");
       }
+
+      // Tables we did not create (e.g. the standard debug library) must be
+      // tracked as well, or help and unregisterAllFunctions miss the
+      // functions registered into them.
+      if (token.compare(LuaClassInstance::SYSTEM_TABLE) != 0
+          && find(mRegisteredGlobals.begin(), mRegisteredGlobals.end(),
+                  token) == mRegisteredGlobals.end())
+        mRegisteredGlobals.push_back(token);
     }
     else
     {
@@ -1677,6 +1902,17 @@ void LuaScripting::populateWithMetadata(const std::string& name,
                                         const std::string& sigWithName,
                                         const std::string& sigNoReturn,
                                         int tableIndex)
+{
+  populateWithSharedMetadata(desc, sig, sigWithName, sigNoReturn, tableIndex);
+  populateWithInstanceMetadata(name, tableIndex);
+}
+
+//-----------------------------------------------------------------------------
+void LuaScripting::populateWithSharedMetadata(const std::string& desc,
+                                              const std::string& sig,
+                                              const std::string& sigWithName,
+                                              const std::string& sigNoReturn,
+                                              int tableIndex)
 {
   LuaStackRAII _a = LuaStackRAII(mL, 0, 0);
 
@@ -1702,17 +1938,6 @@ void LuaScripting::populateWithMetadata(const std::string& name,
   lua_pushnumber(mL, 0);
   lua_setfield(mL, tableIndex, TBL_MD_NUM_EXEC);
 
-  // Fully qualified function name.
-  lua_pushstring(mL, name.c_str());
-  lua_setfield(mL, tableIndex, TBL_MD_QNAME);
-
-  // Build empty hook tables.
-  lua_newtable(mL);
-  lua_setfield(mL, tableIndex, TBL_MD_HOOKS);
-
-  lua_newtable(mL);
-  lua_setfield(mL, tableIndex, TBL_MD_MEMBER_HOOKS);
-
   lua_pushinteger(mL, 0);
   lua_setfield(mL, tableIndex, TBL_MD_HOOK_INDEX);
 
@@ -1729,6 +1954,19 @@ void LuaScripting::populateWithMetadata(const std::string& name,
   lua_setfield(mL, tableIndex, TBL_MD_CPP_CLASS);
 }
 
+//-----------------------------------------------------------------------------
+void LuaScripting::populateWithInstanceMetadata(const std::string& name,
+                                                int tableIndex)
+{
+  LuaStackRAII _a = LuaStackRAII(mL, 0, 0);
+
+  // Fully qualified function name.
+  // The hook tables are created when the first hook is registered (see
+  // pushHookTable).
+  lua_pushstring(mL, name.c_str());
+  lua_setfield(mL, tableIndex, TBL_MD_QNAME);
+}
+
 //-----------------------------------------------------------------------------
 void LuaScripting::createDefaultsAndLastExecTables(int tableIndex,
                                                    int numFunParams)
@@ -1858,6 +2096,9 @@ bool LuaScripting::getFunctionTable(const std::string& fqName)
 //-----------------------------------------------------------------------------
 void LuaScripting::unregisterFunction(const std::string& fqName)
 {
+  // Handles may reference the function we are about to remove.
+  invalidateFunctionHandles(fqName);
+
   // Lookup the function table based on the fully qualified name.
   int baseStackIndex = lua_gettop(mL);
 
@@ -1966,6 +2207,7 @@ void LuaScripting::unregisterFunction(const std::string& fqName)
 void LuaScripting::doHooks(lua_State* L, int tableIndex, bool provExempt)
 {
   int stackTop = lua_gettop(L);
+  ProfileScope _p(this, L, tableIndex, ProfileScope::HOOKS);
   int numArgs = stackTop - tableIndex;
 
   lua_checkstack(L, numArgs + 3);
@@ -1978,21 +2220,24 @@ void LuaScripting::doHooks(lua_State* L, int tableIndex, bool provExempt)
 
   try
   {
-    lua_pushnil(L);
-    while (lua_next(L, hookTable))
+    if (lua_istable(L, hookTable))
     {
-      // The value at the top of the stack is the lua closure to call.
-      // This call will automatically pop the function off the stack,
-      // so we don't need a pop at the end of the loop
-
-      // Push all of the arguments.
-      for (int i = 0; i < numArgs; i++)
+      lua_pushnil(L);
+      while (lua_next(L, hookTable))
       {
-        lua_pushvalue(L, tableIndex + i + 1);
-      }
-      lua_pcall(L, numArgs, 0, 0);
+        // The value at the top of the stack is the lua closure to call.
+        // This call will automatically pop the function off the stack,
+        // so we don't need a pop at the end of the loop
+
+        // Push all of the arguments.
+        for (int i = 0; i < numArgs; i++)
+        {
+          lua_pushvalue(L, tableIndex + i + 1);
+        }
+        lua_pcall(L, numArgs, 0, 0);
 
-      ++numStaticHooks;
+        ++numStaticHooks;
+      }
     }
     lua_pop(L, 1);  // Remove the hooks table.
   }
@@ -2025,17 +2270,20 @@ void LuaScripting::doHooks(lua_State* L, int tableIndex, bool provExempt)
 
   try
   {
-    lua_pushnil(L);
-    while (lua_next(L, hookTable))
+    if (lua_istable(L, hookTable))
     {
-      // Push all of the arguments.
-      for (int i = 0; i < numArgs; i++)
+      lua_pushnil(L);
+      while (lua_next(L, hookTable))
       {
-        lua_pushvalue(L, tableIndex + i + 1);
-      }
-      lua_pcall(L, numArgs, 0, 0);
+        // Push all of the arguments.
+        for (int i = 0; i < numArgs; i++)
+        {
+          lua_pushvalue(L, tableIndex + i + 1);
+        }
+        lua_pcall(L, numArgs, 0, 0);
 
-      ++numMemberHooks;
+        ++numMemberHooks;
+      }
     }
     lua_pop(L, 1);  // Remove the member hooks table.
   }
@@ -2061,6 +2309,98 @@ void LuaScripting::doHooks(lua_State* L, int tableIndex, bool provExempt)
   assert(stackTop == lua_gettop(L));
 }
 
+//-----------------------------------------------------------------------------
+void LuaScripting::pushHookTable(int tableIndex, const char* hookTable)
+{
+  int funTable = lua_absindex(mL, tableIndex);
+
+  lua_getfield(mL, funTable, hookTable);
+  if (lua_isnil(mL, -1))
+  {
+    lua_pop(mL, 1);
+    lua_newtable(mL);
+    lua_pushvalue(mL, -1);
+    lua_setfield(mL, funTable, hookTable);
+  }
+}
+
+//-----------------------------------------------------------------------------
+bool LuaScripting::hasHooks(lua_State* L, int tableIndex)
+{
+  LuaStackRAII _a = LuaStackRAII(L, 0, 0);
+
+  // Hook tables are only present once a hook has been registered.
+  lua_getfield(L, tableIndex, TBL_MD_HOOKS);
+  if (lua_istable(L, -1))
+  {
+    lua_pushnil(L);
+    if (lua_next(L, -2))
+    {
+      lua_pop(L, 3);  // Key, value, and the hooks table.
+      return true;
+    }
+  }
+  lua_pop(L, 1);
+
+  lua_getfield(L, tableIndex, TBL_MD_MEMBER_HOOKS);
+  if (lua_istable(L, -1))
+  {
+    lua_pushnil(L);
+    if (lua_next(L, -2))
+    {
+      lua_pop(L, 3);
+      return true;
+    }
+  }
+  lua_pop(L, 1);
+
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+void LuaScripting::profileEnter(lua_State* L, int tableIndex, bool hooks)
+{
+  mProfiler->enter(L, tableIndex, hooks);
+}
+
+//-----------------------------------------------------------------------------
+void LuaScripting::profileLeave()
+{
+  mProfiler->leave();
+}
+
+//-----------------------------------------------------------------------------
+bool LuaScripting::isFastCallEligible(lua_State* L, int tableIndex)
+{
+  if (mProvenance->isEnabled())
+    return false;
+
+  if (mNumHooks == 0)
+    return true;
+
+  lua_getfield(L, tableIndex, TBL_MD_HAS_HOOKS);
+  bool hooked = (lua_toboolean(L, -1) != 0);
+  lua_pop(L, 1);
+  return hooked == false;
+}
+
+//-----------------------------------------------------------------------------
+void LuaScripting::hookAdded(int funcTable)
+{
+  ++mNumHooks;
+  lua_pushboolean(mL, 1);
+  lua_setfield(mL, funcTable, TBL_MD_HAS_HOOKS);
+}
+
+//-----------------------------------------------------------------------------
+void LuaScripting::hookRemoved(int funcTable)
+{
+  if (mNumHooks > 0)
+    --mNumHooks;
+  lua_pushboolean(mL, hasHooks(mL, funcTable) ? 1 : 0);
+  lua_setfield(mL, funcTable, TBL_MD_HAS_HOOKS);
+}
+
 //-----------------------------------------------------------------------------
 std::string LuaScripting::getNewMemberHookID()
 {
@@ -2196,6 +2536,20 @@ void LuaScripting::copyDefaultsTableToLastExec(int funTableIndex)
   lua_pop(mL, 2);   // Pop the last-exec and the default tables.
 }
 
+//-----------------------------------------------------------------------------
+void LuaScripting::pushLastExecTable(int funTableIndex)
+{
+  int funTable = lua_absindex(mL, funTableIndex);
+
+  lua_getfield(mL, funTable, TBL_MD_FUN_LAST_EXEC);
+  if (lua_isnil(mL, -1))
+  {
+    lua_pop(mL, 1);
+    copyDefaultsTableToLastExec(funTable);
+    lua_getfield(mL, funTable, TBL_MD_FUN_LAST_EXEC);
+  }
+}
+
 //-----------------------------------------------------------------------------
 void LuaScripting::prepForExecution(const std::string& fqName)
 {
@@ -2234,87 +2588,330 @@ void LuaScripting::executeFunctionOnStack(int nparams, int nret)
 void LuaScripting::exec(const std::string& cmd)
 {
   LuaStackRAII _a = LuaStackRAII(mL, 0, 0);
-  luaL_loadstring(mL, cmd.c_str());
+  pushCompiledChunk(cmd);
   lua_call(mL, 0, 0);
 }
 
 //-----------------------------------------------------------------------------
-void LuaScripting::cexec(const std::string& cmd)
+void LuaScripting::pushCompiledChunk(const std::string& chunk)
 {
-  LuaStackRAII _a = LuaStackRAII(mL, 0, 0);
-  prepForExecution(cmd);
-  executeFunctionOnStack(0, 0);
-}
+  LuaStackRAII _a = LuaStackRAII(mL, 0, 1);
 
-//-----------------------------------------------------------------------------
-void LuaScripting::resetFunDefault(int argumentPos, int ftableStackPos)
-{
-  LuaStackRAII _a = LuaStackRAII(mL, 1, 0);
+  if (mExecCacheCapacity == 0)
+  {
+    luaL_loadstring(mL, chunk.c_str());
+    return;
+  }
 
-  int valPos = lua_gettop(mL);
-  lua_getfield(mL, ftableStackPos, TBL_MD_FUN_PDEFS);
-  int defs = lua_gettop(mL);
-  lua_getfield(mL, ftableStackPos, TBL_MD_FUN_LAST_EXEC);
-  int exec = lua_gettop(mL);
+  unordered_map<string, ExecCacheList::iterator>::iterator it =
+      mExecCacheIndex.find(chunk);
+  if (it != mExecCacheIndex.end())
+  {
+    ++mExecCacheHits;
+    // Move the entry to the front of the LRU list.
+    mExecCacheLRU.splice(mExecCacheLRU.begin(), mExecCacheLRU, it->second);
+    lua_rawgeti(mL, LUA_REGISTRYINDEX, it->second->second);
+    return;
+  }
 
-  lua_pushinteger(mL, argumentPos);
-  lua_pushvalue(mL, valPos);
-  lua_settable(mL, defs);
+  ++mExecCacheMisses;
+  if (luaL_loadstring(mL, chunk.c_str()) != LUA_OK)
+  {
+    // Leave the error message on the stack, and do not cache the failure.
+    return;
+  }
 
-  lua_pushinteger(mL, argumentPos);
-  lua_pushvalue(mL, valPos);
-  lua_settable(mL, exec);
+  lua_pushvalue(mL, -1);
+  int ref = luaL_ref(mL, LUA_REGISTRYINDEX);
+  mExecCacheLRU.push_front(make_pair(chunk, ref));
+  mExecCacheIndex.insert(make_pair(chunk, mExecCacheLRU.begin()));
 
-  lua_pop(mL, 3); // Pop the defaults table, last exec table, and value at
-                  // top of the stack.
+  trimExecCache(mExecCacheCapacity);
 }
 
 //-----------------------------------------------------------------------------
-void LuaScripting::logExecFailure(const std::string& failure)
+void LuaScripting::trimExecCache(size_t maxSize)
 {
-  ostringstream os;
-  os << " -- FAILED";
-  if (!failure.empty())
+  while (mExecCacheLRU.size() > maxSize)
   {
-    os << ": " << failure;
+    luaL_unref(mL, LUA_REGISTRYINDEX, mExecCacheLRU.back().second);
+    mExecCacheIndex.erase(mExecCacheLRU.back().first);
+    mExecCacheLRU.pop_back();
   }
-  mProvenance->ammendLastProvLog(os.str());
 }
 
 //-----------------------------------------------------------------------------
-void LuaScripting::setExpectedExceptionFlag(bool expected)
+void LuaScripting::setExecCacheCapacity(size_t capacity)
 {
-  LuaStackRAII _a = LuaStackRAII(mL, 0, 0);
-  lua_pushboolean(mL, expected ? 1 : 0);
-  lua_setfield(mL, LUA_REGISTRYINDEX,
-               LuaScripting::REG_EXPECTED_EXCEPTION_FLAG);
+  mExecCacheCapacity = capacity;
+  trimExecCache(capacity);
 }
 
 //-----------------------------------------------------------------------------
-void LuaScripting::setTempProvDisable(bool disable)
+void LuaScripting::resetExecCacheStats()
 {
-  mProvenance->setDisableProvTemporarily(disable);
+  mExecCacheHits = 0;
+  mExecCacheMisses = 0;
 }
 
 //-----------------------------------------------------------------------------
-void LuaScripting::beginCommand()
+void LuaScripting::setGCMode(GCMode mode)
 {
-  mProvenance->beginCommand();
+  switch (mode)
+  {
+    case GC_INCREMENTAL:
+      lua_gc(mL, LUA_GCINC, 0);
+      lua_gc(mL, LUA_GCRESTART, 0);
+      break;
+    case GC_GENERATIONAL:
+      lua_gc(mL, LUA_GCGEN, 0);
+      lua_gc(mL, LUA_GCRESTART, 0);
+      break;
+    case GC_MANUAL:
+      lua_gc(mL, LUA_GCINC, 0);
+      lua_gc(mL, LUA_GCSTOP, 0);
+      break;
+  }
 }
 
 //-----------------------------------------------------------------------------
-void LuaScripting::endCommand()
+void LuaScripting::setGCPause(int pause)
 {
-  mProvenance->endCommand();
+  lua_gc(mL, LUA_GCSETPAUSE, pause);
 }
 
 //-----------------------------------------------------------------------------
-LuaClassInstance LuaScripting::getLuaClassInstance(void* p)
+void LuaScripting::setGCStepMul(int stepMul)
 {
-  LuaStackRAII _a(mL, 0, 0);
+  lua_gc(mL, LUA_GCSETSTEPMUL, stepMul);
+}
 
-  // Grab lookup table and attempt to lookup the light user data.
-  if (getFunctionTable(LuaClassInstance::CLASS_LOOKUP_TABLE) == false)
+namespace
+{
+// Marks the time spent inside gcStep, also when a finalizer throws.
+class GCStepScope
+{
+public:
+  GCStepScope(bool& inStep) : mInStep(inStep) {mInStep = true;}
+  ~GCStepScope()                               {mInStep = false;}
+private:
+  GCStepScope& operator=(const GCStepScope&);
+  bool& mInStep;
+};
+}
+
+//-----------------------------------------------------------------------------
+bool LuaScripting::gcStep(unsigned int microseconds)
+{
+  typedef std::chrono::steady_clock Clock;
+  typedef std::chrono::duration<double, std::milli> Milliseconds;
+
+  const Clock::time_point start = Clock::now();
+  const Clock::time_point deadline =
+      start + std::chrono::microseconds(microseconds);
+  const size_t freedBefore = mAllocator->getFreedBytes();
+
+  bool completed = false;
+  {
+    GCStepScope _s(mGCInStep);
+    Clock::time_point t = start;
+    do
+    {
+      completed = (lua_gc(mL, LUA_GCSTEP, 0) != 0);
+      Clock::time_point now = Clock::now();
+      mGCCycleTime += Milliseconds(now - t).count();
+      t = now;
+      // The sentinel's finalizer ran during the step; report the cycle now
+      // that the step is accounted for.
+      if (mGCCyclePending)
+      {
+        mGCCyclePending = false;
+        reportGCCycle();
+      }
+    } while (!completed && Clock::now() < deadline);
+  }
+
+  if (mGCObserver)
+  {
+    GCEvent e;
+    e.kind         = GCEvent::STEP;
+    e.milliseconds = Milliseconds(Clock::now() - start).count();
+    e.bytes        = mAllocator->getFreedBytes() - freedBefore;
+    mGCObserver(e);
+  }
+  return completed;
+}
+
+//-----------------------------------------------------------------------------
+void LuaScripting::setGCObserver(std::function<void (const GCEvent&)> observer)
+{
+  mGCObserver = observer;
+}
+
+//-----------------------------------------------------------------------------
+void LuaScripting::createGCSentinel()
+{
+  LuaStackRAII _a = LuaStackRAII(mL, 0, 0);
+
+  lua_newtable(mL);
+  lua_pushlightuserdata(mL, this);
+  lua_pushcclosure(mL, &gcSentinelFinalizer, 1);
+  lua_setfield(mL, -2, "__gc");
+
+  // The sentinel itself is dropped immediately; __gc must be present when
+  // the metatable is set for the finalizer to be called.
+  lua_newtable(mL);
+  lua_pushvalue(mL, -2);
+  lua_setmetatable(mL, -2);
+  lua_pop(mL, 2);
+}
+
+//-----------------------------------------------------------------------------
+int LuaScripting::gcSentinelFinalizer(lua_State* L)
+{
+  LuaScripting* ss = static_cast<LuaScripting*>(
+      lua_touserdata(L, lua_upvalueindex(1)));
+  if (ss->mClosing)
+    return 0;
+
+  ss->onGCCycle();
+
+  // Resurrect the sentinel for the next cycle by giving a new table the
+  // same metatable.
+  lua_getmetatable(L, 1);
+  lua_newtable(L);
+  lua_pushvalue(L, -2);
+  lua_setmetatable(L, -2);
+  lua_pop(L, 2);
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+void LuaScripting::onGCCycle()
+{
+  ++mGCCycles;
+  size_t freed = mAllocator->getFreedBytes();
+  mGCCycleBytes = freed - mGCFreedAtCycle;
+  mGCFreedAtCycle = freed;
+
+  if (mGCInStep)
+    mGCCyclePending = true;
+  else
+    reportGCCycle();
+}
+
+//-----------------------------------------------------------------------------
+void LuaScripting::reportGCCycle()
+{
+  GCEvent e;
+  e.kind         = GCEvent::CYCLE;
+  e.milliseconds = mGCCycleTime;
+  e.bytes        = mGCCycleBytes;
+  mGCCycleTime = 0.0;
+  if (mGCObserver)
+    mGCObserver(e);
+}
+
+//-----------------------------------------------------------------------------
+void LuaScripting::cexec(const std::string& cmd)
+{
+  LuaStackRAII _a = LuaStackRAII(mL, 0, 0);
+  prepForExecution(cmd);
+  executeFunctionOnStack(0, 0);
+}
+
+//-----------------------------------------------------------------------------
+void LuaScripting::resetFunDefault(int argumentPos, int ftableStackPos)
+{
+  LuaStackRAII _a = LuaStackRAII(mL, 1, 0);
+
+  int valPos = lua_gettop(mL);
+  lua_getfield(mL, ftableStackPos, TBL_MD_FUN_PDEFS);
+  int defs = lua_gettop(mL);
+
+  // Class methods start out with the defaults of their class prototype.
+  // Copy them before the first modification.
+  lua_getfield(mL, ftableStackPos, TBL_MD_PROTO_PDEFS);
+  if (lua_rawequal(mL, -1, defs))
+  {
+    lua_newtable(mL);
+    lua_pushnil(mL);
+    while (lua_next(mL, defs))
+    {
+      lua_pushvalue(mL, -2);
+      lua_insert(mL, -2);
+      lua_settable(mL, -4);
+    }
+    lua_pushvalue(mL, -1);
+    lua_setfield(mL, ftableStackPos, TBL_MD_FUN_PDEFS);
+    lua_replace(mL, defs);
+  }
+  lua_pop(mL, 1);
+  lua_getfield(mL, ftableStackPos, TBL_MD_FUN_LAST_EXEC);
+  int exec = lua_gettop(mL);
+
+  lua_pushinteger(mL, argumentPos);
+  lua_pushvalue(mL, valPos);
+  lua_settable(mL, defs);
+
+  // A missing last exec table picks up the new default when it is created.
+  if (lua_istable(mL, exec))
+  {
+    lua_pushinteger(mL, argumentPos);
+    lua_pushvalue(mL, valPos);
+    lua_settable(mL, exec);
+  }
+
+  lua_pop(mL, 3); // Pop the defaults table, last exec table, and value at
+                  // top of the stack.
+}
+
+//-----------------------------------------------------------------------------
+void LuaScripting::logExecFailure(const std::string& failure)
+{
+  ostringstream os;
+  os << " -- FAILED";
+  if (!failure.empty())
+  {
+    os << ": " << failure;
+  }
+  mProvenance->ammendLastProvLog(os.str());
+}
+
+//-----------------------------------------------------------------------------
+void LuaScripting::setExpectedExceptionFlag(bool expected)
+{
+  LuaStackRAII _a = LuaStackRAII(mL, 0, 0);
+  lua_pushboolean(mL, expected ? 1 : 0);
+  lua_setfield(mL, LUA_REGISTRYINDEX,
+               LuaScripting::REG_EXPECTED_EXCEPTION_FLAG);
+}
+
+//-----------------------------------------------------------------------------
+void LuaScripting::setTempProvDisable(bool disable)
+{
+  mProvenance->setDisableProvTemporarily(disable);
+}
+
+//-----------------------------------------------------------------------------
+void LuaScripting::beginCommand()
+{
+  mProvenance->beginCommand();
+}
+
+//-----------------------------------------------------------------------------
+void LuaScripting::endCommand()
+{
+  mProvenance->endCommand();
+}
+
+//-----------------------------------------------------------------------------
+LuaClassInstance LuaScripting::getLuaClassInstance(void* p)
+{
+  LuaStackRAII _a(mL, 0, 0);
+
+  // Grab lookup table and attempt to lookup the light user data.
+  if (getFunctionTable(LuaClassInstance::CLASS_LOOKUP_TABLE) == false)
     throw LuaNonExistantFunction("Could not find class lookup table!");
 
   lua_pushlightuserdata(mL, p);
@@ -2334,9 +2931,268 @@ LuaClassInstance LuaScripting::getLuaClassInstance(void* p)
 
 //-----------------------------------------------------------------------------
 bool LuaScripting::getClassTable(LuaClassInstance inst)
+{
+  if (inst.isValid(this) == false)
+    return false;
+
+  LuaStackRAII _a(mL, 0, 1);
+  lua_getfield(mL, LUA_REGISTRYINDEX, LuaClassInstance::INSTANCE_SLOT_TABLE);
+  lua_rawgeti(mL, -1, inst.getGlobalInstID());
+  lua_remove(mL, -2);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+unsigned int
+LuaScripting::getClassInstanceGeneration(LuaClassInstance inst) const
+{
+  LuaClassInstance::IDType id = inst.getGlobalInstID();
+  if (id < 0 || static_cast<size_t>(id) >= mInstanceSlots.size())
+    return 0;
+  return mInstanceSlots[id].generation;
+}
+
+//-----------------------------------------------------------------------------
+void LuaScripting::bindInstanceSlot(LuaClassInstance::IDType id,
+                                    int tableIndex)
+{
+  LuaStackRAII _a(mL, 0, 0);
+  assert(id >= 0);
+
+  tableIndex = lua_absindex(mL, tableIndex);
+  lua_getfield(mL, LUA_REGISTRYINDEX, LuaClassInstance::INSTANCE_SLOT_TABLE);
+  lua_pushvalue(mL, tableIndex);
+  lua_rawseti(mL, -2, id);
+  lua_pop(mL, 1);
+
+  if (static_cast<size_t>(id) >= mInstanceSlots.size())
+    mInstanceSlots.resize(id + 1);
+  InstanceSlot& slot = mInstanceSlots[id];
+  slot.instance = NULL;
+  slot.live = true;
+  ++slot.generation;
+}
+
+//-----------------------------------------------------------------------------
+void LuaScripting::setInstanceSlotPointer(LuaClassInstance::IDType id,
+                                          void* instance)
+{
+  assert(id >= 0 && static_cast<size_t>(id) < mInstanceSlots.size());
+  mInstanceSlots[id].instance = instance;
+}
+
+//-----------------------------------------------------------------------------
+void LuaScripting::releaseInstanceSlot(LuaClassInstance::IDType id)
+{
+  if (id < 0 || static_cast<size_t>(id) >= mInstanceSlots.size()
+      || mInstanceSlots[id].live == false)
+    return;
+
+  LuaStackRAII _a(mL, 0, 0);
+  lua_getfield(mL, LUA_REGISTRYINDEX, LuaClassInstance::INSTANCE_SLOT_TABLE);
+  lua_pushnil(mL);
+  lua_rawseti(mL, -2, id);
+  lua_pop(mL, 1);
+
+  InstanceSlot& slot = mInstanceSlots[id];
+  slot.instance = NULL;
+  slot.live = false;
+  ++slot.generation;
+}
+
+//-----------------------------------------------------------------------------
+void LuaScripting::releaseAllInstanceSlots()
+{
+  LuaStackRAII _a(mL, 0, 0);
+  lua_newtable(mL);
+  lua_setfield(mL, LUA_REGISTRYINDEX, LuaClassInstance::INSTANCE_SLOT_TABLE);
+
+  // Generations are kept so that stale handles never match a later instance.
+  for (vector<InstanceSlot>::iterator it = mInstanceSlots.begin();
+       it != mInstanceSlots.end(); ++it)
+  {
+    if (it->live)
+    {
+      it->instance = NULL;
+      it->live = false;
+      ++it->generation;
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+void LuaScripting::getClassMethodProtos(LuaClassInstance inst)
 {
   LuaStackRAII _a(mL, 0, 1);
-  return getFunctionTable(inst.fqName());
+
+  if (getClassTable(inst) == false)
+    throw LuaNonExistantClassInstancePointer("Unable to find class instance");
+  if (lua_getmetatable(mL, -1) == 0)
+    throw LuaError("Unable to obtain class instance metatable.");
+  lua_remove(mL, -2);
+
+  lua_getfield(mL, -1, LuaClassInstance::MD_METHOD_PROTOS);
+  if (lua_isnil(mL, -1))
+  {
+    // Instances that were not built by a class constructor get a private
+    // cache.
+    lua_pop(mL, 1);
+    lua_newtable(mL);
+    lua_pushvalue(mL, -1);
+    lua_setfield(mL, -3, LuaClassInstance::MD_METHOD_PROTOS);
+  }
+  lua_remove(mL, -2);
+}
+
+//-----------------------------------------------------------------------------
+bool LuaScripting::getClassMethodProto(LuaClassInstance inst,
+                                       const std::string& name,
+                                       lua_CFunction proxyFunc,
+                                       const void* funPtr, size_t funPtrSize,
+                                       const std::string& desc, bool undoRedo)
+{
+  int top = lua_gettop(mL);
+
+  getClassMethodProtos(inst);
+  lua_getfield(mL, -1, name.c_str());
+  if (lua_isnil(mL, -1))
+  {
+    lua_settop(mL, top);
+    return false;
+  }
+  int proto = lua_gettop(mL);
+
+  // The prototype must have been built for the same function. Member
+  // function pointers are compared byte for byte (see registerFunction).
+  bool match = false;
+  lua_getfield(mL, proto, "__call");
+  if (lua_tocfunction(mL, -1) == proxyFunc
+      && lua_getupvalue(mL, -1, 1) != NULL)
+  {
+    match = (lua_rawlen(mL, -1) == funPtrSize
+             && memcmp(lua_touserdata(mL, -1), funPtr, funPtrSize) == 0);
+    lua_pop(mL, 1);
+  }
+  lua_pop(mL, 1);
+
+  if (match)
+  {
+    lua_getfield(mL, proto, "__index");
+    lua_getfield(mL, -1, TBL_MD_STACK_EXEMPT);
+    lua_getfield(mL, -2, TBL_MD_DESC);
+    match = ((lua_toboolean(mL, -2) == 0) == undoRedo
+             && desc.compare(lua_tostring(mL, -1)) == 0);
+    lua_pop(mL, 3);
+  }
+
+  if (match == false)
+  {
+    lua_settop(mL, top);
+    return false;
+  }
+
+  lua_replace(mL, top + 1);
+  lua_settop(mL, top + 1);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void LuaScripting::createClassMethodProto(LuaClassInstance inst,
+                                          const std::string& name,
+                                          const std::string& desc,
+                                          const std::string& sig,
+                                          const std::string& sigWithName,
+                                          const std::string& sigNoRet,
+                                          bool undoRedo, int numParams)
+{
+  LuaStackRAII _a(mL, numParams + 1, 1);
+
+  int firstParam = lua_gettop(mL) - numParams + 1;
+  int closure = firstParam - 1;
+
+  // Shared metadata, looked up through __index by every instance.
+  lua_newtable(mL);
+  int shared = lua_gettop(mL);
+  populateWithSharedMetadata(desc, sig, sigWithName, sigNoRet, shared);
+  lua_pushinteger(mL, numParams);
+  lua_setfield(mL, shared, TBL_MD_NUM_PARAMS);
+
+  if (undoRedo)
+  {
+    lua_newtable(mL);
+    copyParamsToTable(lua_gettop(mL), firstParam, numParams);
+    lua_setfield(mL, shared, TBL_MD_PROTO_PDEFS);
+  }
+  else
+  {
+    lua_pushboolean(mL, 1);
+    lua_setfield(mL, shared, TBL_MD_STACK_EXEMPT);
+  }
+
+  // The prototype is the metatable of the method's function tables.
+  lua_newtable(mL);
+  int proto = lua_gettop(mL);
+  lua_pushvalue(mL, closure);
+  lua_setfield(mL, proto, "__call");
+  lua_pushboolean(mL, 1);
+  lua_setfield(mL, proto, "isRegFunc");
+  lua_pushvalue(mL, shared);
+  lua_setfield(mL, proto, "__index");
+
+  getClassMethodProtos(inst);
+  lua_pushvalue(mL, proto);
+  lua_setfield(mL, -2, name.c_str());
+  lua_pop(mL, 1);
+
+  // Leave only the prototype in place of the closure and the parameters.
+  lua_replace(mL, closure);
+  lua_settop(mL, closure);
+}
+
+//-----------------------------------------------------------------------------
+std::string LuaScripting::bindClassMethod(LuaClassInstance inst,
+                                          const std::string& name,
+                                          void* object, int protoIndex)
+{
+  LuaStackRAII _a(mL, 0, 0);
+
+  protoIndex = lua_absindex(mL, protoIndex);
+  if (getClassTable(inst) == false)
+    throw LuaNonExistantClassInstancePointer("Unable to find class instance");
+  int instTable = lua_gettop(mL);
+
+  lua_getfield(mL, instTable, name.c_str());
+  if (lua_isnil(mL, -1) == 0)
+  {
+    throw LuaFunBindError("Unable to bind function closure. "
+                          "Duplicate name already exists at last "
+                          "descendant.");
+  }
+  lua_pop(mL, 1);
+
+  std::string fqName = inst.fqName() + "." + name;
+
+  lua_newtable(mL);
+  int funTable = lua_gettop(mL);
+  lua_pushvalue(mL, protoIndex);
+  lua_setmetatable(mL, funTable);
+
+  lua_pushlightuserdata(mL, object);
+  lua_setfield(mL, funTable, TBL_MD_MEMBER_INST);
+  populateWithInstanceMetadata(fqName, funTable);
+
+  // Defaults are shared until modified (see resetFunDefault), the last exec
+  // table is created per instance on first use (see pushLastExecTable).
+  lua_getfield(mL, funTable, TBL_MD_PROTO_PDEFS);
+  if (lua_isnil(mL, -1) == 0)
+    lua_setfield(mL, funTable, TBL_MD_FUN_PDEFS);
+  else
+    lua_pop(mL, 1);
+
+  lua_setfield(mL, instTable, name.c_str());
+  lua_pop(mL, 1);
+
+  return fqName;
 }
 
 //-----------------------------------------------------------------------------
@@ -2344,7 +3200,7 @@ void LuaScripting::deleteLuaClassInstance(LuaClassInstance inst)
 {
   LuaStackRAII _a(mL, 0, 0);
 
-  if (getFunctionTable(inst.fqName()))
+  if (getClassTable(inst))
   {
     // Hurry and grab the raw pointer before we delete the table and
     // invalidate the LuaClassInstance.
@@ -2353,12 +3209,16 @@ void LuaScripting::deleteLuaClassInstance(LuaClassInstance inst)
     // Erase the class instance. We want to do this first, before we delete
     // the entity itself. This is to facilitate re-entry (if we attempt to
     // delete the entity again, we can't, we won't make it passed the
-    // getFunctionTable function).
+    // getClassTable function).
+    if (getFunctionTable(LuaClassInstance::CLASS_INSTANCE_TABLE))
     {
       ostringstream os;
-      os << inst.fqName() << " = nil";
-      luaL_dostring(mL, os.str().c_str());
+      os << LuaClassInstance::CLASS_INSTANCE_PREFIX << inst.getGlobalInstID();
+      lua_pushnil(mL);
+      lua_setfield(mL, -2, os.str().c_str());
+      lua_pop(mL, 1);
     }
+    releaseInstanceSlot(inst.getGlobalInstID());
 
     destroyClassInstanceTable(lua_gettop(mL));
 
@@ -3429,6 +4289,304 @@ SUITE(TestLuaScriptingSystem)
     CHECK_EQUAL(true, equal(vecB.begin(), vecB.end(), strArray, predString));
   }
 
+  static int fastHookCalled = 0;
+  static void fastHook(int, int, int) { ++fastHookCalled; }
+
+  TEST(FastCallPath)
+  {
+    TEST_HEADER;
+
+    unique_ptr<LuaScripting> sc(new LuaScripting());
+
+    sc->registerFunction(&dfun, "bench.fun", "", true);
+    sc->registerFunction(&dfun, "bench.hooked", "", true);
+    sc->strictHook(&fastHook, "bench.hooked");
+
+    // Results must be identical regardless of which path is taken.
+    CHECK_EQUAL(true, sc->isProvenanceEnabled());
+    CHECK_EQUAL(42, sc->execRet<int>("bench.fun(1,2,39)"));
+    sc->enableProvenance(false);
+    CHECK_EQUAL(42, sc->execRet<int>("bench.fun(1,2,39)"));
+
+    // Hooks still fire with provenance disabled (hooked functions do not
+    // qualify for the fast path).
+    sc->exec("bench.hooked(1,2,3)");
+    CHECK_EQUAL(1, fastHookCalled);
+
+    // provenance.enable(true) takes the fast path, so it does not end the
+    // command that provenance.enable(false) began. Commands issued after
+    // re-enabling must still be recorded at the top level.
+    sc->registerFunction(&set_1ti, "bench.set_1ti", "", true);
+    sc->enableProvenance(true);
+    sc->exec("provenance.enable(false)");
+    sc->exec("provenance.enable(true)");
+    sc->exec("bench.set_1ti(1)");
+    sc->exec("bench.set_1ti(2)");
+    sc->exec("provenance.undo()");
+    CHECK_EQUAL(1, ti1);
+  }
+
+  TEST(FunctionHandles)
+  {
+    TEST_HEADER;
+
+    unique_ptr<LuaScripting> sc(new LuaScripting());
+
+    sc->registerFunction(&dfun, "handle.sum", "", true);
+    sc->registerFunction(&set_i1, "handle.set_i1", "", true);
+    sc->registerFunction(&get_i1, "handle.get_i1", "", false);
+
+    LuaFunctionHandle sum = sc->resolve("handle.sum");
+    LuaFunctionHandle set = sc->resolve("handle.set_i1");
+    LuaFunctionHandle get = sc->resolve("handle.get_i1");
+    CHECK_EQUAL(true, sum.isValid());
+    CHECK_EQUAL(42, sum.call<int>(1, 2, 39));
+
+    // Calls through handles participate in provenance.
+    set.call<void>(5);
+    set.call<void>(10);
+    CHECK_EQUAL(10, get.call<int>());
+    sc->exec("provenance.undo()");
+    CHECK_EQUAL(5, get.call<int>());
+
+    sc->setExpectedExceptionFlag(true);
+    CHECK_THROW(sc->resolve("handle.doesNotExist"), LuaNonExistantFunction);
+    CHECK_THROW(sc->resolve("handle"), LuaNonExistantFunction);
+
+    sc->setExpectedExceptionFlag(false);
+
+    // See LuaMemberReg.cpp for invalidation through unregistration.
+    sc->removeAllRegistrations();
+    CHECK_EQUAL(false, sum.isValid());
+    CHECK_EQUAL(false, get.isValid());
+  }
+
+  TEST(ExecChunkCache)
+  {
+    TEST_HEADER;
+
+    unique_ptr<LuaScripting> sc(new LuaScripting());
+
+    sc->registerFunction(&set_i1, "cache.set_i1", "", false);
+    sc->registerFunction(&get_i1, "cache.get_i1", "", false);
+    sc->setExecCacheCapacity(2);
+    sc->resetExecCacheStats();
+
+    sc->exec("cache.set_i1(1)");
+    sc->exec("cache.set_i1(2)");
+    sc->exec("cache.set_i1(1)");
+    CHECK_EQUAL(1, sc->execRet<int>("cache.get_i1()"));
+    CHECK_EQUAL(1, sc->getExecCacheHits());
+    CHECK_EQUAL(3, sc->getExecCacheMisses());
+
+    // "cache.set_i1(2)" was the least recently used entry and got evicted.
+    sc->exec("cache.set_i1(2)");
+    CHECK_EQUAL(4, sc->getExecCacheMisses());
+    CHECK_EQUAL(2, sc->execRet<int>("cache.get_i1()"));
+    CHECK_EQUAL(2, sc->getExecCacheHits());
+
+    // Cached chunks still see changes to globals.
+    sc->exec("cacheVar = 3");
+    sc->exec("cache.set_i1(cacheVar)");
+    sc->exec("cacheVar = 4");
+    sc->exec("cache.set_i1(cacheVar)");
+    CHECK_EQUAL(4, sc->execRet<int>("cache.get_i1()"));
+
+    // Compilation failures are reported and not cached.
+    sc->setExpectedExceptionFlag(true);
+    CHECK_THROW(sc->exec("cache.set_i1("), LuaError);
+    CHECK_THROW(sc->exec("cache.set_i1("), LuaError);
+    sc->setExpectedExceptionFlag(false);
+
+    sc->setExecCacheCapacity(0);
+    sc->resetExecCacheStats();
+    sc->exec("cache.set_i1(5)");
+    sc->exec("cache.set_i1(5)");
+    CHECK_EQUAL(0, sc->getExecCacheHits());
+    CHECK_EQUAL(0, sc->getExecCacheMisses());
+    CHECK_EQUAL(5, i1);
+  }
+
+  TEST(CallProfiler)
+  {
+    TEST_HEADER;
+
+    unique_ptr<LuaScripting> sc(new LuaScripting());
+
+    sc->registerFunction(&dfun, "prof.fun", "", true);
+    sc->registerFunction(&dfun, "prof.hooked", "", true);
+    sc->strictHook(&fastHook, "prof.hooked");
+
+    // Nothing is recorded while disabled.
+    sc->exec("prof.fun(1,2,3)");
+    CHECK_EQUAL(false, sc->execRet<bool>("profile.isEnabled()"));
+    CHECK_EQUAL(0, sc->execRet<int>("prof.fun.numExec"));
+
+    sc->exec("profile.enable(true)");
+    sc->exec("prof.fun(1,2,3)");
+    sc->exec("prof.fun(1,2,3)");
+    sc->exec("prof.hooked(1,2,3)");
+    CHECK_EQUAL(2, sc->execRet<int>("prof.fun.numExec"));
+    CHECK_EQUAL(1, sc->execRet<int>("prof.hooked.numExec"));
+
+    // Rows are {name, calls, self, inclusive}, readable from scripts.
+    sc->exec("profRows = {}\n"
+             "for _, row in ipairs(profile.report()) do\n"
+             "  profRows[row[1]] = row\n"
+             "end");
+    CHECK_EQUAL(2, sc->execRet<int>("profRows['prof.fun'][2]"));
+    CHECK_EQUAL(1, sc->execRet<int>("profRows['prof.hooked'][2]"));
+    CHECK_EQUAL(1, sc->execRet<int>("profRows['prof.hooked (hooks)'][2]"));
+    CHECK(sc->execRet<bool>("profRows['prof.fun'][3] >= 0"));
+    CHECK(sc->execRet<bool>(
+        "profRows['prof.fun'][4] >= profRows['prof.fun'][3]"));
+
+    sc->exec("profile.reset()");
+    sc->exec("profFunRows = 0\n"
+             "for _, row in ipairs(profile.report()) do\n"
+             "  if row[1] == 'prof.fun' then\n"
+             "    profFunRows = profFunRows + 1\n"
+             "  end\n"
+             "end");
+    CHECK_EQUAL(0, sc->execRet<int>("profFunRows"));
+
+    sc->exec("profile.enable(false)");
+    sc->exec("prof.fun(1,2,3)");
+    CHECK_EQUAL(2, sc->execRet<int>("prof.fun.numExec"));
+  }
+
+  TEST(SamplingProfiler)
+  {
+    TEST_HEADER;
+
+    unique_ptr<LuaScripting> sc(new LuaScripting());
+
+    const char* file = "luaSamplingProfilerTest.folded";
+    sc->exec("function sampledInner(n) local s = 0; "
+             "for i = 1, n do s = s + i end; return s end");
+    // No tail call: it would replace sampledOuter's frame.
+    sc->exec("function sampledOuter() local s = sampledInner(200000); "
+             "return s end");
+
+    sc->exec("debug.profileStart(100)");
+    sc->exec("sampledOuter()");
+    sc->cexec("debug.profileStop", string(file));
+    CHECK_EQUAL(0, sc->execRet<int>("debug.profileDropped()"));
+
+    // Registered into the standard debug library, yet listed by help.
+    vector<LuaScripting::FunctionDesc> descs = sc->getAllFuncDescs();
+    bool listed = false;
+    for (vector<LuaScripting::FunctionDesc>::const_iterator it =
+         descs.begin(); it != descs.end(); ++it)
+    {
+      if (it->funcFQName == "debug.profileStart")
+        listed = true;
+    }
+    CHECK(listed);
+    CHECK(sc->execRet<bool>("debug.traceback ~= nil"));
+
+    // The inner loop dominates, and must be attributed to its caller.
+    ifstream is(file);
+    string line;
+    bool found = false;
+    while (getline(is, line))
+    {
+      if (line.find("sampledOuter ") != string::npos &&
+          line.find("sampledInner ") > line.find("sampledOuter "))
+        found = true;
+    }
+    is.close();
+    remove(file);
+    CHECK(found);
+
+    sc->setExpectedExceptionFlag(true);
+    CHECK_THROW(sc->exec("debug.profileStart(0)"), LuaError);
+    sc->setExpectedExceptionFlag(false);
+  }
+
+  TEST(PoolAllocator)
+  {
+    TEST_HEADER;
+
+    unique_ptr<LuaScripting> sc(new LuaScripting());
+
+    size_t live = sc->execRet<size_t>("memory.liveBytes()");
+    CHECK(live > 0);
+    CHECK(sc->execRet<size_t>("memory.peakBytes()") >= live);
+    CHECK(sc->execRet<size_t>("memory.reservedBytes()") >= live);
+
+    vector<tuple<size_t, size_t, size_t, size_t> > classes =
+        sc->execRet<vector<tuple<size_t, size_t, size_t, size_t> > >(
+            "memory.sizeClasses()");
+    CHECK_EQUAL(LuaAllocator::NUM_SIZE_CLASSES + 1, classes.size());
+    size_t pooled = 0;
+    for (size_t i = 0; i + 1 < classes.size(); ++i)
+      pooled += get<2>(classes[i]);
+    CHECK(pooled > 0);
+
+    // A runaway script fails cleanly and leaves the state usable.
+    sc->exec("memory.setLimit(memory.liveBytes() + 1000000)");
+    sc->setExpectedExceptionFlag(true);
+    CHECK_THROW(sc->exec("local t = {} for i = 1, 10000000 do "
+                         "t[i] = tostring(i) end"), LuaError);
+    sc->setExpectedExceptionFlag(false);
+    sc->exec("memory.setLimit(0)");
+    sc->exec("collectgarbage()");
+    sc->exec("memTest = {} for i = 1, 1000 do memTest[i] = {i} end");
+    CHECK_EQUAL(1000, sc->execRet<int>("#memTest"));
+  }
+
+  TEST(GCStep)
+  {
+    TEST_HEADER;
+
+    unique_ptr<LuaScripting> sc(new LuaScripting());
+
+    size_t steps = 0;
+    size_t cycles = 0;
+    size_t cycleBytes = 0;
+    sc->setGCObserver([&](const LuaScripting::GCEvent& e)
+    {
+      if (e.kind == LuaScripting::GCEvent::STEP)
+        ++steps;
+      else
+      {
+        ++cycles;
+        cycleBytes += e.bytes;
+      }
+    });
+
+    // Without automatic collection garbage piles up until gcStep runs.
+    sc->setGCMode(LuaScripting::GC_MANUAL);
+    size_t before = sc->getGCCycles();
+    sc->exec("for i = 1, 20000 do local t = {i} end");
+    CHECK_EQUAL(before, sc->getGCCycles());
+
+    bool completed = false;
+    for (int i = 0; i < 10000 && !completed; ++i)
+      completed = sc->gcStep(100);
+    CHECK(completed);
+    CHECK(steps > 0);
+
+    // The sentinel is finalized at the end of the next cycle.
+    for (int i = 0; i < 10000 && sc->getGCCycles() == before; ++i)
+      sc->gcStep(100);
+    CHECK(sc->getGCCycles() > before);
+    CHECK(cycles > 0);
+    CHECK(cycleBytes > 0);
+
+    sc->setGCMode(LuaScripting::GC_GENERATIONAL);
+    sc->setGCPause(150);
+    sc->setGCStepMul(400);
+    sc->exec("for i = 1, 20000 do local t = {i} end");
+    sc->setGCMode(LuaScripting::GC_INCREMENTAL);
+    before = sc->getGCCycles();
+    sc->exec("collectgarbage()");
+    CHECK(sc->getGCCycles() > before);
+
+    sc->setGCObserver(std::function<void (const LuaScripting::GCEvent&)>());
+  }
+
   // More unit tests are spread out amongst the Lua* files.
 
   /// TODO: Add tests for passing shared_ptr's around, and how they work
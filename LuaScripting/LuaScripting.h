@@ -42,7 +42,10 @@
 #define TUVOK_LUASCRIPTING_H_
 
 #include <functional>
+#include <list>
+#include <map>
 #include <memory>
+#include <unordered_map>
 
 #ifndef LUASCRIPTING_NO_TUVOK
 
@@ -76,8 +79,12 @@ namespace tuvok
 {
 
 class LuaProvenance;
+class LuaProfiler;
+class LuaDebug;
+class LuaAllocator;
 class LuaMemberRegUnsafe;
 class LuaClassConstructor;
+class LuaFunctionHandle;
 template <class T> class LuaClassRegistration;
 
 /// Usage Note: If you construct any Lua Class instances that retain a
@@ -89,11 +96,13 @@ class LuaScripting
   // TODO: Expose getLuaState function and most of these can go away.
   friend class LuaMemberRegUnsafe;  // For getNewMemberHookID.
   friend class LuaProvenance;       // For obtaining function tables.
+  friend class LuaProfiler;         // For mProfiling.
   friend class LuaStackRAII;        // For unwinding lua stack during exception
   friend class LuaClassInstanceHook;// For getNewMemberHookID.
   friend class LuaClassConstructor; // For createCallableFuncTable.
   template<class T> friend class LuaClassRegistration;// For notifyOfDeletion.
   friend class LuaClassInstance;    // For obtaining Lua instance.
+  friend class LuaFunctionHandle;   // For registry references.
 public:
 
   LuaScripting();
@@ -112,6 +121,14 @@ public:
   /// shared pointer references.
   void removeAllRegistrations();
 
+  /// Resolves the registered function fqName once, and returns a handle that
+  /// calls it without looking up the fully qualified name again.
+  /// Use this instead of cexec / cexecRet for frequently called functions.
+  /// Include LuaFunctionHandle.h to use the returned handle.
+  /// Throws LuaNonExistantFunction if fqName is not a registered function.
+  /// The handle refers to this instance and must not outlive it.
+  LuaFunctionHandle resolve(const std::string& fqName);
+
   /// Registers a static C++ function with Lua.
   /// Since Lua is compiled as CPP, it is safe to throw exceptions from the
   /// function pointed to by f (since Lua detects that it is being compiled in
@@ -240,6 +257,13 @@ public:
   /// Only use the pointer that was returned from the class constructor.
   LuaClassInstance getLuaClassInstance(void* p);
 
+  /// Retrieves the generation of the slot holding inst. The generation
+  /// changes every time an instance is bound to, or released from, the slot.
+  /// Instance IDs are reused when undo/redo recreates an instance, so code
+  /// that caches raw pointers should compare generations to detect that its
+  /// pointer went stale.
+  unsigned int getClassInstanceGeneration(LuaClassInstance inst) const;
+
   /// Executes a command.
   ///
   /// Example: exec("provenance.undo()")
@@ -252,6 +276,60 @@ public:
   template <typename T>
   T execRet(const std::string& cmd);
 
+  /// exec and execRet keep the compiled form of recently executed commands
+  /// in an LRU cache, so repeated commands are not parsed again.
+  /// A capacity of 0 disables the cache.
+  ///@{
+  void setExecCacheCapacity(size_t capacity);
+  size_t getExecCacheCapacity() const     {return mExecCacheCapacity;}
+  size_t getExecCacheHits() const         {return mExecCacheHits;}
+  size_t getExecCacheMisses() const       {return mExecCacheMisses;}
+  void resetExecCacheStats();
+  ///@}
+
+  /// Garbage collector control.
+  /// In GC_MANUAL mode the collector only runs from gcStep (Lua does not
+  /// even collect when an allocation fails), so a renderer can spend its
+  /// idle time on collection instead of taking pauses in the middle of a
+  /// frame. In GC_GENERATIONAL mode every step is a whole minor collection
+  /// and cannot be cut short.
+  ///@{
+  enum GCMode
+  {
+    GC_INCREMENTAL,
+    GC_GENERATIONAL,
+    GC_MANUAL
+  };
+  void setGCMode(GCMode mode);
+  /// See 'pause' and 'step multiplier' in the Lua manual (def: 200 both).
+  void setGCPause(int pause);
+  void setGCStepMul(int stepMul);
+  /// Performs collection steps for roughly the given time, stopping early
+  /// when a collection cycle completes. At least one step is performed.
+  /// Returns true if a cycle completed.
+  bool gcStep(unsigned int microseconds);
+  ///@}
+
+  /// Reported to the GC observer.
+  /// STEP: a gcStep call; 'milliseconds' is its duration and 'bytes' the
+  ///       memory it freed.
+  /// CYCLE: a collection cycle has completed; 'milliseconds' is the time
+  ///       spent in gcStep during the cycle and 'bytes' the memory freed
+  ///       since the previous cycle. Work that Lua does on its own while
+  ///       allocating is not timed.
+  struct GCEvent
+  {
+    enum Kind {STEP, CYCLE};
+    Kind    kind;
+    double  milliseconds;
+    size_t  bytes;
+  };
+  /// The observer is called from within the collector and must not call
+  /// into Lua. An empty function removes the observer.
+  void setGCObserver(std::function<void (const GCEvent&)> observer);
+  /// Number of collection cycles completed so far.
+  size_t getGCCycles() const              {return mGCCycles;}
+
   /// The following functions allow you to call a function using C++ types.
   /// These function are more efficient than the exec functions given above.
   /// The general form of these functions is given in the below example
@@ -334,6 +412,22 @@ public:
   bool isProvenanceEnabled() const;
   void enableProvenance(bool enable);
 
+  /// True if a provenance enabled command executed now would be placed on
+  /// the undo/redo stack. Functions that keep their own undo state (see
+  /// setUndoFun) use this to decide whether to keep it.
+  bool isProvenanceRecording() const;
+  /// True while the provenance system redoes a command by executing it
+  /// again. Functions called by it are not recorded, but do repeat a
+  /// recorded call.
+  bool isProvenanceRedoing() const;
+
+  /// The observer is called whenever the undo/redo stack is cleared, so
+  /// that such functions can drop their undo state. Observers are removed by
+  /// the owner they were added with.
+  void addProvenanceClearObserver(const void* owner,
+                                  std::function<void ()> observer);
+  void removeProvenanceClearObservers(const void* owner);
+
   LuaClassInstance::IDType getCurGlobalInstID() const{return mGlobalInstanceID;}
   void incrementGlobalInstID()    {mGlobalInstanceID++;}
 
@@ -376,6 +470,12 @@ public:
                                           ///< is called.
   static const char* TBL_MD_PARAM_DESC;   ///< Additional parameter descriptions
                                           ///< table.
+  static const char* TBL_MD_MEMBER_INST;  ///< Object a class method is bound
+                                          ///< to (light user data).
+  static const char* TBL_MD_PROTO_PDEFS;  ///< Parameter defaults shared by all
+                                          ///< instances of a class method.
+  static const char* TBL_MD_HAS_HOOKS;    ///< True while static or member
+                                          ///< hooks are attached.
 
 #ifdef TUVOK_DEBUG_LUA_USE_RTTI_CHECKS
   static const char* TBL_MD_TYPES_TABLE;  ///< type_info userdata table.
@@ -398,6 +498,38 @@ public:
   /// Used for testing purposes only.
   LuaClassInstance::IDType getCurrentClassInstID() {return mGlobalInstanceID;}
 
+  /// True while the call profiler (profile.enable) is recording.
+  bool isProfiling() const  {return mProfiling;}
+
+  /// Records a call of the function table at tableIndex in the call profiler
+  /// for the lifetime of the scope, if the profiler is enabled.
+  class ProfileScope
+  {
+  public:
+    enum Kind { CALL, HOOKS };
+
+    ProfileScope(LuaScripting* ss, lua_State* L, int tableIndex,
+                 Kind kind = CALL)
+    : mSS(ss->isProfiling() ? ss : NULL)
+    {
+      if (mSS == NULL) return;
+      if (kind == HOOKS && mSS->hasHooks(L, tableIndex) == false)
+        mSS = NULL;
+      else
+        mSS->profileEnter(L, tableIndex, kind == HOOKS);
+    }
+    ~ProfileScope()
+    {
+      if (mSS) mSS->profileLeave();
+    }
+
+  private:
+    ProfileScope(const ProfileScope&);
+    ProfileScope& operator=(const ProfileScope&);
+
+    LuaScripting* mSS;
+  };
+
   /// Retrieves the last created instance ID
   LuaClassInstance::IDType getLastCreatedInstID(){return mGlobalInstanceID - 1;}
 
@@ -464,6 +596,55 @@ private: // Used by LuaMemberRegUnsafe
   /// table and the parameters to call the function.
   void doHooks(lua_State* L, int tableIndex, bool provExempt);
 
+  /// Returns true if the function table at tableIndex has any static or
+  /// member hooks attached to it.
+  bool hasHooks(lua_State* L, int tableIndex);
+
+  /// Pushes the hook table 'hookTable' (TBL_MD_HOOKS or TBL_MD_MEMBER_HOOKS)
+  /// of the function table at tableIndex. Hook tables are only created once
+  /// a hook is registered; readers must accept a missing table.
+  void pushHookTable(int tableIndex, const char* hookTable);
+
+  /// Returns true if a call to the function at tableIndex can bypass
+  /// parameter capture, provenance, command grouping, and hook dispatch.
+  /// This is the case when provenance is disabled and no hooks are attached.
+  bool isFastCallEligible(lua_State* L, int tableIndex);
+
+  /// Keep TBL_MD_HAS_HOOKS of the function table at funcTable and
+  /// mNumHooks up to date. Called whenever a hook is attached or detached.
+  /// @{
+  void hookAdded(int funcTable);
+  void hookRemoved(int funcTable);
+  /// @}
+
+  /// Returns the slot in mFunctionRefSlots that references the function
+  /// table of fqName, creating it if necessary. Returns NO_FUNCTION_REF if
+  /// fqName is not a registered function.
+  size_t getFunctionRef(const std::string& fqName);
+
+  /// Releases the registry references held for LuaFunctionHandles to fqName
+  /// and to all functions nested below it (such as the methods of a class
+  /// instance). Those handles will re-resolve their function on next use.
+  void invalidateFunctionHandles(const std::string& fqName);
+
+  /// Releases all registry references held for LuaFunctionHandles.
+  void invalidateFunctionHandles();
+
+  /// Releases the reference in slot and makes the slot available again.
+  void releaseFunctionRef(size_t slot);
+
+  /// Pushes the compiled form of chunk onto the stack, compiling and caching
+  /// it if it is not already present in the exec cache. If chunk fails to
+  /// compile, the error message is pushed instead (see luaL_loadstring).
+  void pushCompiledChunk(const std::string& chunk);
+
+  /// Evicts least recently used chunks until at most maxSize remain.
+  void trimExecCache(size_t maxSize);
+
+  /// Forward to the call profiler. See ProfileScope.
+  void profileEnter(lua_State* L, int tableIndex, bool hooks);
+  void profileLeave();
+
   /// Returns true if the function is provenance exempt.
   /// Used to tell whether or not we should log hooks later on.
   bool doProvenanceFromExec(lua_State* L,
@@ -551,6 +732,8 @@ private:
   void createCallableFuncTable(lua_CFunction proxyFunc, void* realFuncToCall);
 
   /// Populates the table at the given index with the given function metadata.
+  /// Equivalent to populateWithSharedMetadata followed by
+  /// populateWithInstanceMetadata.
   void populateWithMetadata(const std::string& name,
                             const std::string& description,
                             const std::string& signature,
@@ -558,6 +741,48 @@ private:
                             const std::string& sigNoReturn,
                             int tableIndex);
 
+  /// Metadata that does not change once the function is registered. Class
+  /// methods keep it in a prototype shared by all instances of the class.
+  void populateWithSharedMetadata(const std::string& description,
+                                  const std::string& signature,
+                                  const std::string& signatureWithName,
+                                  const std::string& sigNoReturn,
+                                  int tableIndex);
+
+  /// Metadata (the name) that is unique to each function table.
+  void populateWithInstanceMetadata(const std::string& name, int tableIndex);
+
+  /// Class method prototypes. The first instance of a class builds, for each
+  /// of its methods, a metatable holding the method closure and an __index
+  /// table with the shared metadata and parameter defaults. Later instances
+  /// only create a small function table that references this prototype.
+  /// See LuaMemberRegUnsafe::registerClassMethod.
+  ///@{
+  /// Pushes the prototype of the method 'name' of inst's class. Returns false
+  /// and pushes nothing if there is none, or if it was built for a different
+  /// function or registration.
+  bool getClassMethodProto(LuaClassInstance inst, const std::string& name,
+                           lua_CFunction proxyFunc, const void* funPtr,
+                           size_t funPtrSize, const std::string& desc,
+                           bool undoRedo);
+  /// Expects the method closure followed by numParams parameter defaults at
+  /// the top of the stack. Replaces them with the new prototype, which is
+  /// cached for the class of inst.
+  void createClassMethodProto(LuaClassInstance inst, const std::string& name,
+                              const std::string& desc,
+                              const std::string& sig,
+                              const std::string& sigWithName,
+                              const std::string& sigNoRet,
+                              bool undoRedo, int numParams);
+  /// Creates a function table for the method 'name' of inst, calling into
+  /// object, and binds it in the class instance table.
+  /// \return The fully qualified name of the method.
+  std::string bindClassMethod(LuaClassInstance inst, const std::string& name,
+                              void* object, int protoIndex);
+  /// Pushes the prototype cache of inst's class.
+  void getClassMethodProtos(LuaClassInstance inst);
+  ///@}
+
   /// Creates the defaults and last exec tables and places them inside the
   /// table given at tableIndex.
   /// Expects that the parameters are at the top of the stack.
@@ -581,14 +806,28 @@ private:
   /// in the interpreter.
   static int luaPanic(lua_State* L);
 
-  /// Customized memory allocator called from within Lua.
+  /// Customized memory allocator called from within Lua. Forwards to the
+  /// LuaAllocator passed as 'ud'.
   static void* luaInternalAlloc(void* ud, void* ptr, size_t osize,
                                 size_t nsize);
 
+  /// Finalizer of the GC sentinel, an unreachable table that is collected
+  /// (and replaced) once per collection cycle.
+  static int gcSentinelFinalizer(lua_State* L);
+  void createGCSentinel();
+  void onGCCycle();
+  void reportGCCycle();
+
   /// Expects the function table to be given at funTableIndex
   /// Copies the defaults table to the last exec table (used for undo/redo).
   void copyDefaultsTableToLastExec(int funTableIndex);
 
+  /// Pushes the last exec table of the function table at funTableIndex.
+  /// Until the function is executed, its last exec parameters are its
+  /// defaults: the table is copied from them on first use. Pushes nil for
+  /// functions without defaults (see setUndoRedoStackExempt).
+  void pushLastExecTable(int funTableIndex);
+
   /// Expects parameters to start at paramStartIndex. The table to receive the
   /// parameters should be at tableIndex.
   /// Do NOT use psuedo indices for tableIndex or paramStartIndex.
@@ -625,6 +864,17 @@ private:
   /// Class definitions are permanent.
   void deleteLuaClassInstance(LuaClassInstance inst);
 
+  /// Instance slots are indexed by instance ID and let LuaClassInstance
+  /// resolve its table and pointer without walking the instance table.
+  /// bindInstanceSlot also stores the table at tableIndex in the
+  /// INSTANCE_SLOT_TABLE registry table.
+  ///@{
+  void bindInstanceSlot(LuaClassInstance::IDType id, int tableIndex);
+  void setInstanceSlotPointer(LuaClassInstance::IDType id, void* instance);
+  void releaseInstanceSlot(LuaClassInstance::IDType id);
+  void releaseAllInstanceSlots();
+  ///@}
+
   /// Retrieves a new class instance ID. This function is modified by
   /// setNextTempClassInstRange.
   int getNewClassInstID();
@@ -676,6 +926,9 @@ private:
   ///@}
 
 
+  /// Allocator of mL (see luaInternalAlloc). Outlives mL.
+  std::unique_ptr<LuaAllocator>     mAllocator;
+
   /// The one true Lua state.
   lua_State*                        mL;
 
@@ -690,6 +943,12 @@ private:
   /// hooks.
   int                               mMemberHookIndex;
 
+  /// Number of hooks attached to any function. While it is 0, which is the
+  /// common case, isFastCallEligible does not look at the function table.
+  /// Hooks of unregistered functions are not subtracted; that only costs
+  /// the fast check, not correctness.
+  size_t                            mNumHooks;
+
   /// Current global instance ID that will be used to create new Lua classes.
   LuaClassInstance::IDType          mGlobalInstanceID;
   bool                              mGlobalTempInstRange;
@@ -698,11 +957,57 @@ private:
   LuaClassInstance::IDType          mGlobalTempCurrent;
 
   std::unique_ptr<LuaProvenance>      mProvenance;
+  std::unique_ptr<LuaProfiler>        mProfiler;
+  bool                                mProfiling;
+  std::unique_ptr<LuaDebug>           mDebug;
   std::unique_ptr<LuaMemberRegUnsafe> mMemberReg;
   std::unique_ptr<LuaClassConstructor>mClassCons;
 
   bool                              mVerboseMode;
 
+  /// Registry references to function tables handed out to
+  /// LuaFunctionHandles. A handle remembers its slot and the slot's
+  /// generation; releasing a slot increments its generation.
+  struct FunctionRef
+  {
+    int       ref;
+    unsigned  generation;
+  };
+  std::vector<FunctionRef>          mFunctionRefSlots;
+  std::vector<size_t>               mFreeFunctionRefSlots;
+  /// Slots in use, keyed by fully qualified name.
+  std::map<std::string, size_t>     mFunctionRefs;
+  static const size_t               NO_FUNCTION_REF;
+
+  /// Compiled chunk cache used by exec and execRet. mExecCacheLRU holds
+  /// (chunk, registry reference) pairs, most recently used first.
+  typedef std::list<std::pair<std::string, int> > ExecCacheList;
+  ExecCacheList                     mExecCacheLRU;
+  std::unordered_map<std::string, ExecCacheList::iterator>  mExecCacheIndex;
+  size_t                            mExecCacheCapacity;
+  size_t                            mExecCacheHits;
+  size_t                            mExecCacheMisses;
+
+  /// Class instance slots, indexed by instance ID.
+  struct InstanceSlot
+  {
+    InstanceSlot() : instance(NULL), generation(0), live(false) {}
+    void*           instance;
+    unsigned int    generation;
+    bool            live;
+  };
+  std::vector<InstanceSlot>         mInstanceSlots;
+
+  /// GC statistics (see GCEvent).
+  std::function<void (const GCEvent&)>  mGCObserver;
+  size_t                            mGCCycles;
+  double                            mGCCycleTime;
+  size_t                            mGCCycleBytes;
+  size_t                            mGCFreedAtCycle;
+  bool                              mGCInStep;
+  bool                              mGCCyclePending;
+  bool                              mClosing;
+
   /// These structures were created in order to handle void return types easily
   ///@{
   template <typename FunPtr, typename Ret>
@@ -720,6 +1025,17 @@ private:
       {
         LuaScripting* ss = static_cast<LuaScripting*>(
                     lua_touserdata(L, lua_upvalueindex(3)));
+        ProfileScope _p(ss, L, 1);
+
+        // Fast path: With provenance disabled and no hooks attached there is
+        // nothing to record or dispatch. Call straight through without
+        // capturing the parameters (no heap allocations).
+        if (ss->isFastCallEligible(L, 1))
+        {
+          r = LuaCFunExec<FunPtr>::run(L, 2, fp);
+          LuaStrictStack<Ret>().push(L, r);
+          return 1;
+        }
 
         std::shared_ptr<LuaCFunAbstract> execParams(
             new LuaCFunExec<FunPtr>());
@@ -784,6 +1100,14 @@ private:
       {
         LuaScripting* ss = static_cast<LuaScripting*>(
                     lua_touserdata(L, lua_upvalueindex(3)));
+        ProfileScope _p(ss, L, 1);
+
+        // See LuaCallback<FunPtr, Ret>::exec.
+        if (ss->isFastCallEligible(L, 1))
+        {
+          LuaCFunExec<FunPtr>::run(L, 2, fp);
+          return 0;
+        }
 
         std::shared_ptr<LuaCFunAbstract> execParams(
             new LuaCFunExec<FunPtr>());
@@ -935,8 +1259,7 @@ T LuaScripting::execRet(const std::string& cmd)
 {
   LuaStackRAII _a = LuaStackRAII(mL, 0, 0);
 
-  std::string retCmd = "return " + cmd;
-  luaL_loadstring(mL, retCmd.c_str());
+  pushCompiledChunk("return " + cmd);
   lua_call(mL, 0, LUA_MULTRET);
   T ret = LuaStrictStack<T>::get(mL, lua_gettop(mL));
   lua_pop(mL, 1); // Pop return value.
@@ -1105,11 +1428,14 @@ void LuaScripting::strictHookInternal(
   }
   lua_pop(mL, 1);
 
-  // Obtain hook table.
-  lua_getfield(mL, -1, TBL_MD_HOOKS);
+  // Obtain hook table (undo/redo functions are stored in the function table).
+  bool regUndoRedo = (registerUndo || registerRedo);
+  if (regUndoRedo)
+    lua_pushnil(mL);
+  else
+    pushHookTable(funcTable, TBL_MD_HOOKS);
   int hookTable = lua_gettop(mL);
 
-  bool regUndoRedo = (registerUndo || registerRedo);
   std::ostringstream os;
   if (!regUndoRedo)
   {
@@ -1138,6 +1464,7 @@ void LuaScripting::strictHookInternal(
   {
     // Associate closure with hook table.
     lua_setfield(mL, hookTable, os.str().c_str());
+    hookAdded(funcTable);
   }
   else
   {
@@ -0,0 +1,520 @@
+/*
+   For more information, please see: http://software.sci.utah.edu
+
+   The MIT License
+
+   Copyright (c) 2012 Scientific Computing and Imaging Institute,
+   University of Utah.
+
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  \brief  Typed numeric arrays shared between C++ and Lua.
+*/
+
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+#include "LuaTypedArray.h"
+
+using namespace std;
+
+namespace tuvok
+{
+
+const char* LuaTypedArray::METATABLE = "tuvok_typedArray";
+
+namespace
+{
+
+template <typename T>
+bool storeInteger(void* data, size_t i, double v)
+{
+  if (!(v >= 0.0 && v <= static_cast<double>(numeric_limits<T>::max())))
+    return false;
+  static_cast<T*>(data)[i] = static_cast<T>(v);
+  return true;
+}
+
+}
+
+//-----------------------------------------------------------------------------
+LuaTypedArray::LuaTypedArray()
+: mType(FLOAT32)
+, mSize(0)
+, mData(NULL)
+, mReadOnly(false)
+{
+}
+
+//-----------------------------------------------------------------------------
+LuaTypedArray::LuaTypedArray(ElementType type, const Shape& shape)
+: mType(type)
+, mShape(shape)
+, mSize(1)
+, mData(NULL)
+, mReadOnly(false)
+{
+  for (Shape::const_iterator it = mShape.begin(); it != mShape.end(); ++it)
+    mSize *= *it;
+  if (mShape.empty())
+    mSize = 0;
+
+  // Allocated as doubles so that every element type is aligned.
+  size_t bytes = mSize * getElementSize(mType);
+  std::shared_ptr<double> buffer(
+      new double[(bytes + sizeof(double) - 1) / sizeof(double)](),
+      std::default_delete<double[]>());
+  mData = buffer.get();
+  mOwner = buffer;
+}
+
+//-----------------------------------------------------------------------------
+LuaTypedArray::LuaTypedArray(ElementType type, const Shape& shape,
+                             std::shared_ptr<const void> owner, void* data,
+                             bool readOnly)
+: mType(type)
+, mShape(shape)
+, mSize(1)
+, mOwner(owner)
+, mData(data)
+, mReadOnly(readOnly)
+{
+  for (Shape::const_iterator it = mShape.begin(); it != mShape.end(); ++it)
+    mSize *= *it;
+  if (mShape.empty())
+    mSize = 0;
+}
+
+//-----------------------------------------------------------------------------
+void LuaTypedArray::assign(const void* src)
+{
+  if (mSize > 0)
+    memcpy(mData, src, mSize * getElementSize(mType));
+}
+
+//-----------------------------------------------------------------------------
+double LuaTypedArray::get(size_t i) const
+{
+  switch (mType)
+  {
+    case FLOAT32: return static_cast<const float*>(mData)[i];
+    case FLOAT64: return static_cast<const double*>(mData)[i];
+    case UINT8:   return static_cast<const uint8_t*>(mData)[i];
+    case UINT16:  return static_cast<const uint16_t*>(mData)[i];
+    case UINT32:  return static_cast<const uint32_t*>(mData)[i];
+  }
+  return 0.0;
+}
+
+//-----------------------------------------------------------------------------
+bool LuaTypedArray::set(size_t i, double v)
+{
+  switch (mType)
+  {
+    case FLOAT32: static_cast<float*>(mData)[i] = static_cast<float>(v);
+                  return true;
+    case FLOAT64: static_cast<double*>(mData)[i] = v;
+                  return true;
+    case UINT8:   return storeInteger<uint8_t>(mData, i, v);
+    case UINT16:  return storeInteger<uint16_t>(mData, i, v);
+    case UINT32:  return storeInteger<uint32_t>(mData, i, v);
+  }
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+const char* LuaTypedArray::getTypeName(ElementType type)
+{
+  switch (type)
+  {
+    case FLOAT32: return "float";
+    case FLOAT64: return "double";
+    case UINT8:   return "uint8";
+    case UINT16:  return "uint16";
+    case UINT32:  return "uint32";
+  }
+  return "unknown";
+}
+
+//-----------------------------------------------------------------------------
+bool LuaTypedArray::getTypeFromName(const std::string& name,
+                                    ElementType& type)
+{
+  const ElementType types[] = {FLOAT32, FLOAT64, UINT8, UINT16, UINT32};
+  for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); ++i)
+  {
+    if (name == getTypeName(types[i]))
+    {
+      type = types[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+size_t LuaTypedArray::getElementSize(ElementType type)
+{
+  switch (type)
+  {
+    case FLOAT32: return sizeof(float);
+    case FLOAT64: return sizeof(double);
+    case UINT8:   return sizeof(uint8_t);
+    case UINT16:  return sizeof(uint16_t);
+    case UINT32:  return sizeof(uint32_t);
+  }
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+void LuaTypedArray::push(lua_State* L, const LuaTypedArray& a)
+{
+  LuaStackRAII _a(L, 0, 1);
+
+  void* ud = lua_newuserdata(L, sizeof(LuaTypedArray));
+  new (ud) LuaTypedArray(a);
+
+  // The metatable is created the first time an array is pushed.
+  if (luaL_newmetatable(L, METATABLE) != 0)
+  {
+    static const luaL_Reg metamethods[] = {
+      {"__newindex",  &luaNewIndex},
+      {"__len",       &luaLen},
+      {"__gc",        &luaGC},
+      {"__tostring",  &luaToString},
+      {NULL, NULL}
+    };
+    static const luaL_Reg methods[] = {
+      {"get",   &luaGet},
+      {"set",   &luaSet},
+      {"shape", &luaShape},
+      {"type",  &luaType},
+      {"copy",  &luaCopy},
+      {NULL, NULL}
+    };
+    luaL_setfuncs(L, metamethods, 0);
+
+    // __index looks up numeric keys in the array and everything else in
+    // the method table (its upvalue).
+    lua_newtable(L);
+    luaL_setfuncs(L, methods, 0);
+    lua_pushcclosure(L, &luaIndex, 1);
+    lua_setfield(L, -2, "__index");
+  }
+  lua_setmetatable(L, -2);
+}
+
+//-----------------------------------------------------------------------------
+LuaTypedArray& LuaTypedArray::check(lua_State* L, int pos)
+{
+  return *static_cast<LuaTypedArray*>(luaL_checkudata(L, pos, METATABLE));
+}
+
+//-----------------------------------------------------------------------------
+LuaTypedArray* LuaTypedArray::test(lua_State* L, int pos)
+{
+  return static_cast<LuaTypedArray*>(luaL_testudata(L, pos, METATABLE));
+}
+
+//-----------------------------------------------------------------------------
+LuaTypedArray LuaTypedArray::luaNew(std::string type,
+                                    std::vector<size_t> shape)
+{
+  ElementType t;
+  if (getTypeFromName(type, t) == false)
+  {
+    throw LuaError("typedArray.new: unknown element type '" + type + "' "
+                   "(expected float, double, uint8, uint16 or uint32).");
+  }
+  return LuaTypedArray(t, shape);
+}
+
+// Converts the 1 based index at 'pos' to a 0 based one, raising an error
+// when it is out of range.
+static size_t checkIndex(lua_State* L, const LuaTypedArray& a, int pos)
+{
+  lua_Integer i = luaL_checkinteger(L, pos);
+  luaL_argcheck(L, i >= 1 && static_cast<size_t>(i) <= a.size(), pos,
+                "index out of range");
+  return static_cast<size_t>(i - 1);
+}
+
+//-----------------------------------------------------------------------------
+int LuaTypedArray::luaIndex(lua_State* L)
+{
+  LuaTypedArray& a = check(L, 1);
+  if (lua_type(L, 2) == LUA_TNUMBER)
+  {
+    lua_Integer i = lua_tointeger(L, 2);
+    if (i >= 1 && static_cast<size_t>(i) <= a.size())
+      lua_pushnumber(L, a.get(static_cast<size_t>(i - 1)));
+    else
+      lua_pushnil(L);
+    return 1;
+  }
+  lua_pushvalue(L, 2);
+  lua_rawget(L, lua_upvalueindex(1));
+  return 1;
+}
+
+//-----------------------------------------------------------------------------
+int LuaTypedArray::luaNewIndex(lua_State* L)
+{
+  LuaTypedArray& a = check(L, 1);
+  if (a.isReadOnly())
+    return luaL_error(L, "typed array is read-only");
+  size_t i = checkIndex(L, a, 2);
+  if (a.set(i, luaL_checknumber(L, 3)) == false)
+    return luaL_argerror(L, 3, "value out of range for the element type");
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+int LuaTypedArray::luaLen(lua_State* L)
+{
+  lua_pushinteger(L, static_cast<lua_Integer>(check(L, 1).size()));
+  return 1;
+}
+
+//-----------------------------------------------------------------------------
+int LuaTypedArray::luaGC(lua_State* L)
+{
+  check(L, 1).~LuaTypedArray();
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+int LuaTypedArray::luaToString(lua_State* L)
+{
+  LuaTypedArray& a = check(L, 1);
+  ostringstream os;
+  os << "typedArray(" << getTypeName(a.getType()) << ", ";
+  for (Shape::const_iterator it = a.getShape().begin();
+       it != a.getShape().end(); ++it)
+  {
+    if (it != a.getShape().begin())
+      os << "x";
+    os << *it;
+  }
+  os << ")";
+  lua_pushstring(L, os.str().c_str());
+  return 1;
+}
+
+//-----------------------------------------------------------------------------
+int LuaTypedArray::luaGet(lua_State* L)
+{
+  LuaTypedArray& a = check(L, 1);
+  size_t first = a.size() > 0 ? checkIndex(L, a, 2) : 0;
+  lua_Integer count = luaL_optinteger(L, 3,
+      static_cast<lua_Integer>(a.size() - first));
+  luaL_argcheck(L, count >= 0 && first + count <= a.size(), 3,
+                "range exceeds the array");
+
+  lua_createtable(L, static_cast<int>(count), 0);
+  for (lua_Integer i = 0; i < count; ++i)
+  {
+    lua_pushnumber(L, a.get(first + static_cast<size_t>(i)));
+    lua_rawseti(L, -2, static_cast<int>(i + 1));
+  }
+  return 1;
+}
+
+//-----------------------------------------------------------------------------
+int LuaTypedArray::luaSet(lua_State* L)
+{
+  LuaTypedArray& a = check(L, 1);
+  if (a.isReadOnly())
+    return luaL_error(L, "typed array is read-only");
+  size_t first = checkIndex(L, a, 2);
+
+  LuaTypedArray* src = test(L, 3);
+  if (src != NULL)
+  {
+    luaL_argcheck(L, first + src->size() <= a.size(), 3,
+                  "source exceeds the array");
+    if (src->getType() == a.getType())
+    {
+      size_t es = getElementSize(a.getType());
+      memmove(static_cast<char*>(a.mData) + first * es, src->mData,
+              src->size() * es);
+      return 0;
+    }
+    for (size_t i = 0; i < src->size(); ++i)
+    {
+      if (a.set(first + i, src->get(i)) == false)
+        return luaL_argerror(L, 3, "value out of range for the element type");
+    }
+    return 0;
+  }
+
+  luaL_checktype(L, 3, LUA_TTABLE);
+  size_t n = lua_rawlen(L, 3);
+  luaL_argcheck(L, first + n <= a.size(), 3, "source exceeds the array");
+  for (size_t i = 0; i < n; ++i)
+  {
+    lua_rawgeti(L, 3, static_cast<int>(i + 1));
+    int isNum = 0;
+    lua_Number v = lua_tonumberx(L, -1, &isNum);
+    lua_pop(L, 1);
+    if (isNum == 0 || a.set(first + i, v) == false)
+      return luaL_argerror(L, 3, "invalid value for the element type");
+  }
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+int LuaTypedArray::luaShape(lua_State* L)
+{
+  const Shape& shape = check(L, 1).getShape();
+  lua_createtable(L, static_cast<int>(shape.size()), 0);
+  for (size_t i = 0; i < shape.size(); ++i)
+  {
+    lua_pushinteger(L, static_cast<lua_Integer>(shape[i]));
+    lua_rawseti(L, -2, static_cast<int>(i + 1));
+  }
+  return 1;
+}
+
+//-----------------------------------------------------------------------------
+int LuaTypedArray::luaType(lua_State* L)
+{
+  lua_pushstring(L, getTypeName(check(L, 1).getType()));
+  return 1;
+}
+
+//-----------------------------------------------------------------------------
+int LuaTypedArray::luaCopy(lua_State* L)
+{
+  LuaTypedArray& a = check(L, 1);
+  LuaTypedArray c(a.getType(), a.getShape());
+  c.assign(a.mData);
+  push(L, c);
+  return 1;
+}
+
+} /* namespace tuvok */
+
+//==============================================================================
+//
+// UNIT TESTING
+//
+//==============================================================================
+
+#ifdef LUASCRIPTING_UNIT_TESTS
+#include "utestCommon.h"
+using namespace tuvok;
+
+SUITE(LuaTypedArrayTests)
+{
+  LuaTypedArray makeRamp(int n)
+  {
+    vector<float> v(n);
+    for (int i = 0; i < n; ++i)
+      v[i] = static_cast<float>(i);
+    return LuaTypedArray::copy(&v[0], LuaTypedArray::Shape(1, n));
+  }
+
+  double sumArray(LuaTypedArray a)
+  {
+    double sum = 0.0;
+    for (size_t i = 0; i < a.size(); ++i)
+      sum += a.get(i);
+    return sum;
+  }
+
+  TEST(TypedArrayAccess)
+  {
+    TEST_HEADER;
+
+    shared_ptr<LuaScripting> sc(new LuaScripting());
+    sc->registerFunction(&makeRamp, "makeRamp", "", false);
+    sc->registerFunction(&sumArray, "sumArray", "", false);
+
+    sc->exec("a = makeRamp(8)");
+    CHECK_EQUAL(8, sc->execRet<int>("#a"));
+    CHECK_EQUAL(3, sc->execRet<int>("a[4]"));
+    CHECK_EQUAL(true, sc->execRet<bool>("a[9] == nil"));
+    CHECK_EQUAL("float", sc->execRet<string>("a:type()"));
+
+    sc->exec("a[1] = 10");
+    sc->exec("a:set(2, {20, 30})");
+    CHECK_CLOSE(10.0 + 20.0 + 30.0 + 3.0 + 4.0 + 5.0 + 6.0 + 7.0,
+                sc->execRet<double>("sumArray(a)"), 0.0001);
+    vector<double> slice = sc->execRet<vector<double> >("a:get(2, 3)");
+    CHECK_EQUAL(3, slice.size());
+    CHECK_CLOSE(30.0, slice[1], 0.0001);
+
+    sc->exec("b = typedArray.new('uint8', {2, 4})");
+    CHECK_EQUAL(8, sc->execRet<int>("#b"));
+    vector<int> shape = sc->execRet<vector<int> >("b:shape()");
+    CHECK_EQUAL(2, shape.size());
+    CHECK_EQUAL(4, shape[1]);
+    sc->exec("b:set(1, a)");
+    CHECK_EQUAL(30, sc->execRet<int>("b[3]"));
+    sc->exec("c = b:copy() c[3] = 1");
+    CHECK_EQUAL(30, sc->execRet<int>("b[3]"));
+
+    sc->setExpectedExceptionFlag(true);
+    CHECK_THROW(sc->exec("b[1] = 300"), LuaError);
+    CHECK_THROW(sc->exec("b[9] = 1"), LuaError);
+    CHECK_THROW(sc->exec("b:set(8, {1, 2})"), LuaError);
+    CHECK_THROW(sc->exec("typedArray.new('int', {2})"), LuaError);
+    sc->setExpectedExceptionFlag(false);
+  }
+
+  TEST(TypedArrayZeroCopy)
+  {
+    TEST_HEADER;
+
+    shared_ptr<LuaScripting> sc(new LuaScripting());
+    lua_State* L = sc->getLuaState();
+
+    shared_ptr<vector<uint16_t> > buf(new vector<uint16_t>(4, 7));
+    LuaTypedArray::push(L, LuaTypedArray::wrap(buf, &(*buf)[0],
+                                               LuaTypedArray::Shape(1, 4)));
+    lua_setglobal(L, "w");
+
+    (*buf)[2] = 42;
+    CHECK_EQUAL(42, sc->execRet<int>("w[3]"));
+    sc->exec("w[1] = 5");
+    CHECK_EQUAL(5, (*buf)[0]);
+
+    // The array keeps the buffer alive.
+    buf.reset();
+    sc->exec("collectgarbage()");
+    CHECK_EQUAL(42, sc->execRet<int>("w[3]"));
+
+    shared_ptr<const vector<uint32_t> > cbuf(new vector<uint32_t>(3, 1));
+    LuaTypedArray::push(L, LuaTypedArray::wrap(cbuf, &(*cbuf)[0],
+                                               LuaTypedArray::Shape(1, 3)));
+    lua_setglobal(L, "r");
+    CHECK_EQUAL(3, sc->execRet<int>("#r"));
+    sc->setExpectedExceptionFlag(true);
+    CHECK_THROW(sc->exec("r[1] = 2"), LuaError);
+    CHECK_THROW(sc->exec("r:set(1, {2})"), LuaError);
+    sc->setExpectedExceptionFlag(false);
+  }
+}
+
+#endif
@@ -0,0 +1,258 @@
+/*
+   For more information, please see: http://software.sci.utah.edu
+
+   The MIT License
+
+   Copyright (c) 2012 Scientific Computing and Imaging Institute,
+   University of Utah.
+
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included
+   in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+*/
+
+/**
+  \brief  Typed numeric arrays shared between C++ and Lua.
+          Lua sees a userdata that indexes like a table; C++ sees the
+          buffer itself, so large arrays cross the boundary without being
+          converted element by element.
+*/
+
+#ifndef TUVOK_LUATYPEDARRAY_H_
+#define TUVOK_LUATYPEDARRAY_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "LuaScripting.h"
+
+namespace tuvok
+{
+
+/// A flat array of numbers of one element type, with a shape.
+///
+/// Copies of a LuaTypedArray share the same buffer. The buffer is either
+/// owned by the array or borrowed from C++ (see wrap); a borrowed buffer is
+/// kept alive through the owner passed to wrap. Arrays wrapping const data
+/// are read-only.
+///
+/// The shape is informational: elements are addressed with a flat index and
+/// stored with the last dimension varying fastest.
+///
+/// In Lua, arrays are indexed from 1:
+///  a[i], a[i] = v, #a      element access and element count
+///  a:get(first, count)     returns a table holding count elements
+///  a:set(first, src)       copies a table or typed array into the array
+///  a:shape(), a:type()     the shape table and the element type name
+///  a:copy()                returns an array owning a copy of the elements
+/// New arrays are created with typedArray.new(type, shape).
+class LuaTypedArray
+{
+public:
+
+  enum ElementType
+  {
+    FLOAT32,
+    FLOAT64,
+    UINT8,
+    UINT16,
+    UINT32
+  };
+
+  typedef std::vector<size_t> Shape;
+
+  /// Element type of C++ type T (specialized below for the supported types).
+  template <typename T> struct Traits;
+
+  /// An empty float array.
+  LuaTypedArray();
+
+  /// Allocates a zero-filled array.
+  LuaTypedArray(ElementType type, const Shape& shape);
+
+  /// Allocates an array and fills it with a single memcpy.
+  template <typename T>
+  static LuaTypedArray copy(const T* data, const Shape& shape)
+  {
+    LuaTypedArray a(Traits<T>::type, shape);
+    a.assign(data);
+    return a;
+  }
+
+  /// Shares 'data' without copying. 'owner' must keep 'data' alive.
+  ///@{
+  template <typename T>
+  static LuaTypedArray wrap(std::shared_ptr<void> owner, T* data,
+                            const Shape& shape)
+  {
+    return LuaTypedArray(Traits<T>::type, shape, owner, data, false);
+  }
+  template <typename T>
+  static LuaTypedArray wrap(std::shared_ptr<const void> owner, const T* data,
+                            const Shape& shape)
+  {
+    return LuaTypedArray(Traits<T>::type, shape, owner,
+                         const_cast<T*>(data), true);
+  }
+  ///@}
+
+  ElementType   getType() const     {return mType;}
+  const Shape&  getShape() const    {return mShape;}
+  /// Number of elements.
+  size_t        size() const        {return mSize;}
+  bool          isReadOnly() const  {return mReadOnly;}
+
+  /// Pointer to the elements, or NULL if T does not match the element type.
+  /// The non-const version also returns NULL for read-only arrays.
+  template <typename T>
+  T* data()
+  {
+    return (Traits<T>::type == mType && !mReadOnly)
+        ? static_cast<T*>(mData) : NULL;
+  }
+  template <typename T>
+  const T* data() const
+  {
+    return Traits<T>::type == mType ? static_cast<const T*>(mData) : NULL;
+  }
+
+  /// Element i (0 based) converted to double.
+  double get(size_t i) const;
+  /// Stores v as element i (0 based). Returns false if v cannot be
+  /// represented by the element type.
+  bool set(size_t i, double v);
+
+  static const char* getTypeName(ElementType type);
+  /// Returns false if 'name' is not one of the names getTypeName returns.
+  static bool getTypeFromName(const std::string& name, ElementType& type);
+  static size_t getElementSize(ElementType type);
+
+  /// Lua interface.
+  ///@{
+  /// Pushes a userdata sharing the buffer of 'a'.
+  static void push(lua_State* L, const LuaTypedArray& a);
+  /// Returns the array at 'pos', raising a Lua error if there is none.
+  static LuaTypedArray& check(lua_State* L, int pos);
+  /// Returns the array at 'pos', or NULL.
+  static LuaTypedArray* test(lua_State* L, int pos);
+  /// Backs typedArray.new.
+  static LuaTypedArray luaNew(std::string type, std::vector<size_t> shape);
+  ///@}
+
+  /// Name of the metatable shared by all typed array userdata.
+  static const char* METATABLE;
+
+private:
+
+  LuaTypedArray(ElementType type, const Shape& shape,
+                std::shared_ptr<const void> owner, void* data, bool readOnly);
+
+  void assign(const void* src);
+
+  /// Metamethods and methods of the userdata.
+  ///@{
+  static int luaIndex(lua_State* L);
+  static int luaNewIndex(lua_State* L);
+  static int luaLen(lua_State* L);
+  static int luaGC(lua_State* L);
+  static int luaToString(lua_State* L);
+  static int luaGet(lua_State* L);
+  static int luaSet(lua_State* L);
+  static int luaShape(lua_State* L);
+  static int luaType(lua_State* L);
+  static int luaCopy(lua_State* L);
+  ///@}
+
+  ElementType                 mType;
+  Shape                       mShape;
+  size_t                      mSize;
+  std::shared_ptr<const void> mOwner;
+  void*                       mData;
+  bool                        mReadOnly;
+};
+
+template <> struct LuaTypedArray::Traits<float>
+{ static const ElementType type = FLOAT32; };
+template <> struct LuaTypedArray::Traits<double>
+{ static const ElementType type = FLOAT64; };
+template <> struct LuaTypedArray::Traits<uint8_t>
+{ static const ElementType type = UINT8; };
+template <> struct LuaTypedArray::Traits<uint16_t>
+{ static const ElementType type = UINT16; };
+template <> struct LuaTypedArray::Traits<uint32_t>
+{ static const ElementType type = UINT32; };
+
+/// Captured arrays are charged for all of their elements, shared or not:
+/// the capture keeps them alive either way.
+inline size_t luaParamBytes(const LuaTypedArray& a)
+{
+  return sizeof(a) + a.getShape().capacity() * sizeof(size_t)
+       + a.size() * LuaTypedArray::getElementSize(a.getType());
+}
+
+template<>
+class LuaStrictStack<LuaTypedArray>
+{
+public:
+  typedef LuaTypedArray Type;
+
+  static Type get(lua_State* L, int pos)
+  {
+    return LuaTypedArray::check(L, pos);
+  }
+
+  static void push(lua_State* L, const Type& in)
+  {
+    LuaTypedArray::push(L, in);
+  }
+
+  static std::string getValStr(const Type& in)
+  {
+    std::ostringstream os;
+    os << "typedArray(" << LuaTypedArray::getTypeName(in.getType()) << ", "
+       << in.size() << ")";
+    return os.str();
+  }
+  static std::string getTypeStr() { return "TypedArray"; }
+  static Type        getDefault() { return Type(); }
+};
+
+template<>
+class LuaStrictStack<const LuaTypedArray&>
+{
+public:
+  typedef LuaTypedArray Type;
+
+  static Type get(lua_State* L, int pos)
+  { return LuaStrictStack<Type>::get(L, pos); }
+  static void push(lua_State* L, const Type& in)
+  { LuaStrictStack<Type>::push(L, in); }
+
+  static std::string getValStr(const Type& in)
+  { return LuaStrictStack<Type>::getValStr(in); }
+  static std::string getTypeStr()
+  { return LuaStrictStack<Type>::getTypeStr(); }
+  static Type getDefault()
+  { return LuaStrictStack<Type>::getDefault(); }
+};
+
+} /* namespace tuvok */
+
+#endif
@@ -30,9 +30,13 @@
  \brief A Lua class proxy for IO's dataset class.
  */
 
+#include <map>
+#include <typeindex>
+#include <typeinfo>
 #include <vector>
 
 #include "3rdParty/LUA/lua.hpp"
+#include "Basics/Grids.h"
 #include "Controller/Controller.h"
 #include "IO/DynamicBrickingDS.h"
 #include "IO/FileBackedDataset.h"
@@ -40,6 +44,7 @@
 #include "IO/uvfDataset.h"
 #include "../LuaClassRegistration.h"
 #include "../LuaScripting.h"
+#include "../LuaTypedArray.h"
 #include "LuaDatasetProxy.h"
 #include "LuaTuvokTypes.h"
 
@@ -79,6 +84,8 @@ void dataset(std::shared_ptr<LuaScripting>& ss) {
 LuaDatasetProxy::LuaDatasetProxy()
     : mReg(NULL)
     , mDS(NULL)
+    , mMethods(NULL)
+    , mBinding(false)
     , mDatasetType(Unknown) { }
 
 LuaDatasetProxy::~LuaDatasetProxy()
@@ -101,103 +108,208 @@ void LuaDatasetProxy::bind(Dataset* ds, shared_ptr<LuaScripting> ss)
   mReg->clearProxyFunctions();
 
   mDS = ds;
-  if (ds != NULL)
+  mMethods = (ds != NULL) ? &methodsFor(ds) : NULL;
+  mDatasetType = (mMethods != NULL && mMethods->uvf) ? UVF : Unknown;
+
+  lua_State* L = ss->getLuaState();
+  LuaStackRAII _a(L, 0, 0);
+
+  // Dataset methods are registered on first access through the instance
+  // table's __index metamethod.
+  LuaStrictStack<LuaClassInstance>::push(L, mReg->getLuaInstance());
+  if (lua_getmetatable(L, -1) == 0)
+    throw LuaError("Unable to obtain dataset instance metatable.");
+  lua_pushlightuserdata(L, ss.get());
+  lua_pushcclosure(L, &LuaDatasetProxy::lazyIndex, 1);
+  lua_setfield(L, -2, "__index");
+
+  // Lets help() list the methods that have not been used yet.
+  lua_newtable(L);
+  if (mMethods != NULL)
   {
-    // Register dataset functions using ds.
-    string id;
-
-    id = mReg->functionProxy(ds, &Dataset::GetDomainSize,
-                             "getDomainSize", "", false);
-    id = mReg->functionProxy(ds, &Dataset::GetRange,
-                             "getRange", "", false);
-    id = mReg->functionProxy(ds, &Dataset::GetLODLevelCount,
-                             "getLODLevelCount", "", false);
-    id = mReg->functionProxy(ds, &Dataset::GetNumberOfTimesteps,
-                             "getNumberOfTimesteps", "", false);
+    for (size_t i = 0; i < mMethods->names.size(); ++i)
+    {
+      lua_pushboolean(L, 1);
+      lua_setfield(L, -2, mMethods->names[i].c_str());
+    }
+  }
+  lua_setfield(L, -2, LuaClassInstance::MD_LAZY_METHODS);
+  lua_pop(L, 2);
+}
+
+const LuaDatasetProxy::DatasetMethods&
+LuaDatasetProxy::methodsFor(const Dataset* ds)
+{
+  static map<type_index, DatasetMethods> types;
+
+  type_index type(typeid(*ds));
+  map<type_index, DatasetMethods>::iterator it = types.find(type);
+  if (it != types.end())
+    return it->second;
+
+  DatasetMethods m;
+  m.fileBacked      = dynamic_cast<const FileBackedDataset*>(ds) != NULL;
+  m.bricked         = dynamic_cast<const BrickedDataset*>(ds) != NULL;
+  m.uvf             = dynamic_cast<const UVFDataset*>(ds) != NULL;
+  m.dynamicBricking = dynamic_cast<const DynamicBrickingDS*>(ds) != NULL;
+
+  static const char* const datasetNames[] = {
+    "getDomainSize", "getRange", "getLODLevelCount", "getNumberOfTimesteps",
+    "getMeshes", "getBitWidth", "get1DHistogram", "get2DHistogram",
+    "saveRescaleFactors", "getRescaleFactors", "clear"
+  };
+  m.names.assign(datasetNames,
+                 datasetNames + sizeof(datasetNames) / sizeof(datasetNames[0]));
+  if (m.fileBacked) {
+    m.names.push_back("fullpath");
+    m.names.push_back("name");
+  }
+  if (m.bricked) {
+    m.names.push_back("maxUsedBrickSize");
+  }
+  if (m.uvf) {
+    m.names.push_back("removeMesh");
+    m.names.push_back("appendMesh");
+    m.names.push_back("geomTransformToFile");
+  }
+  if (m.dynamicBricking) {
+    m.names.push_back("setCacheSize");
+    m.names.push_back("getCacheSize");
+  }
+
+  MESSAGE("Resolved %u Lua methods for dataset type %s.",
+          static_cast<unsigned>(m.names.size()), type.name());
+  return types.insert(make_pair(type, m)).first->second;
+}
+
+bool LuaDatasetProxy::bindMethod(const string& name, LuaScripting* ss)
+{
+  Dataset* ds = mDS;
+  if (ds == NULL || mMethods == NULL)
+    return false;
+
+  string id;
+  if (name == "getDomainSize") {
+    mReg->functionProxy(ds, &Dataset::GetDomainSize,
+                        "getDomainSize", "", false);
+  } else if (name == "getRange") {
+    mReg->functionProxy(ds, &Dataset::GetRange,
+                        "getRange", "", false);
+  } else if (name == "getLODLevelCount") {
+    mReg->functionProxy(ds, &Dataset::GetLODLevelCount,
+                        "getLODLevelCount", "", false);
+  } else if (name == "getNumberOfTimesteps") {
+    mReg->functionProxy(ds, &Dataset::GetNumberOfTimesteps,
+                        "getNumberOfTimesteps", "", false);
+  } else if (name == "getMeshes") {
     id = mReg->functionProxy(ds, &Dataset::GetMeshes,
                              "getMeshes", "", false);
     // We do NOT want the return values from GetMeshes stuck in the provenance
     // system (Okay, so the provenance system doesn't store return values, just
     // function parameters. But it's best to be safe).
     ss->setProvenanceExempt(id);
-    id = mReg->functionProxy(ds, &Dataset::GetBitWidth,
-                             "getBitWidth", "", false);
-    id = mReg->functionProxy(ds, &Dataset::Get1DHistogram,
-                             "get1DHistogram", "", false);
-    id = mReg->functionProxy(ds, &Dataset::Get2DHistogram,
-                             "get2DHistogram", "", false);
-    id = mReg->functionProxy(ds, &Dataset::SaveRescaleFactors,
-                             "saveRescaleFactors", "", false);
-    id = mReg->functionProxy(ds, &Dataset::GetRescaleFactors,
-                             "getRescaleFactors", "", false);
-    id = mReg->functionProxy(ds, &Dataset::Clear,
-                             "clear", "clears cache data", false);
-
-    // Attempt to cast the dataset to a file backed dataset.
-    FileBackedDataset* fileDataset = dynamic_cast<FileBackedDataset*>(ds);
-    if (fileDataset != NULL)
-    {
-      MESSAGE("Binding extra FileBackedDS functions.");
-      id = mReg->functionProxy(fileDataset, &FileBackedDataset::Filename,
-                               "fullpath", "Full path to the dataset.", false);
-      id = mReg->functionProxy(ds, &FileBackedDataset::Name,
-                               "name", "Dataset descriptive name.", false);
-    }
-
-    try {
-      BrickedDataset& bds = dynamic_cast<BrickedDataset&>(*ds);
-      id = mReg->functionProxy(&bds, &BrickedDataset::GetMaxUsedBrickSizes,
-                               "maxUsedBrickSize",
-                               "the size of the largest brick", false);
-    } catch(const std::bad_cast&) {
-      WARNING("Not binding BrickedDataset functions.");
-    }
-
-    try {
-      UVFDataset& uvfDataset = dynamic_cast<UVFDataset&>(*ds);
-      MESSAGE("Binding extra UVF functions.");
-      mDatasetType = UVF;
-      mReg->functionProxy(&uvfDataset, &UVFDataset::RemoveMesh, "removeMesh",
-                          "", true);
-      mReg->functionProxy(&uvfDataset, &UVFDataset::AppendMesh,
-                          "appendMesh", "", false);
-      id = mReg->functionProxy(&uvfDataset,
-        &UVFDataset::GeometryTransformToFile, "geomTransformToFile", "",
-        false
-      );
-      ss->setProvenanceExempt(id);
-    } catch(const std::bad_cast&) {
-      WARNING("Not a uvf; not binding mesh functions.");
-    }
-
-    try {
-      DynamicBrickingDS& dynDS = dynamic_cast<DynamicBrickingDS&>(*ds);
-      MESSAGE("Binding dynamic bricking cache control functions");
-      id = mReg->functionProxy(&dynDS, &DynamicBrickingDS::SetCacheSize,
-                               "setCacheSize",
-                               "sets the size of the cache, in megabytes.",
-                               false);
-      ss->addParamInfo(id, 0, "cacheMB", "cache size (megabytes)");
-      id = mReg->functionProxy(&dynDS, &DynamicBrickingDS::GetCacheSize,
-                              "getCacheSize",
-                              "gets the size of the cache, in megabytes.",
-                              false);
-    } catch(const std::bad_cast&) {
-      MESSAGE("Not dynamically bricked; not adding cache control functions.");
-    }
+  } else if (name == "getBitWidth") {
+    mReg->functionProxy(ds, &Dataset::GetBitWidth,
+                        "getBitWidth", "", false);
+  } else if (name == "get1DHistogram") {
+    mReg->functionProxy(ds, &Dataset::Get1DHistogram,
+                        "get1DHistogram", "", false);
+  } else if (name == "get2DHistogram") {
+    mReg->functionProxy(ds, &Dataset::Get2DHistogram,
+                        "get2DHistogram", "", false);
+  } else if (name == "saveRescaleFactors") {
+    mReg->functionProxy(ds, &Dataset::SaveRescaleFactors,
+                        "saveRescaleFactors", "", false);
+  } else if (name == "getRescaleFactors") {
+    mReg->functionProxy(ds, &Dataset::GetRescaleFactors,
+                        "getRescaleFactors", "", false);
+  } else if (name == "clear") {
+    mReg->functionProxy(ds, &Dataset::Clear,
+                        "clear", "clears cache data", false);
+  } else if (mMethods->fileBacked && name == "fullpath") {
+    mReg->functionProxy(dynamic_cast<FileBackedDataset*>(ds),
+                        &FileBackedDataset::Filename,
+                        "fullpath", "Full path to the dataset.", false);
+  } else if (mMethods->fileBacked && name == "name") {
+    mReg->functionProxy(dynamic_cast<FileBackedDataset*>(ds),
+                        &FileBackedDataset::Name,
+                        "name", "Dataset descriptive name.", false);
+  } else if (mMethods->bricked && name == "maxUsedBrickSize") {
+    mReg->functionProxy(dynamic_cast<BrickedDataset*>(ds),
+                        &BrickedDataset::GetMaxUsedBrickSizes,
+                        "maxUsedBrickSize",
+                        "the size of the largest brick", false);
+  } else if (mMethods->uvf && name == "removeMesh") {
+    mReg->functionProxy(dynamic_cast<UVFDataset*>(ds),
+                        &UVFDataset::RemoveMesh, "removeMesh", "", true);
+  } else if (mMethods->uvf && name == "appendMesh") {
+    mReg->functionProxy(dynamic_cast<UVFDataset*>(ds),
+                        &UVFDataset::AppendMesh, "appendMesh", "", false);
+  } else if (mMethods->uvf && name == "geomTransformToFile") {
+    id = mReg->functionProxy(dynamic_cast<UVFDataset*>(ds),
+                             &UVFDataset::GeometryTransformToFile,
+                             "geomTransformToFile", "", false);
+    ss->setProvenanceExempt(id);
+  } else if (mMethods->dynamicBricking && name == "setCacheSize") {
+    id = mReg->functionProxy(dynamic_cast<DynamicBrickingDS*>(ds),
+                             &DynamicBrickingDS::SetCacheSize,
+                             "setCacheSize",
+                             "sets the size of the cache, in megabytes.",
+                             false);
+    ss->addParamInfo(id, 0, "cacheMB", "cache size (megabytes)");
+  } else if (mMethods->dynamicBricking && name == "getCacheSize") {
+    mReg->functionProxy(dynamic_cast<DynamicBrickingDS*>(ds),
+                        &DynamicBrickingDS::GetCacheSize,
+                        "getCacheSize",
+                        "gets the size of the cache, in megabytes.", false);
+  } else {
+    return false;
+  }
+  return true;
+}
 
-    /// @todo Expose 1D/2D histogram? Currently, it is being transfered
-    ///       via shared_ptr. If lua wants to interpret this, the histogram
-    ///       will need to be placed in terms that lua can understand.
-    ///       Two approaches:
-    ///       1) Add Grid1D to the LuaStrictStack.
-    ///       2) Create a Histogram1D and Histogram2D proxy.
-    ///       
-    ///       The second solution would be more efficient, since there wouldn't
-    ///       be any time spent converting datatypes to and from Lua (and with
-    ///       histograms, that time wouldn't be negligible).
+int LuaDatasetProxy::lazyIndex(lua_State* L)
+{
+  // Arguments: the instance table and the key.
+  if (lua_type(L, 2) != LUA_TSTRING || lua_getmetatable(L, 1) == 0)
+    return 0;
+
+  LuaScripting* ss = static_cast<LuaScripting*>(
+      lua_touserdata(L, lua_upvalueindex(1)));
+  lua_getfield(L, -1, LuaClassInstance::MD_GLOBAL_INSTANCE_ID);
+  LuaClassInstance inst(static_cast<int>(lua_tointeger(L, -1)));
+  lua_pop(L, 2);
+
+  // Tables of deleted instances can outlive them, and undo recreates
+  // instances under the same ID.
+  if (inst.isValid(ss) == false)
+    return 0;
+  LuaStrictStack<LuaClassInstance>::push(L, inst);
+  bool current = lua_rawequal(L, 1, -1) != 0;
+  lua_pop(L, 1);
+  if (current == false)
+    return 0;
+
+  // Registering the method looks the name up again; that lookup must miss.
+  LuaDatasetProxy* me = inst.getRawPointer_NoSharedPtr<LuaDatasetProxy>(ss);
+  if (me->mBinding)
+    return 0;
+
+  bool bound = false;
+  me->mBinding = true;
+  try {
+    bound = me->bindMethod(lua_tostring(L, 2), ss);
+  } catch (...) {
+    me->mBinding = false;
+    throw;
   }
+  me->mBinding = false;
+  if (bound == false)
+    return 0;
 
+  lua_pushvalue(L, 2);
+  lua_rawget(L, 1);
+  return 1;
 }
 
 void LuaDatasetProxy::defineLuaInterface(
@@ -213,6 +325,17 @@ void LuaDatasetProxy::defineLuaInterface(
   id = reg.function(&LuaDatasetProxy::getDatasetType, "getDSType", "", false);
   id = reg.function(&LuaDatasetProxy::proxyGetMetadata, "getMetadata", "",
                     false);
+  // get1DHistogram and get2DHistogram hand out shared_ptrs that Lua cannot
+  // look into. These expose the bins without copying them.
+  id = reg.function(&LuaDatasetProxy::proxyGet1DHistogramArray,
+                    "get1DHistogramArray",
+                    "1D histogram as a read-only uint32 typed array.", false);
+  ss->setProvenanceExempt(id);
+  id = reg.function(&LuaDatasetProxy::proxyGet2DHistogramArray,
+                    "get2DHistogramArray",
+                    "2D histogram as a read-only uint32 typed array of shape "
+                    "{gradients, values}.", false);
+  ss->setProvenanceExempt(id);
 
   lua_State* L = ss->getLuaState();
   lua_pushinteger(L, DynamicBrickingDS::MM_SOURCE);
@@ -230,4 +353,23 @@ LuaDatasetProxy::proxyGetMetadata()
   return mDS->GetMetadata();
 }
 
+LuaTypedArray LuaDatasetProxy::proxyGet1DHistogramArray()
+{
+  std::shared_ptr<const Histogram1D> hist = mDS->Get1DHistogram();
+  if (!hist) return LuaTypedArray();
+  LuaTypedArray::Shape shape(1, hist->GetSize());
+  return LuaTypedArray::wrap(hist, hist->GetDataPointer(), shape);
+}
+
+LuaTypedArray LuaDatasetProxy::proxyGet2DHistogramArray()
+{
+  std::shared_ptr<const Histogram2D> hist = mDS->Get2DHistogram();
+  if (!hist) return LuaTypedArray();
+  // The value axis varies fastest.
+  LuaTypedArray::Shape shape(2);
+  shape[0] = hist->GetSize().y;
+  shape[1] = hist->GetSize().x;
+  return LuaTypedArray::wrap(hist, hist->GetDataPointer(), shape);
+}
+
 } /* namespace tuvok */
@@ -40,6 +40,7 @@ namespace tuvok
 {
 
 class Dataset;
+class LuaTypedArray;
 
 namespace Registrar {
   // entry point for registering all the tuvok.dataset functions.
@@ -62,6 +63,9 @@ public:
   virtual ~LuaDatasetProxy();
 
   Dataset* CreateDS(const std::string& uvf, unsigned bricksize);
+
+  /// Binds the proxy to ds. Dataset methods are registered lazily, the first
+  /// time they are looked up in the class instance (see lazyIndex).
   void bind(Dataset* ds, std::shared_ptr<LuaScripting> ss);
 
   static LuaDatasetProxy* luaConstruct() {return new LuaDatasetProxy;}
@@ -76,11 +80,34 @@ public:
 private:
 
   std::vector<std::pair<std::string, std::string>> proxyGetMetadata();
+  LuaTypedArray proxyGet1DHistogramArray();
+  LuaTypedArray proxyGet2DHistogramArray();
+
+  /// Capabilities and method names of a dataset type. Resolved once per
+  /// dynamic type.
+  struct DatasetMethods
+  {
+    bool                      fileBacked;
+    bool                      bricked;
+    bool                      uvf;
+    bool                      dynamicBricking;
+    std::vector<std::string>  names;
+  };
+  static const DatasetMethods& methodsFor(const Dataset* ds);
+
+  /// Registers the dataset method 'name'. Returns false if the bound dataset
+  /// does not provide it.
+  bool bindMethod(const std::string& name, LuaScripting* ss);
+
+  /// __index metamethod of bound class instances.
+  static int lazyIndex(lua_State* L);
 
   /// Class registration we received from defineLuaInterface.
   /// @todo Change to unique pointer.
   LuaClassRegistration<LuaDatasetProxy>*  mReg;
   Dataset*                                mDS;
+  const DatasetMethods*                   mMethods;
+  bool                                    mBinding;
 
   /// The type of dataset.
   DatasetType mDatasetType;
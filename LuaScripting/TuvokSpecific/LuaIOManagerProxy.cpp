@@ -32,11 +32,32 @@
 
 #include "Controller/Controller.h"
 #include "3rdParty/LUA/lua.hpp"
+#include "Basics/SystemInfo.h"
+#include "Basics/SysTools.h"
 #include "IO/IOManager.h"
 #include "IO/FileBackedDataset.h"
 #include "IO/uvfDataset.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
 #include <vector>
+#include <sys/stat.h>
+#ifdef _WIN32
+# include <direct.h>
+# include <process.h>
+# include <windows.h>
+#else
+# include <dirent.h>
+# include <unistd.h>
+#endif
 
 #include "../LuaScripting.h"
 #include "../LuaClassRegistration.h"
@@ -51,6 +72,198 @@ using namespace std;
 namespace tuvok
 {
 
+namespace {
+  uint64_t inputSize(const list<string>& files) {
+    uint64_t size = 0;
+    for (list<string>::const_iterator f = files.begin(); f != files.end();
+         ++f) {
+      ifstream in(f->c_str(), ios::binary | ios::ate);
+      if (in.is_open()) size += static_cast<uint64_t>(in.tellg());
+    }
+    return size;
+  }
+
+  bool makeDir(const string& dir) {
+#ifdef _WIN32
+    return _mkdir(dir.c_str()) == 0;
+#else
+    return mkdir(dir.c_str(), 0755) == 0;
+#endif
+  }
+
+  /// Removes a directory along with everything in it. Returns false if
+  /// anything could not be removed.
+  bool removeDir(const string& dir) {
+    string path = dir;
+    if (!path.empty() && path[path.size()-1] != '/' &&
+        path[path.size()-1] != '\\')
+      path += "/";
+
+    bool ok = true;
+#ifdef _WIN32
+    WIN32_FIND_DATAA entry;
+    HANDLE find = FindFirstFileA((path + "*").c_str(), &entry);
+    if (find != INVALID_HANDLE_VALUE) {
+      do {
+        const string name = entry.cFileName;
+        if (name == "." || name == "..") continue;
+        if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+          ok = removeDir(path + name) && ok;
+        else
+          ok = DeleteFileA((path + name).c_str()) != 0 && ok;
+      } while (FindNextFileA(find, &entry));
+      FindClose(find);
+    }
+    return _rmdir(path.substr(0, path.size()-1).c_str()) == 0 && ok;
+#else
+    DIR* d = opendir(path.c_str());
+    if (d != NULL) {
+      for (struct dirent* entry = readdir(d); entry != NULL;
+           entry = readdir(d)) {
+        const string name = entry->d_name;
+        if (name == "." || name == "..") continue;
+        struct stat st;
+        if (lstat((path + name).c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+          ok = removeDir(path + name) && ok;
+        else
+          ok = unlink((path + name).c_str()) == 0 && ok;
+      }
+      closedir(d);
+    }
+    return rmdir(path.substr(0, path.size()-1).c_str()) == 0 && ok;
+#endif
+  }
+
+  unsigned processID() {
+#ifdef _WIN32
+    return static_cast<unsigned>(_getpid());
+#else
+    return static_cast<unsigned>(getpid());
+#endif
+  }
+
+  /// Jobs of a batch, grouped so that no two jobs sharing a converter run
+  /// at the same time. The lanes run concurrently, the jobs of a lane in
+  /// order. The exclusive jobs run after all lanes, one at a time.
+  struct BatchSchedule {
+    vector<vector<size_t>> lanes;
+    vector<size_t> exclusive;
+  };
+
+  /// converters[i] identifies the converter of job i. Jobs with the same
+  /// converter share a lane, null means the job may run alongside any
+  /// other job and gets a lane of its own. Jobs in 'unknown' can not be
+  /// assigned to a converter up front and are exclusive.
+  BatchSchedule scheduleBatch(const vector<const void*>& converters,
+                              const set<size_t>& unknown) {
+    BatchSchedule schedule;
+    map<const void*, size_t> laneOf;
+    for (size_t i = 0; i < converters.size(); ++i) {
+      if (unknown.count(i)) {
+        schedule.exclusive.push_back(i);
+      } else if (converters[i] == NULL) {
+        schedule.lanes.push_back(vector<size_t>(1, i));
+      } else {
+        map<const void*, size_t>::const_iterator l =
+          laneOf.find(converters[i]);
+        if (l == laneOf.end()) {
+          laneOf[converters[i]] = schedule.lanes.size();
+          schedule.lanes.push_back(vector<size_t>());
+          schedule.lanes.back().push_back(i);
+        } else {
+          schedule.lanes[l->second].push_back(i);
+        }
+      }
+    }
+    return schedule;
+  }
+
+  typedef function<bool (const BatchConversionJob&, const string& tempDir)>
+    BatchConverter;
+
+  /// Runs a scheduled batch on up to 'workers' threads, the calling thread
+  /// included. Every job converts in its own directory below tempRoot,
+  /// which must end in a path separator.
+  vector<BatchConversionResult> runBatch(
+      const vector<BatchConversionJob>& jobs, const BatchSchedule& schedule,
+      size_t workers, const string& tempRoot, const BatchConverter& convert)
+  {
+    vector<BatchConversionResult> results(jobs.size());
+
+    // Directory names must not collide with other batches of this or any
+    // other process converting below the same tempRoot.
+    static atomic<unsigned> batches(0);
+    ostringstream prefix;
+    prefix << tempRoot << "convertBatch-" << processID() << "-"
+           << batches++ << "-";
+
+    atomic<size_t> done(0);
+    auto runJob = [&](size_t i) {
+      const BatchConversionJob& job = jobs[i];
+      BatchConversionResult& res = results[i];
+      res.target = job.target;
+      res.success = false;
+      res.seconds = 0.0;
+
+      ostringstream dir;
+      dir << prefix.str() << i << "/";
+      const string tempDir = dir.str();
+
+      const auto start = chrono::steady_clock::now();
+      if (!makeDir(tempDir)) {
+        res.error = "could not create temporary directory '" + tempDir + "'";
+      } else {
+        try {
+          res.success = convert(job, tempDir);
+          if (!res.success) res.error = "conversion failed";
+        } catch (const exception& e) {
+          res.error = e.what();
+        } catch (...) {
+          res.error = "unknown error";
+        }
+        // Converters may leave intermediate files behind.
+        if (!removeDir(tempDir))
+          WARNING("convertBatch: could not remove temporary directory '%s'",
+                  tempDir.c_str());
+      }
+      res.seconds = chrono::duration<double>(chrono::steady_clock::now() -
+                                             start).count();
+
+      const unsigned finished = static_cast<unsigned>(++done);
+      if (res.success) {
+        MESSAGE("convertBatch: %u/%u done, '%s' (%.1f s)", finished,
+                static_cast<unsigned>(jobs.size()), job.target.c_str(),
+                res.seconds);
+      } else {
+        WARNING("convertBatch: %u/%u failed, '%s': %s", finished,
+                static_cast<unsigned>(jobs.size()), job.target.c_str(),
+                res.error.c_str());
+      }
+    };
+
+    // Lanes are handed out in order; each result slot is written by exactly
+    // one worker.
+    atomic<size_t> next(0);
+    auto work = [&]() {
+      for (size_t l = next++; l < schedule.lanes.size(); l = next++) {
+        for (size_t j = 0; j < schedule.lanes[l].size(); ++j)
+          runJob(schedule.lanes[l][j]);
+      }
+    };
+
+    vector<thread> pool;
+    for (size_t w = 1; w < min(workers, schedule.lanes.size()); ++w)
+      pool.push_back(thread(work));
+    work();
+    for (size_t w = 0; w < pool.size(); ++w) pool[w].join();
+
+    for (size_t j = 0; j < schedule.exclusive.size(); ++j)
+      runJob(schedule.exclusive[j]);
+
+    return results;
+  }
+}
+
 LuaIOManagerProxy::LuaIOManagerProxy(IOManager* ioman,
                                      std::shared_ptr<LuaScripting> ss)
   : mIO(ioman),
@@ -94,6 +307,16 @@ void LuaIOManagerProxy::bind()
                       "function failed, and (2) the RangeInfo structure.");
     id = mReg.registerFunction(this, &LuaIOManagerProxy::evaluateExpression,
                                nm + "evaluateExpression", "", false);
+    id = mReg.registerFunction(this, &LuaIOManagerProxy::ConvertBatch,
+                               nm + "convertBatch",
+                               "Converts independent datasets in parallel.",
+                               false);
+    mSS->addParamInfo(id, 0, "jobs", "Table of jobs, each of the form "
+                      "{files={...}, target='out.uvf', quantizeTo8Bit=false}.");
+    mSS->addParamInfo(id, 1, "options", "Table with the optional fields "
+                      "tempDir, workers, memPerJobMB and reentrant (file "
+                      "extensions whose conversions may run concurrently; "
+                      "all others run one at a time).");
 
 
     /// Functions that are not overloaded and can be registered directly.
@@ -154,14 +377,23 @@ void LuaIOManagerProxy::bind()
 
 }
 
+bool LuaIOManagerProxy::isUVF(LuaClassInstance ds) const {
+  if (ds.getGlobalInstID() != mDSTypeInst.getGlobalInstID() ||
+      !mDSTypeHandle.isValid()) {
+    mDSTypeHandle = mSS->resolve(ds.fqName() + ".getDSType");
+    mDSTypeInst = ds;
+  }
+  return mDSTypeHandle.call<LuaDatasetProxy::DatasetType>() ==
+         LuaDatasetProxy::UVF;
+}
+
 bool LuaIOManagerProxy::ExtractIsosurface(
     LuaClassInstance ds,
     uint64_t iLODlevel, double fIsovalue,
     const FLOATVECTOR4& vfColor,
     const std::string& strTargetFilename,
     const std::string& strTempDir) const {
-  if (mSS->cexecRet<LuaDatasetProxy::DatasetType>(
-          ds.fqName() + ".getDSType") != LuaDatasetProxy::UVF) {
+  if (!isUVF(ds)) {
     T_ERROR("tuvok.io.exportDataset only accepts UVF.");
     return false;
   }
@@ -183,8 +415,7 @@ bool LuaIOManagerProxy::ExtractImageStack(
     const std::string& strTargetFilename,
     const std::string& strTempDir,
     bool bAllDirs) const {
-  if (mSS->cexecRet<LuaDatasetProxy::DatasetType>(
-          ds.fqName() + ".getDSType") != LuaDatasetProxy::UVF) {
+  if (!isUVF(ds)) {
     T_ERROR("tuvok.io.exportDataset only accepts UVF.");
     return false;
   }
@@ -212,8 +443,7 @@ bool LuaIOManagerProxy::ExportDataset(LuaClassInstance ds,
                                       const string& strTargetFilename,
                                       const string& strTempDir) const
 {
-  if (mSS->cexecRet<LuaDatasetProxy::DatasetType>(
-          ds.fqName() + ".getDSType") != LuaDatasetProxy::UVF) {
+  if (!isUVF(ds)) {
     T_ERROR("tuvok.io.exportDataset only accepts UVF.");
     return false;
   }
@@ -270,6 +500,77 @@ std::tuple<bool, RangeInfo> LuaIOManagerProxy::AnalyzeDataset(
   return make_tuple(res, info);
 }
 
+vector<BatchConversionResult> LuaIOManagerProxy::ConvertBatch(
+    const vector<BatchConversionJob>& jobs,
+    BatchConversionOptions options)
+{
+  const uint64_t megabyte = 1024 * 1024;
+  if (jobs.empty()) return vector<BatchConversionResult>();
+
+  // Conversions run out of core, but some converters read whole inputs, so
+  // the largest input is taken as the footprint of a job.
+  uint64_t memPerJob = options.memPerJobMB * megabyte;
+  if (memPerJob == 0) {
+    for (size_t i = 0; i < jobs.size(); ++i)
+      memPerJob = max(memPerJob, inputSize(jobs[i].files));
+  }
+
+  size_t workers = options.workers;
+  if (workers == 0) {
+    workers = max(thread::hardware_concurrency(), 1u);
+    const uint64_t mem = Controller::Const().SysInfo().GetMaxUsableCPUMem();
+    if (memPerJob > 0)
+      workers = min<uint64_t>(workers, max<uint64_t>(mem / memPerJob, 1));
+  }
+
+  string tempRoot = options.tempDir;
+  if (tempRoot.empty()) tempRoot = ".";
+  if (tempRoot[tempRoot.size()-1] != '/' &&
+      tempRoot[tempRoot.size()-1] != '\\')
+    tempRoot += "/";
+
+  // The IOManager hands every job of a type to the same converter instance.
+  // A job whose type has no converter is matched by content, possibly to any
+  // converter.
+  set<string> reentrant;
+  for (size_t i = 0; i < options.reentrant.size(); ++i)
+    reentrant.insert(SysTools::ToUpperCase(options.reentrant[i]));
+  vector<const void*> converters(jobs.size(), NULL);
+  set<size_t> unknown;
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    if (jobs[i].files.empty()) continue;
+    const string ext = SysTools::ToUpperCase(
+      SysTools::GetExt(jobs[i].files.front()));
+    if (reentrant.count(ext)) continue;
+    converters[i] = mIO->GetConverterForExt(ext, false, true);
+    if (converters[i] == NULL) unknown.insert(i);
+  }
+  const BatchSchedule schedule = scheduleBatch(converters, unknown);
+
+  MESSAGE("Converting %u datasets with %u workers (%llu MB per job, "
+          "%u independent lanes).",
+          static_cast<unsigned>(jobs.size()), static_cast<unsigned>(workers),
+          static_cast<unsigned long long>(memPerJob / megabyte),
+          static_cast<unsigned>(schedule.lanes.size()));
+
+  // Lanes keep converters apart, but IOManager::ConvertDataset also walks the
+  // converter lists and other IOManager state, which is not known to be
+  // thread safe. Conversions are therefore serialized, except for types the
+  // caller listed as reentrant, vouching for their whole conversion path.
+  IOManager* io = mIO;
+  mutex ioMutex;
+  return runBatch(jobs, schedule, workers, tempRoot,
+                  [&](const BatchConversionJob& job, const string& tempDir) {
+                    unique_lock<mutex> lock(ioMutex, defer_lock);
+                    if (job.files.empty() || reentrant.count(
+                          SysTools::ToUpperCase(
+                            SysTools::GetExt(job.files.front()))) == 0)
+                      lock.lock();
+                    return io->ConvertDataset(job.files, job.target, tempDir,
+                                              true, job.quantizeTo8Bit);
+                  });
+}
+
 void LuaIOManagerProxy::evaluateExpression(
     const std::string& expr,
     const std::vector<std::string>& volumes,
@@ -280,3 +581,209 @@ void LuaIOManagerProxy::evaluateExpression(
 
 
 } /* namespace tuvok */
+
+#ifdef LUASCRIPTING_UNIT_TESTS
+#include <mutex>
+#include "utestCommon.h"
+using namespace tuvok;
+
+SUITE(LuaIOManagerProxyTests)
+{
+  vector<BatchConversionJob> makeJobs(size_t n)
+  {
+    vector<BatchConversionJob> jobs(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+      ostringstream os;
+      os << "out" << i << ".uvf";
+      jobs[i].target = os.str();
+      jobs[i].quantizeTo8Bit = false;
+    }
+    return jobs;
+  }
+
+  bool dirExists(const string& dir)
+  {
+    struct stat st;
+    return stat(dir.c_str(), &st) == 0;
+  }
+
+  /// Creates an empty directory in the system's temporary directory, so that
+  /// tests don't write into the working directory. Ends in a separator.
+  string makeTestDir()
+  {
+#ifdef _WIN32
+    char* name = _tempnam(NULL, "convertBatchTest");
+    string dir = name;
+    free(name);
+    _mkdir(dir.c_str());
+#else
+    const char* tmp = getenv("TMPDIR");
+    string tmpl = string(tmp ? tmp : "/tmp") + "/convertBatchTest-XXXXXX";
+    vector<char> name(tmpl.begin(), tmpl.end());
+    name.push_back(0);
+    string dir = mkdtemp(&name[0]) ? &name[0] : ".";
+#endif
+    return dir + "/";
+  }
+
+  TEST(BatchSchedule)
+  {
+    int a, b;
+    vector<const void*> converters;
+    converters.push_back(&a);
+    converters.push_back(NULL);
+    converters.push_back(&b);
+    converters.push_back(&a);
+    converters.push_back(NULL);
+    set<size_t> unknown;
+    unknown.insert(4);
+
+    BatchSchedule schedule = scheduleBatch(converters, unknown);
+    CHECK_EQUAL(3, schedule.lanes.size());
+    CHECK_EQUAL(2, schedule.lanes[0].size());
+    CHECK_EQUAL(0, schedule.lanes[0][0]);
+    CHECK_EQUAL(3, schedule.lanes[0][1]);
+    CHECK_EQUAL(1, schedule.lanes[1][0]);
+    CHECK_EQUAL(2, schedule.lanes[2][0]);
+    CHECK_EQUAL(1, schedule.exclusive.size());
+    CHECK_EQUAL(4, schedule.exclusive[0]);
+  }
+
+  TEST(BatchSharedConverterRunsAlone)
+  {
+    // Jobs 0-2 share a converter, 3 and 4 are reentrant, 5 is unknown.
+    int shared;
+    vector<const void*> converters(6, NULL);
+    converters[0] = converters[1] = converters[2] = &shared;
+    set<size_t> unknown;
+    unknown.insert(5);
+    vector<BatchConversionJob> jobs = makeJobs(6);
+    const string root = makeTestDir();
+
+    atomic<int> running(0), inShared(0), maxShared(0);
+    atomic<bool> exclusiveOverlap(false);
+    mutex dirsMutex;
+    set<string> dirs;
+    bool dirsExisted = true;
+    vector<BatchConversionResult> results = runBatch(
+        jobs, scheduleBatch(converters, unknown), 4, root,
+        [&](const BatchConversionJob& job, const string& tempDir) {
+          const bool isShared = job.target < "out3";
+          int r = ++running;
+          if (job.target == "out5.uvf" && r != 1) exclusiveOverlap = true;
+          if (isShared)
+          {
+            int s = ++inShared;
+            if (s > maxShared) maxShared = s;
+          }
+          {
+            lock_guard<mutex> lock(dirsMutex);
+            dirs.insert(tempDir);
+            dirsExisted = dirsExisted && dirExists(tempDir);
+          }
+          this_thread::sleep_for(chrono::milliseconds(20));
+          if (isShared) --inShared;
+          --running;
+          return job.target != "out4.uvf";
+        });
+
+    CHECK_EQUAL(6, results.size());
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+      CHECK_EQUAL(jobs[i].target, results[i].target);
+      CHECK_EQUAL(i != 4, results[i].success);
+    }
+    CHECK_EQUAL("conversion failed", results[4].error);
+    CHECK_EQUAL(1, maxShared.load());
+    CHECK(!exclusiveOverlap);
+
+    // Every job had a directory of its own, removed once it was done.
+    CHECK(dirsExisted);
+    CHECK_EQUAL(6, dirs.size());
+    for (set<string>::const_iterator d = dirs.begin(); d != dirs.end(); ++d)
+      CHECK(!dirExists(*d));
+    CHECK(removeDir(root));
+  }
+
+  TEST(BatchRemovesLeftovers)
+  {
+    // Whatever a converter leaves in its directory is removed with it.
+    vector<BatchConversionJob> jobs = makeJobs(1);
+    const string root = makeTestDir();
+    string leftDir;
+    vector<BatchConversionResult> results = runBatch(
+        jobs, scheduleBatch(vector<const void*>(1, NULL), set<size_t>()), 1,
+        root,
+        [&](const BatchConversionJob&, const string& tempDir) {
+          leftDir = tempDir;
+          makeDir(tempDir + "sub");
+          ofstream(tempDir + "sub/brick.raw") << "data";
+          ofstream(tempDir + "header.nhdr") << "header";
+          return true;
+        });
+
+    CHECK(results[0].success);
+    CHECK(!leftDir.empty());
+    CHECK(!dirExists(leftDir));
+    CHECK(removeDir(root));
+  }
+
+  TEST(BatchTempDirFailure)
+  {
+    vector<BatchConversionJob> jobs = makeJobs(2);
+    vector<const void*> converters(2, NULL);
+    const string root = makeTestDir();
+    bool converted = false;
+    vector<BatchConversionResult> results = runBatch(
+        jobs, scheduleBatch(converters, set<size_t>()), 2,
+        root + "missing/",
+        [&](const BatchConversionJob&, const string&) {
+          converted = true;
+          return true;
+        });
+
+    CHECK(!converted);
+    CHECK(!results[0].success);
+    CHECK(!results[1].success);
+    CHECK(results[0].error.find("temporary directory") != string::npos);
+    CHECK(removeDir(root));
+  }
+
+  /// Runs n independent jobs on the given number of workers and returns how
+  /// many of them ran at the same time at most.
+  int peakConcurrency(size_t n, size_t workers, const string& root)
+  {
+    vector<BatchConversionJob> jobs = makeJobs(n);
+    BatchSchedule schedule = scheduleBatch(vector<const void*>(n, NULL),
+                                           set<size_t>());
+    const int expected = static_cast<int>(min(n, workers));
+    atomic<int> running(0), peak(0);
+    // Jobs hold on until all workers are in. The deadline only guards against
+    // a hang if the batch were serialized.
+    const auto deadline = chrono::steady_clock::now() + chrono::seconds(5);
+    runBatch(jobs, schedule, workers, root,
+             [&](const BatchConversionJob&, const string&) {
+               int r = ++running;
+               for (int p = peak; r > p && !peak.compare_exchange_weak(p, r);)
+                 {}
+               while (peak < expected && chrono::steady_clock::now() < deadline)
+                 this_thread::sleep_for(chrono::milliseconds(1));
+               --running;
+               return true;
+             });
+    return peak;
+  }
+
+  TEST(BatchConcurrency)
+  {
+    // Independent jobs run on as many workers as requested, never more.
+    const string root = makeTestDir();
+    CHECK_EQUAL(1, peakConcurrency(8, 1, root));
+    CHECK_EQUAL(4, peakConcurrency(8, 4, root));
+    CHECK_EQUAL(3, peakConcurrency(3, 4, root));
+    CHECK(removeDir(root));
+  }
+}
+
+#endif
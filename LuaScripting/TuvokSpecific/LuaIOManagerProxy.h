@@ -33,12 +33,16 @@
 #ifndef TUVOK_LUAIOMANAGERPROXY_H_
 #define TUVOK_LUAIOMANAGERPROXY_H_
 
+#include <list>
 #include <sstream>
+#include <string>
 #include <tuple>
 #include <utility>
+#include <vector>
 #include "Basics/Vectors.h"
 #include "../LuaScripting.h"
 #include "../LuaClassRegistration.h"
+#include "../LuaFunctionHandle.h"
 #include "../LuaMemberReg.h"
 
 class FileStackInfo;
@@ -48,6 +52,34 @@ namespace tuvok
 
 class Dataset;
 
+/// One conversion of tuvok.io.convertBatch. In Lua:
+/// { files = {"a.raw", ...} | "a.raw", target = "a.uvf",
+///   quantizeTo8Bit = false (optional) }
+struct BatchConversionJob {
+  std::list<std::string> files;
+  std::string target;
+  bool quantizeTo8Bit;
+};
+
+/// Options of tuvok.io.convertBatch. All fields are optional:
+/// { tempDir = ".", workers = 0 (one per core), memPerJobMB = 0 (estimated
+///   from the job inputs), reentrant = {} (extensions, e.g. {"raw"}, whose
+///   conversions may run alongside any other conversion) }
+struct BatchConversionOptions {
+  std::string tempDir;
+  unsigned workers;
+  uint64_t memPerJobMB;
+  std::vector<std::string> reentrant;
+};
+
+/// Outcome of one job of tuvok.io.convertBatch, in job order.
+struct BatchConversionResult {
+  std::string target;
+  bool success;
+  double seconds;
+  std::string error;
+};
+
 class LuaIOManagerProxy
 {
 public:
@@ -61,7 +93,16 @@ private:
   LuaMemberReg                        mReg;
   std::shared_ptr<LuaScripting>       mSS;
 
+  /// getDSType of the dataset last passed to isUVF. Declared after mSS,
+  /// which keeps the scripting system alive for as long as the handle.
+  mutable LuaClassInstance            mDSTypeInst;
+  mutable LuaFunctionHandle           mDSTypeHandle;
+
   void bind();
+
+  /// True if ds is a UVF dataset. Repeated queries for the same dataset
+  /// call getDSType through a cached handle instead of looking it up.
+  bool isUVF(LuaClassInstance ds) const;
   /// Proxy functions for IOManager. These functions exist because IO
   /// does not known about LuaScripting. 
   /// @{
@@ -103,6 +144,18 @@ private:
   std::tuple<bool, RangeInfo> AnalyzeDataset(
       const std::string& strFilename, const std::string& strTempDir);
   /// @}  
+
+  /// Converts independent datasets concurrently. The number of workers is
+  /// bounded by the core count and by how many jobs fit into the usable CPU
+  /// memory. Converters and the IOManager itself are shared and not known to
+  /// be thread safe, so conversions run one at a time unless the extension
+  /// of the job is in options.reentrant; only such jobs actually overlap.
+  /// Each job gets its own temporary directory below options.tempDir. The
+  /// workers never touch the Lua state; progress is reported through the
+  /// debug out, which is thread safe.
+  std::vector<BatchConversionResult> ConvertBatch(
+      const std::vector<BatchConversionJob>& jobs,
+      BatchConversionOptions options);
   
   /// The following evaluateExpression proxy was made because of the 
   /// "throw (tuvok::Exception)" exception specification on 
@@ -251,6 +304,191 @@ public:
   static TupleStructProxy getDefault() { return TupleStructProxy(); }
 };
 
+template<>
+class LuaStrictStack<BatchConversionJob> {
+public:
+  typedef BatchConversionJob Type;
+
+  static BatchConversionJob get(lua_State* L, int pos) {
+    LuaStackRAII a_(L, 0, 0);
+
+    Type ret;
+    luaL_checktype(L, pos, LUA_TTABLE);
+
+    lua_getfield(L, pos, "files");
+    if (lua_type(L, -1) == LUA_TSTRING) {
+      ret.files.push_back(lua_tostring(L, -1));
+    } else {
+      ret.files = LuaStrictStack<std::list<std::string>>::get(L,
+                                                              lua_gettop(L));
+    }
+    lua_pop(L, 1);
+
+    lua_getfield(L, pos, "target");
+    ret.target = LuaStrictStack<std::string>::get(L, lua_gettop(L));
+    lua_pop(L, 1);
+
+    lua_getfield(L, pos, "quantizeTo8Bit");
+    ret.quantizeTo8Bit = lua_toboolean(L, -1) != 0;
+    lua_pop(L, 1);
+
+    return ret;
+  }
+
+  static void push(lua_State* L, const BatchConversionJob& in) {
+    LuaStackRAII a_(L, 0, 1);
+
+    lua_newtable(L);
+    LuaStrictStack<std::list<std::string>>::push(L, in.files);
+    lua_setfield(L, -2, "files");
+    lua_pushstring(L, in.target.c_str());
+    lua_setfield(L, -2, "target");
+    lua_pushboolean(L, in.quantizeTo8Bit);
+    lua_setfield(L, -2, "quantizeTo8Bit");
+  }
+
+  static std::string getValStr(const BatchConversionJob& in) {
+    std::ostringstream oss;
+    oss << "{ files = "
+        << LuaStrictStack<std::list<std::string>>::getValStr(in.files)
+        << ", target = " << in.target
+        << ", quantizeTo8Bit = " << in.quantizeTo8Bit << " }";
+    return oss.str();
+  }
+  static std::string getTypeStr() { return "BatchConversionJob"; }
+  static BatchConversionJob getDefault() {
+    BatchConversionJob job;
+    job.quantizeTo8Bit = false;
+    return job;
+  }
+};
+
+template<>
+class LuaStrictStack<BatchConversionOptions> {
+public:
+  typedef BatchConversionOptions Type;
+
+  static BatchConversionOptions get(lua_State* L, int pos) {
+    LuaStackRAII a_(L, 0, 0);
+
+    Type ret = getDefault();
+    luaL_checktype(L, pos, LUA_TTABLE);
+
+    lua_getfield(L, pos, "tempDir");
+    if (!lua_isnil(L, -1))
+      ret.tempDir = LuaStrictStack<std::string>::get(L, lua_gettop(L));
+    lua_pop(L, 1);
+
+    lua_getfield(L, pos, "workers");
+    if (!lua_isnil(L, -1))
+      ret.workers = LuaStrictStack<unsigned>::get(L, lua_gettop(L));
+    lua_pop(L, 1);
+
+    lua_getfield(L, pos, "memPerJobMB");
+    if (!lua_isnil(L, -1))
+      ret.memPerJobMB = LuaStrictStack<uint64_t>::get(L, lua_gettop(L));
+    lua_pop(L, 1);
+
+    lua_getfield(L, pos, "reentrant");
+    if (!lua_isnil(L, -1))
+      ret.reentrant = LuaStrictStack<std::vector<std::string>>::get(
+          L, lua_gettop(L));
+    lua_pop(L, 1);
+
+    return ret;
+  }
+
+  static void push(lua_State* L, const BatchConversionOptions& in) {
+    LuaStackRAII a_(L, 0, 1);
+
+    lua_newtable(L);
+    lua_pushstring(L, in.tempDir.c_str());
+    lua_setfield(L, -2, "tempDir");
+    LuaStrictStack<unsigned>::push(L, in.workers);
+    lua_setfield(L, -2, "workers");
+    LuaStrictStack<uint64_t>::push(L, in.memPerJobMB);
+    lua_setfield(L, -2, "memPerJobMB");
+    LuaStrictStack<std::vector<std::string>>::push(L, in.reentrant);
+    lua_setfield(L, -2, "reentrant");
+  }
+
+  static std::string getValStr(const BatchConversionOptions& in) {
+    std::ostringstream oss;
+    oss << "{ tempDir = " << in.tempDir << ", workers = " << in.workers
+        << ", memPerJobMB = " << in.memPerJobMB << ", reentrant = "
+        << LuaStrictStack<std::vector<std::string>>::getValStr(in.reentrant)
+        << " }";
+    return oss.str();
+  }
+  static std::string getTypeStr() { return "BatchConversionOptions"; }
+  static BatchConversionOptions getDefault() {
+    BatchConversionOptions opts;
+    opts.tempDir = ".";
+    opts.workers = 0;
+    opts.memPerJobMB = 0;
+    return opts;
+  }
+};
+
+template<>
+class LuaStrictStack<BatchConversionResult> {
+public:
+  typedef BatchConversionResult Type;
+
+  static BatchConversionResult get(lua_State* L, int pos) {
+    LuaStackRAII a_(L, 0, 0);
+
+    Type ret = getDefault();
+    luaL_checktype(L, pos, LUA_TTABLE);
+
+    lua_getfield(L, pos, "target");
+    ret.target = LuaStrictStack<std::string>::get(L, lua_gettop(L));
+    lua_pop(L, 1);
+
+    lua_getfield(L, pos, "success");
+    ret.success = LuaStrictStack<bool>::get(L, lua_gettop(L));
+    lua_pop(L, 1);
+
+    lua_getfield(L, pos, "seconds");
+    ret.seconds = LuaStrictStack<double>::get(L, lua_gettop(L));
+    lua_pop(L, 1);
+
+    lua_getfield(L, pos, "error");
+    ret.error = LuaStrictStack<std::string>::get(L, lua_gettop(L));
+    lua_pop(L, 1);
+
+    return ret;
+  }
+
+  static void push(lua_State* L, const BatchConversionResult& in) {
+    LuaStackRAII a_(L, 0, 1);
+
+    lua_newtable(L);
+    lua_pushstring(L, in.target.c_str());
+    lua_setfield(L, -2, "target");
+    lua_pushboolean(L, in.success);
+    lua_setfield(L, -2, "success");
+    lua_pushnumber(L, in.seconds);
+    lua_setfield(L, -2, "seconds");
+    lua_pushstring(L, in.error.c_str());
+    lua_setfield(L, -2, "error");
+  }
+
+  static std::string getValStr(const BatchConversionResult& in) {
+    std::ostringstream oss;
+    oss << "{ target = " << in.target << ", success = " << in.success
+        << ", seconds = " << in.seconds << ", error = " << in.error << " }";
+    return oss.str();
+  }
+  static std::string getTypeStr() { return "BatchConversionResult"; }
+  static BatchConversionResult getDefault() {
+    BatchConversionResult res;
+    res.success = false;
+    res.seconds = 0.0;
+    return res;
+  }
+};
+
 template<>
 class LuaStrictStack<RangeInfo>
 {
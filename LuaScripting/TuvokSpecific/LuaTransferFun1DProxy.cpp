@@ -36,15 +36,30 @@
 #include "3rdParty/LUA/lua.hpp"
 #include "../LuaScripting.h"
 #include "../LuaClassRegistration.h"
+#include "../LuaMemberRegUnsafe.h"
+#include "../LuaTypedArray.h"
 #include "LuaTuvokTypes.h"
 #include "LuaTransferFun1DProxy.h"
 
 using namespace tuvok;
 
+// Bulk edits older than this, or beyond this much memory, can no longer be
+// undone. The most recent edit is always kept.
+static const size_t MAX_UNDO_EDITS      = 256;
+static const size_t MAX_UNDO_EDIT_BYTES = 8 * 1024 * 1024;
+
+static size_t editBytes(const std::vector<uint32_t>& indices)
+{
+  return indices.size() * (sizeof(uint32_t) + 2 * sizeof(FLOATVECTOR4));
+}
+
 //------------------------------------------------------------------------------
 LuaTransferFun1DProxy::LuaTransferFun1DProxy()
   : mReg(NULL),
-    m1DTrans(NULL)
+    m1DTrans(NULL),
+    mSS(NULL),
+    mHookReg(NULL),
+    mEditBytes(0)
 {
 }
 
@@ -53,6 +68,9 @@ LuaTransferFun1DProxy::~LuaTransferFun1DProxy()
 {
   if (mReg != NULL)
     delete mReg;
+  delete mHookReg;
+  if (mSS != NULL)
+    mSS->removeProvenanceClearObservers(this);
 }
 
 //------------------------------------------------------------------------------
@@ -64,6 +82,9 @@ void LuaTransferFun1DProxy::bind(TransferFunction1D* tf)
 
   mReg->clearProxyFunctions();
 
+  // Recorded edits refer to the previous transfer function.
+  clearEdits();
+
   m1DTrans = tf;
   if (tf != NULL)
   {
@@ -83,13 +104,10 @@ void LuaTransferFun1DProxy::bind(TransferFunction1D* tf)
                              "getColor", "Retrieves the color at 'index'.",
                              false);
     id = mReg->functionProxy(tf, &TransferFunction1D::SetColor,
-                             "setColor", "Sets the color at 'index'.",
+                             "setColor", "Sets the color at 'index'. To "
+                             "change many entries use setColorRange, "
+                             "setColorData or setRamp.",
                              true);
-
-    /// @todo In order for provenance to work, we need to always call SetColor
-    ///       or have another function that sets all of the color data at once
-    ///       (setting all of the color data at once is the more efficient route
-    ///        and would transfer into a Lua setting quite easily).
   }
 }
 
@@ -97,9 +115,13 @@ void LuaTransferFun1DProxy::bind(TransferFunction1D* tf)
 void LuaTransferFun1DProxy::defineLuaInterface(
     LuaClassRegistration<LuaTransferFun1DProxy>& reg,
     LuaTransferFun1DProxy* me,
-    LuaScripting*)
+    LuaScripting* ss)
 {
   me->mReg = new LuaClassRegistration<LuaTransferFun1DProxy>(reg);
+  me->mSS = ss;
+  me->mHookReg = new LuaMemberRegUnsafe(ss);
+  ss->addProvenanceClearObserver(me, [me]() {me->clearEdits();});
+  std::string id;
 
   /// @todo Determine if the following function should be provenance enabled.
   reg.function(&LuaTransferFun1DProxy::proxyLoadWithFilenameAndSize,
@@ -110,6 +132,32 @@ void LuaTransferFun1DProxy::defineLuaInterface(
                "setStdFunction", "", true);
   reg.function(&LuaTransferFun1DProxy::proxySave,
                "save", "", false);
+
+  id = reg.function(&LuaTransferFun1DProxy::proxyGetColorRange,
+                    "getColorRange", "Returns 'count' colors starting at "
+                    "'start' as a float typed array of shape {count, 4}.",
+                    false);
+  ss->setProvenanceExempt(id);
+  id = reg.function(&LuaTransferFun1DProxy::proxySetColorRange,
+                    "setColorRange", "Sets the colors starting at 'start' "
+                    "from a typed array with 4 components per color.", true);
+  me->mHookReg->setUndoFun(me, &LuaTransferFun1DProxy::undoSetColorRange, id);
+  me->mHookReg->setRedoFun(me, &LuaTransferFun1DProxy::redoSetColorRange, id);
+  id = reg.function(&LuaTransferFun1DProxy::proxySetColorData,
+                    "setColorData", "Replaces all colors with those in a "
+                    "typed array holding getSize() * 4 components.", true);
+  me->mHookReg->setUndoFun(me, &LuaTransferFun1DProxy::undoSetColorData, id);
+  me->mHookReg->setRedoFun(me, &LuaTransferFun1DProxy::redoSetColorData, id);
+  id = reg.function(&LuaTransferFun1DProxy::proxySetRamp,
+                    "setRamp", "Linearly interpolates the colors from index "
+                    "'first' to 'last' between two colors.", true);
+  me->mHookReg->setUndoFun(me, &LuaTransferFun1DProxy::undoSetRamp, id);
+  me->mHookReg->setRedoFun(me, &LuaTransferFun1DProxy::redoSetRamp, id);
+  id = reg.function(&LuaTransferFun1DProxy::proxyScaleRange,
+                    "scaleRange", "Multiplies the colors from index 'first' "
+                    "to 'last' component-wise by a factor.", true);
+  me->mHookReg->setUndoFun(me, &LuaTransferFun1DProxy::undoScaleRange, id);
+  me->mHookReg->setRedoFun(me, &LuaTransferFun1DProxy::redoScaleRange, id);
 }
 
 //------------------------------------------------------------------------------
@@ -134,3 +182,214 @@ bool LuaTransferFun1DProxy::proxySave(const std::string& filename) const
   if (m1DTrans == NULL) return false;
   return m1DTrans->Save(filename);
 }
+
+//------------------------------------------------------------------------------
+LuaTypedArray LuaTransferFun1DProxy::proxyGetColorRange(size_t start,
+                                                        size_t count) const
+{
+  if (m1DTrans == NULL) return LuaTypedArray();
+  if (start > m1DTrans->GetSize() || count > m1DTrans->GetSize() - start)
+    throw LuaError("getColorRange: range exceeds the transfer function.");
+
+  LuaTypedArray::Shape shape(2);
+  shape[0] = count;
+  shape[1] = 4;
+  LuaTypedArray colors(LuaTypedArray::FLOAT32, shape);
+  float* dst = colors.data<float>();
+  const std::vector<FLOATVECTOR4>& src = m1DTrans->GetColorData();
+  for (size_t i = 0; i < count; ++i)
+  {
+    dst[4*i + 0] = src[start + i].x;
+    dst[4*i + 1] = src[start + i].y;
+    dst[4*i + 2] = src[start + i].z;
+    dst[4*i + 3] = src[start + i].w;
+  }
+  return colors;
+}
+
+//------------------------------------------------------------------------------
+void LuaTransferFun1DProxy::proxySetColorRange(size_t start,
+                                               LuaTypedArray colors)
+{
+  if (m1DTrans == NULL) return;
+  if (colors.size() % 4 != 0)
+    throw LuaError("setColorRange: expected 4 components per color.");
+
+  std::vector<FLOATVECTOR4> c(colors.size() / 4);
+  for (size_t i = 0; i < c.size(); ++i)
+  {
+    c[i] = FLOATVECTOR4(float(colors.get(4*i + 0)), float(colors.get(4*i + 1)),
+                        float(colors.get(4*i + 2)), float(colors.get(4*i + 3)));
+  }
+  applyColors(start, c);
+}
+
+//------------------------------------------------------------------------------
+void LuaTransferFun1DProxy::proxySetColorData(LuaTypedArray colors)
+{
+  if (m1DTrans == NULL) return;
+  if (colors.size() != m1DTrans->GetSize() * 4)
+    throw LuaError("setColorData: expected getSize() * 4 components.");
+  proxySetColorRange(0, colors);
+}
+
+//------------------------------------------------------------------------------
+void LuaTransferFun1DProxy::proxySetRamp(size_t first, size_t last,
+                                         FLOATVECTOR4 from, FLOATVECTOR4 to)
+{
+  if (m1DTrans == NULL) return;
+  if (first > last)
+    throw LuaError("setRamp: 'first' must not be greater than 'last'.");
+  if (last >= m1DTrans->GetSize())
+    throw LuaError("setRamp: range exceeds the transfer function.");
+
+  std::vector<FLOATVECTOR4> c(last - first + 1);
+  for (size_t i = 0; i < c.size(); ++i)
+  {
+    float t = c.size() > 1 ? float(i) / float(c.size() - 1) : 0.0f;
+    c[i] = from * (1.0f - t) + to * t;
+  }
+  applyColors(first, c);
+}
+
+//------------------------------------------------------------------------------
+void LuaTransferFun1DProxy::proxyScaleRange(size_t first, size_t last,
+                                            FLOATVECTOR4 factor)
+{
+  if (m1DTrans == NULL) return;
+  if (first > last || last >= m1DTrans->GetSize())
+    throw LuaError("scaleRange: range exceeds the transfer function.");
+
+  const std::vector<FLOATVECTOR4>& src = m1DTrans->GetColorData();
+  std::vector<FLOATVECTOR4> c(src.begin() + first, src.begin() + last + 1);
+  for (size_t i = 0; i < c.size(); ++i)
+  {
+    c[i] = FLOATVECTOR4(c[i].x * factor.x, c[i].y * factor.y,
+                        c[i].z * factor.z, c[i].w * factor.w);
+  }
+  applyColors(first, c);
+}
+
+//------------------------------------------------------------------------------
+void LuaTransferFun1DProxy::applyColors(size_t start,
+                                        const std::vector<FLOATVECTOR4>& colors)
+{
+  std::vector<FLOATVECTOR4>& data = m1DTrans->GetColorData();
+  if (start > data.size() || colors.size() > data.size() - start)
+    throw LuaError("Color range exceeds the transfer function.");
+
+  // Only keep the changed entries if the provenance system records this
+  // call; its undo and redo hooks will ask for them. A composite function
+  // that is redone calls us again without recording: that call repeats the
+  // edit on top of mRedoEdits.
+  bool record = mSS->isProvenanceRecording();
+  bool replay = !record && mSS->isProvenanceRedoing();
+  ColorEdit edit;
+  for (size_t i = 0; i < colors.size(); ++i)
+  {
+    FLOATVECTOR4& entry = data[start + i];
+    if (entry == colors[i]) continue;
+    if (record || replay)
+    {
+      edit.indices.push_back(static_cast<uint32_t>(start + i));
+      edit.before.push_back(entry);
+      edit.after.push_back(colors[i]);
+    }
+    entry = colors[i];
+  }
+  m1DTrans->ComputeNonZeroLimits();
+
+  if (record)
+  {
+    for (size_t i = 0; i < mRedoEdits.size(); ++i)
+      mEditBytes -= editBytes(mRedoEdits[i].indices);
+    mRedoEdits.clear();
+  }
+  else if (replay && !mRedoEdits.empty())
+  {
+    mEditBytes -= editBytes(mRedoEdits.back().indices);
+    mRedoEdits.pop_back();
+  }
+
+  if (record || replay)
+  {
+    mUndoEdits.push_back(edit);
+    mEditBytes += editBytes(edit.indices);
+    while (mUndoEdits.size() > 1 &&
+           (mUndoEdits.size() > MAX_UNDO_EDITS ||
+            mEditBytes > MAX_UNDO_EDIT_BYTES))
+    {
+      mEditBytes -= editBytes(mUndoEdits.front().indices);
+      mUndoEdits.pop_front();
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+void LuaTransferFun1DProxy::clearEdits()
+{
+  mUndoEdits.clear();
+  mRedoEdits.clear();
+  mEditBytes = 0;
+}
+
+//------------------------------------------------------------------------------
+void LuaTransferFun1DProxy::undoEdit()
+{
+  if (m1DTrans == NULL) return;
+  if (mUndoEdits.empty())
+  {
+    WARNING("Transfer function edit is too old to be undone.");
+    return;
+  }
+
+  const ColorEdit& edit = mUndoEdits.back();
+  std::vector<FLOATVECTOR4>& data = m1DTrans->GetColorData();
+  for (size_t i = 0; i < edit.indices.size(); ++i)
+  {
+    if (edit.indices[i] < data.size())
+      data[edit.indices[i]] = edit.before[i];
+  }
+  m1DTrans->ComputeNonZeroLimits();
+
+  mRedoEdits.push_back(edit);
+  mUndoEdits.pop_back();
+}
+
+//------------------------------------------------------------------------------
+void LuaTransferFun1DProxy::redoEdit()
+{
+  if (m1DTrans == NULL || mRedoEdits.empty()) return;
+
+  const ColorEdit& edit = mRedoEdits.back();
+  std::vector<FLOATVECTOR4>& data = m1DTrans->GetColorData();
+  for (size_t i = 0; i < edit.indices.size(); ++i)
+  {
+    if (edit.indices[i] < data.size())
+      data[edit.indices[i]] = edit.after[i];
+  }
+  m1DTrans->ComputeNonZeroLimits();
+
+  mUndoEdits.push_back(edit);
+  mRedoEdits.pop_back();
+}
+
+//------------------------------------------------------------------------------
+void LuaTransferFun1DProxy::undoSetColorRange(size_t, LuaTypedArray)
+{ undoEdit(); }
+void LuaTransferFun1DProxy::redoSetColorRange(size_t, LuaTypedArray)
+{ redoEdit(); }
+void LuaTransferFun1DProxy::undoSetColorData(LuaTypedArray)
+{ undoEdit(); }
+void LuaTransferFun1DProxy::redoSetColorData(LuaTypedArray)
+{ redoEdit(); }
+void LuaTransferFun1DProxy::undoSetRamp(size_t, size_t, FLOATVECTOR4,
+                                        FLOATVECTOR4)
+{ undoEdit(); }
+void LuaTransferFun1DProxy::redoSetRamp(size_t, size_t, FLOATVECTOR4,
+                                        FLOATVECTOR4)
+{ redoEdit(); }
+void LuaTransferFun1DProxy::undoScaleRange(size_t, size_t, FLOATVECTOR4)
+{ undoEdit(); }
+void LuaTransferFun1DProxy::redoScaleRange(size_t, size_t, FLOATVECTOR4)
+{ redoEdit(); }
@@ -33,10 +33,17 @@
 #ifndef TUVOK_LUATRANSFERFUN1DPROXY_H
 #define TUVOK_LUATRANSFERFUN1DPROXY_H
 
+#include <deque>
+#include <vector>
+#include "Basics/Vectors.h"
+
 class TransferFunction1D;
 
 namespace tuvok {
 
+class LuaTypedArray;
+class LuaMemberRegUnsafe;
+
 /// @brief classDescription
 class LuaTransferFun1DProxy
 {
@@ -65,12 +72,67 @@ private:
                            int component, bool invertedStep);
   bool proxySave(const std::string& filename) const;
 
+  /// Bulk editing. Colors are passed as typed arrays holding 4 components
+  /// (RGBA) per entry. Each call is a single undo/redo step.
+  ///@{
+  LuaTypedArray proxyGetColorRange(size_t start, size_t count) const;
+  void proxySetColorRange(size_t start, LuaTypedArray colors);
+  void proxySetColorData(LuaTypedArray colors);
+  /// Linear ramp from 'from' at 'first' to 'to' at 'last' (inclusive).
+  void proxySetRamp(size_t first, size_t last, FLOATVECTOR4 from,
+                    FLOATVECTOR4 to);
+  /// Multiplies the entries in [first, last] component-wise by 'factor'.
+  void proxyScaleRange(size_t first, size_t last, FLOATVECTOR4 factor);
+  ///@}
+
+  /// Entries changed by one bulk edit.
+  struct ColorEdit
+  {
+    std::vector<uint32_t>     indices;
+    std::vector<FLOATVECTOR4> before;
+    std::vector<FLOATVECTOR4> after;
+  };
+
+  /// Writes 'colors' starting at 'start', remembering the changed entries
+  /// when the edit goes on the undo/redo stack.
+  void applyColors(size_t start, const std::vector<FLOATVECTOR4>& colors);
+  void undoEdit();
+  void redoEdit();
+  /// Drops all recorded edits. Called when the undo/redo stack is cleared.
+  void clearEdits();
+
+  /// Undo/redo hooks of the bulk functions. The parameters the provenance
+  /// system passes are ignored; the edits are replayed from mUndoEdits and
+  /// mRedoEdits instead.
+  ///@{
+  void undoSetColorRange(size_t, LuaTypedArray);
+  void redoSetColorRange(size_t, LuaTypedArray);
+  void undoSetColorData(LuaTypedArray);
+  void redoSetColorData(LuaTypedArray);
+  void undoSetRamp(size_t, size_t, FLOATVECTOR4, FLOATVECTOR4);
+  void redoSetRamp(size_t, size_t, FLOATVECTOR4, FLOATVECTOR4);
+  void undoScaleRange(size_t, size_t, FLOATVECTOR4);
+  void redoScaleRange(size_t, size_t, FLOATVECTOR4);
+  ///@}
+
   /// Class registration we received from defineLuaInterface.
   /// @todo Change to unique pointer.
   LuaClassRegistration<LuaTransferFun1DProxy>*  mReg;
 
   /// The 1D transfer function that we represent.
   TransferFunction1D*                           m1DTrans;
+
+  LuaScripting*                                 mSS;
+  /// Registers the undo/redo hooks of the bulk functions.
+  LuaMemberRegUnsafe*                           mHookReg;
+
+  /// Bulk edits in the order they were placed on the undo/redo stack, and
+  /// the undone edits that can be redone. Each provenance entry of a bulk
+  /// function corresponds to the last element of one of these.
+  std::deque<ColorEdit>                         mUndoEdits;
+  std::vector<ColorEdit>                        mRedoEdits;
+  /// Memory held by the changed entries of mUndoEdits and mRedoEdits.
+  size_t                                        mEditBytes;
 };
 
 } // namespace tuvok
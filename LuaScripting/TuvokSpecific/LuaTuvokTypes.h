@@ -994,6 +994,149 @@ public:
 };
 
 
+/// Pushed as a table mapping counter names (or ids, for unnamed counters) to
+/// {id=, count=, sum=, min=, max=}. Reading such a table back yields the
+/// snapshot it was pushed from (see tuvok.perfDelta).
+template<>
+class LuaStrictStack<PerfSnapshot>
+{
+public:
+  typedef PerfSnapshot Type;
+
+  static Type get(lua_State* L, int pos)
+  {
+    Type ret;
+    luaL_checktype(L, pos, LUA_TTABLE);
+    pos = lua_absindex(L, pos);
+
+    lua_pushnil(L);
+    while (lua_next(L, pos))
+    {
+      // Don't use lua_tostring on the key, it would confuse lua_next.
+      std::string name;
+      if (lua_type(L, -2) == LUA_TSTRING)
+        name = lua_tostring(L, -2);
+      luaL_checktype(L, -1, LUA_TTABLE);
+
+      lua_getfield(L, -1, "id");
+      if (lua_isnumber(L, -1) == 0)
+      {
+        lua_pop(L, 3);
+        throw LuaError("PerfSnapshot entries need a numeric id.");
+      }
+      size_t id = static_cast<size_t>(lua_tointeger(L, -1));
+      lua_pop(L, 1);
+
+      PerfStats stats;
+      stats.count = static_cast<uint64_t>(getNumber(L, "count"));
+      stats.sum   = getNumber(L, "sum");
+      if (stats.count > 0)
+      {
+        stats.min = getNumber(L, "min");
+        stats.max = getNumber(L, "max");
+      }
+      ret.Set(id, name, stats);
+
+      lua_pop(L, 1);
+    }
+    return ret;
+  }
+
+  static void push(lua_State* L, const Type& in)
+  {
+    lua_newtable(L);
+    int tbl = lua_gettop(L);
+
+    for (size_t id = 0; id < in.size(); ++id)
+    {
+      const PerfStats& stats = in[id];
+      if (in.Name(id).empty())
+        lua_pushinteger(L, static_cast<lua_Integer>(id));
+      else
+        lua_pushstring(L, in.Name(id).c_str());
+
+      lua_newtable(L);
+      lua_pushinteger(L, static_cast<lua_Integer>(id));
+      lua_setfield(L, -2, "id");
+      lua_pushnumber(L, static_cast<lua_Number>(stats.count));
+      lua_setfield(L, -2, "count");
+      lua_pushnumber(L, stats.sum);
+      lua_setfield(L, -2, "sum");
+      lua_pushnumber(L, stats.count ? stats.min : 0.0);
+      lua_setfield(L, -2, "min");
+      lua_pushnumber(L, stats.count ? stats.max : 0.0);
+      lua_setfield(L, -2, "max");
+
+      lua_settable(L, tbl);
+    }
+  }
+
+  static std::string getValStr(const Type& in)
+  {
+    std::ostringstream os;
+    os << "{ ";
+    for (size_t id = 0; id < in.size(); ++id)
+    {
+      if (in[id].count == 0) continue;
+      os << (in.Name(id).empty() ? std::to_string(id) : in.Name(id))
+         << "=" << in[id].sum << " ";
+    }
+    os << "}";
+    return os.str();
+  }
+  static std::string getTypeStr() { return "PerfSnapshot"; }
+  static Type        getDefault() { return Type(); }
+
+private:
+  /// Reads a numerical field of the table on top of the stack.
+  static double getNumber(lua_State* L, const char* field)
+  {
+    lua_getfield(L, -1, field);
+    double value = luaL_checknumber(L, -1);
+    lua_pop(L, 1);
+    return value;
+  }
+};
+
+/// Pushed as {count=, p50=, p95=, p99=, max=}, in milliseconds. The buckets
+/// are not pushed, so a histogram can not be read back from Lua.
+template<>
+class LuaStrictStack<PerfHistogram>
+{
+public:
+  typedef PerfHistogram Type;
+
+  static Type get(lua_State*, int)
+  {
+    throw LuaError("PerfHistogram can not be converted from a Lua table.");
+  }
+
+  static void push(lua_State* L, const Type& in)
+  {
+    lua_newtable(L);
+    lua_pushnumber(L, static_cast<lua_Number>(in.Count()));
+    lua_setfield(L, -2, "count");
+    lua_pushnumber(L, in.Percentile(50.0));
+    lua_setfield(L, -2, "p50");
+    lua_pushnumber(L, in.Percentile(95.0));
+    lua_setfield(L, -2, "p95");
+    lua_pushnumber(L, in.Percentile(99.0));
+    lua_setfield(L, -2, "p99");
+    lua_pushnumber(L, in.Max());
+    lua_setfield(L, -2, "max");
+  }
+
+  static std::string getValStr(const Type& in)
+  {
+    std::ostringstream os;
+    os << "{ p50=" << in.Percentile(50.0) << " p95=" << in.Percentile(95.0)
+       << " p99=" << in.Percentile(99.0) << " max=" << in.Max() << " }";
+    return os.str();
+  }
+  static std::string getTypeStr() { return "PerfHistogram"; }
+  static Type        getDefault() { return Type(); }
+};
+
 } // namespace tuvok
 
 // Register standard Tuvok enumerations. These enumerations declare their own
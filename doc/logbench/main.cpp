@@ -0,0 +1,57 @@
+/// Measures the throughput of TextfileOut, in messages per second, in its
+/// synchronous and asynchronous modes.  Usage:
+///
+///   ./logbench [messages] [threads]
+///
+/// Every thread logs messages/threads messages to 'logbench.txt'.  The time
+/// includes the final flush, so the asynchronous numbers are for messages
+/// that actually made it to the file.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include "DebugOut/TextfileOut.h"
+
+static const char* logfile = "logbench.txt";
+
+double bench(bool async, int messages, int threads) {
+  std::remove(logfile);
+
+  auto start = std::chrono::steady_clock::now();
+  {
+    TextfileOut out(logfile, async);
+    out.SetShowMessages(true);
+
+    std::vector<std::thread> workers;
+    for(int t=0; t < threads; ++t) {
+      workers.push_back(std::thread([&out, messages, threads, t]() {
+        for(int i=0; i < messages/threads; ++i) {
+          out.Message("bench", "thread %d, message %d of a streamed brick",
+                      t, i);
+        }
+      }));
+    }
+    for(size_t t=0; t < workers.size(); ++t) { workers[t].join(); }
+  } // Destruction flushes the queue.
+  std::chrono::duration<double> secs =
+    std::chrono::steady_clock::now() - start;
+
+  std::remove(logfile);
+  return messages / secs.count();
+}
+
+int main(int argc, char* argv[]) {
+  int messages = argc > 1 ? std::atoi(argv[1]) : 100000;
+  int threads = argc > 2 ? std::atoi(argv[2]) : 1;
+  if(messages <= 0 || threads <= 0) {
+    std::fprintf(stderr, "usage: %s [messages] [threads]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::printf("synchronous:  %12.0f messages/sec\n",
+              bench(false, messages, threads));
+  std::printf("asynchronous: %12.0f messages/sec\n",
+              bench(true, messages, threads));
+  return EXIT_SUCCESS;
+}
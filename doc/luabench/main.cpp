@@ -0,0 +1,94 @@
+/// Measures the throughput of the Lua scripting system.  Usage:
+///
+///   ./luabench [calls] [instances]
+///
+/// Reports the rate of calls to a registered function with provenance
+/// enabled and with provenance disabled, where calls to functions without
+/// hooks take the fast path, and the rate at which class instances are
+/// constructed and deleted.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include "LuaScripting/LuaScripting.h"
+#include "LuaScripting/LuaClassRegistration.h"
+
+using namespace tuvok;
+
+static int sum(int a, int b, int c) { return a + b + c; }
+
+/// Seconds taken by executing 'code'.
+static double timeExec(LuaScripting& ss, const std::string& code) {
+  auto start = std::chrono::steady_clock::now();
+  ss.exec(code);
+  std::chrono::duration<double> secs =
+    std::chrono::steady_clock::now() - start;
+  return secs.count();
+}
+
+/// A class with a typical number of methods.
+class Point {
+public:
+  Point() : x(0), y(0), z(0) {}
+
+  static Point* luaConstruct() { return new Point(); }
+  static void defineLuaInterface(LuaClassRegistration<Point>& reg, Point*,
+                                 LuaScripting*) {
+    reg.function(&Point::setX, "setX", "", true);
+    reg.function(&Point::setY, "setY", "", true);
+    reg.function(&Point::setZ, "setZ", "", true);
+    reg.function(&Point::getX, "getX", "", false);
+    reg.function(&Point::getY, "getY", "", false);
+    reg.function(&Point::getZ, "getZ", "", false);
+  }
+
+  void setX(float v) { x = v; }
+  void setY(float v) { y = v; }
+  void setZ(float v) { z = v; }
+  float getX() const { return x; }
+  float getY() const { return y; }
+  float getZ() const { return z; }
+
+private:
+  float x, y, z;
+};
+
+double benchCalls(bool provenance, int calls) {
+  LuaScripting ss;
+  ss.registerFunction(&sum, "bench.sum", "", true);
+  ss.enableProvenance(provenance);
+
+  std::ostringstream os;
+  os << "for i=1," << calls << " do bench.sum(1, 2, i) end";
+  return calls / timeExec(ss, os.str());
+}
+
+double benchInstances(int instances) {
+  LuaScripting ss;
+  ss.registerClassStatic<Point>(&Point::luaConstruct, "bench.point", "",
+                                LuaClassRegCallback<Point>::Type(
+                                    &Point::defineLuaInterface));
+  ss.enableProvenance(false);
+
+  std::ostringstream os;
+  os << "for i=1," << instances << " do deleteClass(bench.point.new()) end";
+  return instances / timeExec(ss, os.str());
+}
+
+int main(int argc, char* argv[]) {
+  int calls = argc > 1 ? std::atoi(argv[1]) : 200000;
+  int instances = argc > 2 ? std::atoi(argv[2]) : 20000;
+  if(calls <= 0 || instances <= 0) {
+    std::fprintf(stderr, "usage: %s [calls] [instances]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::printf("calls, provenance:     %12.0f calls/sec\n",
+              benchCalls(true, calls));
+  std::printf("calls, fast path:      %12.0f calls/sec\n",
+              benchCalls(false, calls));
+  std::printf("instances, new+delete: %12.0f instances/sec\n",
+              benchInstances(instances));
+  return EXIT_SUCCESS;
+}
@@ -56,9 +56,13 @@ set( TUVOK_HEADERS  StdTuvokDefines.h
                     Basics/Threads.h
                     Controller/Controller.h
                     Controller/MasterController.h
+                    Controller/PerfRegistry.h
+                    Controller/PerfTrace.h
+                    Controller/Pipeline.h
                     DebugOut/AbstrDebugOut.h
                     DebugOut/ConsoleOut.h
                     DebugOut/MultiplexOut.h
+                    DebugOut/StructuredOut.h
                     DebugOut/TextfileOut.h
                     IO/3rdParty/bzip2/bzlib_private.h
                     IO/3rdParty/jpeglib/cderror.h
@@ -203,20 +207,25 @@ set( TUVOK_HEADERS  StdTuvokDefines.h
                     IO/VariantArray.h
                     IO/VFFConverter.h
                     IO/XML3DGeoConverter.h
+                    LuaScripting/LuaAllocator.h
                     LuaScripting/LuaClassConstructor.h
                     LuaScripting/LuaClassInstance.h
                     LuaScripting/LuaClassRegistration.h
                     LuaScripting/LuaCommon.h
+                    LuaScripting/LuaDebug.h
                     LuaScripting/LuaError.h
                     LuaScripting/LuaFunBinding.h
                     LuaScripting/LuaFunBindingCore.h
+                    LuaScripting/LuaFunctionHandle.h
                     LuaScripting/LuaMemberReg.h
                     LuaScripting/LuaMemberRegUnsafe.h
+                    LuaScripting/LuaProfiler.h
                     LuaScripting/LuaProvenance.h
                     LuaScripting/LuaScripting.h
                     LuaScripting/LuaScriptingExecBody.h
                     LuaScripting/LuaScriptingExecHeader.h
                     LuaScripting/LuaStackRAII.h
+                    LuaScripting/LuaTypedArray.h
                     LuaScripting/TuvokSpecific/LuaDatasetProxy.h
                     LuaScripting/TuvokSpecific/LuaIOManagerProxy.h
                     LuaScripting/TuvokSpecific/LuaTransferFun1DProxy.h
@@ -279,9 +288,13 @@ set(TUVOK_SRCS 3rdParty/LUA/lapi.cpp
                Basics/KDTree.cpp
                Basics/Threads.cpp
                Controller/MasterController.cpp
+               Controller/PerfRegistry.cpp
+               Controller/PerfTrace.cpp
+               Controller/Pipeline.cpp
                DebugOut/AbstrDebugOut.cpp
                DebugOut/ConsoleOut.cpp
                DebugOut/MultiplexOut.cpp
+               DebugOut/StructuredOut.cpp
                DebugOut/TextfileOut.cpp
                IO/3rdParty/bzip2/blocksort.c
                IO/3rdParty/bzip2/bzlib.c
@@ -484,14 +497,19 @@ set(TUVOK_SRCS 3rdParty/LUA/lapi.cpp
                IO/TTIFFWriter/TTIFFWriter.cpp
                IO/VFFConverter.cpp
                IO/XML3DGeoConverter.cpp
+               LuaScripting/LuaAllocator.cpp
                LuaScripting/LuaClassConstructor.cpp
                LuaScripting/LuaClassInstance.cpp
                LuaScripting/LuaClassRegistration.cpp
+               LuaScripting/LuaDebug.cpp
+               LuaScripting/LuaFunctionHandle.cpp
                LuaScripting/LuaMemberReg.cpp
                LuaScripting/LuaMemberRegUnsafe.cpp
+               LuaScripting/LuaProfiler.cpp
                LuaScripting/LuaProvenance.cpp
                LuaScripting/LuaScripting.cpp
                LuaScripting/LuaStackRAII.cpp
+               LuaScripting/LuaTypedArray.cpp
                LuaScripting/TuvokSpecific/LuaDatasetProxy.cpp
                LuaScripting/TuvokSpecific/LuaIOManagerProxy.cpp
                LuaScripting/TuvokSpecific/LuaTransferFun1DProxy.cpp
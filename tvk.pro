@@ -117,9 +117,13 @@ HEADERS += \
            Basics/Vectors.h \
            Controller/Controller.h \
            Controller/MasterController.h \
+           Controller/PerfRegistry.h \
+           Controller/PerfTrace.h \
+           Controller/Pipeline.h \
            DebugOut/AbstrDebugOut.h \
            DebugOut/ConsoleOut.h \
            DebugOut/MultiplexOut.h \
+           DebugOut/StructuredOut.h \
            DebugOut/TextfileOut.h \
            IO/3rdParty/bzip2/bzlib_private.h \
            IO/3rdParty/jpeglib/cderror.h \
@@ -262,20 +266,25 @@ HEADERS += \
            IO/VGStudioConverter.h \
            IO/VTKConverter.h \
            IO/XML3DGeoConverter.h \
+           LuaScripting/LuaAllocator.h \
            LuaScripting/LuaClassConstructor.h \
            LuaScripting/LuaClassInstance.h \
            LuaScripting/LuaClassRegistration.h \
            LuaScripting/LuaCommon.h \
+           LuaScripting/LuaDebug.h \
            LuaScripting/LuaError.h \
            LuaScripting/LuaFunBindingCore.h \
            LuaScripting/LuaFunBinding.h \
+           LuaScripting/LuaFunctionHandle.h \
            LuaScripting/LuaMemberReg.h \
            LuaScripting/LuaMemberRegUnsafe.h \
+           LuaScripting/LuaProfiler.h \
            LuaScripting/LuaProvenance.h \
            LuaScripting/LuaScriptingExecBody.h \
            LuaScripting/LuaScriptingExecHeader.h \
            LuaScripting/LuaScripting.h \
            LuaScripting/LuaStackRAII.h \
+           LuaScripting/LuaTypedArray.h \
            LuaScripting/TuvokSpecific/LuaDatasetProxy.h \
            LuaScripting/TuvokSpecific/LuaIOManagerProxy.h \
            LuaScripting/TuvokSpecific/LuaTransferFun1DProxy.h \
@@ -387,9 +396,13 @@ SOURCES += \
            Basics/Threads.cpp \
            Basics/Timer.cpp \
            Controller/MasterController.cpp \
+           Controller/PerfRegistry.cpp \
+           Controller/PerfTrace.cpp \
+           Controller/Pipeline.cpp \
            DebugOut/AbstrDebugOut.cpp \
            DebugOut/ConsoleOut.cpp \
            DebugOut/MultiplexOut.cpp \
+           DebugOut/StructuredOut.cpp \
            DebugOut/TextfileOut.cpp \
            IO/3rdParty/bzip2/blocksort.c \
            IO/3rdParty/bzip2/bzlib.c \
@@ -594,14 +607,19 @@ SOURCES += \
            IO/VGStudioConverter.cpp \
            IO/VTKConverter.cpp \
            IO/XML3DGeoConverter.cpp \
+           LuaScripting/LuaAllocator.cpp \
            LuaScripting/LuaClassConstructor.cpp \
            LuaScripting/LuaClassInstance.cpp \
            LuaScripting/LuaClassRegistration.cpp \
+           LuaScripting/LuaDebug.cpp \
+           LuaScripting/LuaFunctionHandle.cpp \
            LuaScripting/LuaMemberReg.cpp \
            LuaScripting/LuaMemberRegUnsafe.cpp \
+           LuaScripting/LuaProfiler.cpp \
            LuaScripting/LuaProvenance.cpp \
            LuaScripting/LuaScripting.cpp \
            LuaScripting/LuaStackRAII.cpp \
+           LuaScripting/LuaTypedArray.cpp \
            LuaScripting/TuvokSpecific/LuaDatasetProxy.cpp \
            LuaScripting/TuvokSpecific/LuaIOManagerProxy.cpp \
            LuaScripting/TuvokSpecific/LuaTransferFun1DProxy.cpp \